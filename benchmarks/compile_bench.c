@@ -0,0 +1,85 @@
+// NOTE(Al-Andrew): end to end compile time. generates a large lox program in memory and compiles it with the scanner
+//                  on the parser's thread and with it on its own thread (Clox_VM.pipelined), best round of each.
+//                  build with `xmake build compile_bench`, run as `xmake run compile_bench [megabytes] [rounds]`.
+#include "common.h"
+#include "compiler.h"
+#include "vm.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static const char s_clox_bench_program[] =
+    "// counts things up, the way the benchmarks do\n"
+    "fun accumulate_values(count, step) {\n"
+    "    var total = 0;\n"
+    "    var i = 0;\n"
+    "    while (i < count) {\n"
+    "        if (i != 7 == !false) { total = total + step * 2.5 - i / 3; }\n"
+    "        else { total = -total; }\n"
+    "        i = i + 1;\n"
+    "    }\n"
+    "    return total <= 100000 == true;\n"
+    "}\n"
+    "\n"
+    "for (var index_of_item = 0; index_of_item > 10; index_of_item = index_of_item + 1) {\n"
+    "    print \"a string literal that runs for a while, like messages do\";\n"
+    "    print accumulate_values(index_of_item, 0.125); // trailing comment\n"
+    "    var super_long_identifier_name_for_testing = index_of_item * 2;\n"
+    "}\n";
+
+static double Clox_Bench_Now(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static double Clox_Bench_Compile(char const* source, bool pipelined, int rounds) {
+    double best = 1e9;
+    for (int round = 0; round < rounds; ++round) {
+        Clox_VM vm = Clox_VM_New_Empty();
+        vm.pipelined = pipelined;
+        double start = Clox_Bench_Now();
+        Clox_Function* function = Clox_Compile_Source_To_Function(&vm, source);
+        double elapsed = Clox_Bench_Now() - start;
+        Clox_VM_Delete(&vm);
+        if (function == NULL) {
+            printf("the generated program did not compile\n");
+            exit(1);
+        }
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 16;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    if (megabytes == 0 || rounds <= 0) {
+        printf("Usage: compile_bench [megabytes] [rounds]\n");
+        return 1;
+    }
+
+    size_t program_length = sizeof(s_clox_bench_program) - 1;
+    size_t copies = (megabytes * 1024 * 1024) / program_length + 1;
+    size_t size = copies * program_length;
+    char* source = malloc(size + 1);
+    if (source == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < copies; ++i) {
+        memcpy(source + i * program_length, s_clox_bench_program, program_length);
+    }
+    source[size] = '\0';
+
+    double mb = (double)size / (1024.0 * 1024.0);
+    double serial = Clox_Bench_Compile(source, false, rounds);
+    double pipelined = Clox_Bench_Compile(source, true, rounds);
+    printf("compiled %.1f MB, best of %d\n", mb, rounds);
+    printf("serial:    %.3f s, %.1f MB/s\n", serial, mb / serial);
+    printf("pipelined: %.3f s, %.1f MB/s\n", pipelined, mb / pipelined);
+
+    free(source);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+// NOTE(Al-Andrew): scanner throughput. generates a large lox source in memory, scans it to EOF a few times and reports
+//                  the best round in MB/s. build with `xmake build scanner_bench`,
+//                  run as `xmake run scanner_bench [megabytes] [rounds] [scalar|sse2|avx2]`.
+#include "common.h"
+#include "scanner.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// NOTE(Al-Andrew): a bit of everything the scanner sees in real programs, keywords, short and long identifiers, numbers,
+//                  strings, comments and every operator.
+static const char s_clox_bench_snippet[] =
+    "// counts things up, the way the benchmarks do\n"
+    "fun accumulate_values(count, step) {\n"
+    "    var total = 0;\n"
+    "    var i = 0;\n"
+    "    while (i < count and total >= 0) {\n"
+    "        if (i != 7 or !false) { total = total + step * 2.5 - i / 3; }\n"
+    "        else { total = -total; }\n"
+    "        i = i + 1;\n"
+    "    }\n"
+    "    return total <= 100000 == true;\n"
+    "}\n"
+    "\n"
+    "class Counter_Base { init() { this.value = nil; } }\n"
+    "for (var index_of_item = 0; index_of_item > 10; index_of_item = index_of_item + 1) {\n"
+    "    print \"a string literal that runs for a while, like messages do\";\n"
+    "    print accumulate_values(index_of_item, 0.125); // trailing comment\n"
+    "    var super_long_identifier_name_for_testing = super_long_identifier_name_for_testing;\n"
+    "}\n";
+
+static double Clox_Bench_Now(void) {
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 64;
+    int rounds = argc > 2 ? atoi(argv[2]) : 5;
+    Clox_Scanner_SIMD simd = Clox_Scanner_Best_SIMD();
+    if (argc > 3) {
+        simd = strcmp(argv[3], "avx2") == 0 ? CLOX_SCANNER_SIMD_AVX2 : strcmp(argv[3], "sse2") == 0 ? CLOX_SCANNER_SIMD_SSE2 : CLOX_SCANNER_SIMD_NONE;
+    }
+    if (megabytes == 0 || rounds <= 0 || simd > Clox_Scanner_Supported_SIMD()) {
+        printf("Usage: scanner_bench [megabytes] [rounds] [scalar|sse2|avx2]\n");
+        return 1;
+    }
+
+    size_t snippet_length = sizeof(s_clox_bench_snippet) - 1;
+    size_t copies = (megabytes * 1024 * 1024) / snippet_length + 1;
+    size_t size = copies * snippet_length;
+    char* source = malloc(size + 1);
+    if (source == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < copies; ++i) {
+        memcpy(source + i * snippet_length, s_clox_bench_snippet, snippet_length);
+    }
+    source[size] = '\0';
+
+    double best = 1e9;
+    uint64_t tokens = 0;
+    uint64_t checksum = 0; // NOTE(Al-Andrew): so the token loop can't be thrown away, and as a sanity check across builds
+    for (int round = 0; round < rounds; ++round) {
+        Clox_Scanner scanner = Clox_Scanner_New(source);
+        scanner.simd = simd;
+        tokens = 0;
+        checksum = 0;
+        double start = Clox_Bench_Now();
+        for (;;) {
+            Clox_Token token = Clox_Scanner_Get_Token(&scanner);
+            tokens += 1;
+            checksum = checksum * 31 + (uint64_t)token.type + (uint64_t)token.length;
+            if (token.type == CLOX_TOKEN_EOF || token.type == CLOX_TOKEN_ERROR) {
+                break;
+            }
+        }
+        double elapsed = Clox_Bench_Now() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    double mb = (double)size / (1024.0 * 1024.0);
+    printf("scanned %.1f MB, %llu tokens, checksum %016llx\n", mb, (unsigned long long)tokens, (unsigned long long)checksum);
+    printf("%s, best of %d: %.3f s, %.1f MB/s, %.1f Mtokens/s\n", simd == CLOX_SCANNER_SIMD_AVX2 ? "avx2" : simd == CLOX_SCANNER_SIMD_SSE2 ? "sse2" : "scalar", rounds, best, mb / best, (double)tokens / best / 1e6);
+
+    free(source);
+    return 0;
+}
\ No newline at end of file
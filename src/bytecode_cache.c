@@ -0,0 +1,588 @@
+#define _DEFAULT_SOURCE // NOTE(Al-Andrew): mmap and mkdir are hidden under -std=c11 otherwise
+#include "bytecode_cache.h"
+#include "memory.h"
+#include "vm.h"
+#include <string.h>
+
+#ifdef CLOX_SOURCE_POSIX
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif // CLOX_SOURCE_POSIX
+
+#define CLOX_BYTECODE_CACHE_BYTE_ORDER 0x01020304u
+#define CLOX_BYTECODE_CACHE_NONE UINT32_MAX
+#define CLOX_BYTECODE_CACHE_NOT_LAZY UINT64_MAX
+
+// NOTE(Al-Andrew): the image. native byte order, every table aligned to 8, offsets count from the start of the file.
+//                  strings are named by their index in the string table and functions by theirs in the function
+//                  table, the script is function 0.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t config;
+    uint64_t key;
+    uint64_t source_length;
+    uint32_t string_count;
+    uint32_t global_count;
+    uint32_t function_count;
+    uint32_t padding;
+    uint64_t strings_offset; // NOTE(Al-Andrew): Clox_Bytecode_Cache_String[string_count]
+    uint64_t globals_offset; // NOTE(Al-Andrew): uint32_t[global_count], the name of every global slot the code uses
+    uint64_t functions_offset; // NOTE(Al-Andrew): Clox_Bytecode_Cache_Function[function_count]
+} Clox_Bytecode_Cache_Header;
+
+typedef struct {
+    uint64_t offset;
+    uint32_t length;
+    uint32_t padding;
+} Clox_Bytecode_Cache_String;
+
+typedef struct {
+    uint64_t code_offset;
+    uint64_t lines_offset; // NOTE(Al-Andrew): uint32_t[code_length]
+    uint64_t constants_offset; // NOTE(Al-Andrew): Clox_Bytecode_Cache_Constant[constant_count]
+    uint64_t lazy_offset; // NOTE(Al-Andrew): where the body starts in the source, CLOX_BYTECODE_CACHE_NOT_LAZY if compiled
+    uint64_t inline_sites_offset; // NOTE(Al-Andrew): Clox_Bytecode_Cache_Inline_Site[inline_site_count]
+    uint32_t code_length;
+    uint32_t constant_count;
+    uint32_t name; // NOTE(Al-Andrew): CLOX_BYTECODE_CACHE_NONE for the script
+    uint32_t call_cache_count;
+    int32_t arity;
+    int32_t upvalue_count;
+    int32_t lazy_line;
+    uint32_t has_captured_locals;
+    uint32_t inline_site_count;
+    uint32_t padding;
+} Clox_Bytecode_Cache_Function;
+
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t call_line;
+    uint32_t callee; // NOTE(Al-Andrew): a string
+} Clox_Bytecode_Cache_Inline_Site;
+
+typedef enum {
+    CLOX_BYTECODE_CACHE_CONSTANT_NIL,
+    CLOX_BYTECODE_CACHE_CONSTANT_BOOL,
+    CLOX_BYTECODE_CACHE_CONSTANT_NUMBER,
+    CLOX_BYTECODE_CACHE_CONSTANT_INTEGER,
+    CLOX_BYTECODE_CACHE_CONSTANT_STRING,
+    CLOX_BYTECODE_CACHE_CONSTANT_FUNCTION,
+} Clox_Bytecode_Cache_Constant_Type;
+
+typedef struct {
+    uint32_t type;
+    uint32_t index; // NOTE(Al-Andrew): of the string or the function
+    uint64_t bits; // NOTE(Al-Andrew): the bool, double or int64
+} Clox_Bytecode_Cache_Constant;
+
+// NOTE(Al-Andrew): everything that changes what the compiler emits for the same source, or how the VM reads it
+static uint32_t Clox_Bytecode_Cache_Config(Clox_VM const* vm) {
+    uint32_t config = (uint32_t)OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS << 8; // NOTE(Al-Andrew): the last opcode
+    #ifdef CLOX_VALUE_NAN_BOXING
+    config |= 0x1;
+    #endif // CLOX_VALUE_NAN_BOXING
+    #ifdef CLOX_COMPILER_SUPERINSTRUCTIONS
+    config |= 0x2;
+    #endif // CLOX_COMPILER_SUPERINSTRUCTIONS
+    config |= vm->optimize ? 0x4 : 0;
+    config |= vm->lazy && !vm->incremental ? 0x8 : 0;
+    return config;
+}
+
+static inline uint64_t Clox_Bytecode_Cache_Rotate(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+#define CLOX_BYTECODE_CACHE_PRIME_1 0x9E3779B185EBCA87ull
+#define CLOX_BYTECODE_CACHE_PRIME_2 0xC2B2AE3D27D4EB4Full
+
+// NOTE(Al-Andrew): runs on every start, so four independent lanes over 32 byte blocks, in the style of xxHash64. not
+//                  meant to resist anyone, only to tell sources apart.
+static uint64_t Clox_Bytecode_Cache_Hash(char const* data, size_t length, uint64_t seed) {
+    uint64_t lanes[4] = {
+        seed + CLOX_BYTECODE_CACHE_PRIME_1 + CLOX_BYTECODE_CACHE_PRIME_2,
+        seed + CLOX_BYTECODE_CACHE_PRIME_2,
+        seed,
+        seed - CLOX_BYTECODE_CACHE_PRIME_1,
+    };
+    size_t offset = 0;
+    for (; offset + 32 <= length; offset += 32) {
+        for (int lane = 0; lane < 4; ++lane) {
+            uint64_t word;
+            memcpy(&word, data + offset + lane * 8, sizeof(word));
+            lanes[lane] = Clox_Bytecode_Cache_Rotate(lanes[lane] + word * CLOX_BYTECODE_CACHE_PRIME_2, 31) * CLOX_BYTECODE_CACHE_PRIME_1;
+        }
+    }
+    uint64_t hash = Clox_Bytecode_Cache_Rotate(lanes[0], 1) + Clox_Bytecode_Cache_Rotate(lanes[1], 7)
+        + Clox_Bytecode_Cache_Rotate(lanes[2], 12) + Clox_Bytecode_Cache_Rotate(lanes[3], 18) + (uint64_t)length;
+    for (; offset < length; ++offset) {
+        hash = Clox_Bytecode_Cache_Rotate(hash ^ ((uint8_t)data[offset] * CLOX_BYTECODE_CACHE_PRIME_1), 11) * CLOX_BYTECODE_CACHE_PRIME_2;
+    }
+    hash ^= hash >> 33;
+    hash *= CLOX_BYTECODE_CACHE_PRIME_2;
+    hash ^= hash >> 29;
+    hash *= CLOX_BYTECODE_CACHE_PRIME_1;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static bool Clox_Bytecode_Cache_Make_Directory(char const* path) {
+    #ifdef CLOX_SOURCE_POSIX
+        return mkdir(path, 0755) == 0 || errno == EEXIST;
+    #else
+        (void)path;
+        return true; // NOTE(Al-Andrew): no portable mkdir, the directory has to exist already
+    #endif // CLOX_SOURCE_POSIX
+}
+
+static bool Clox_Bytecode_Cache_Directory(char* directory, size_t capacity) {
+    char const* explicit_directory = getenv("CLOX_CACHE_DIR");
+    if (explicit_directory != NULL && explicit_directory[0] != '\0') {
+        int length = snprintf(directory, capacity, "%s", explicit_directory);
+        return length > 0 && (size_t)length < capacity && Clox_Bytecode_Cache_Make_Directory(directory);
+    }
+
+    char const* xdg_cache = getenv("XDG_CACHE_HOME");
+    if (xdg_cache != NULL && xdg_cache[0] != '\0') {
+        int length = snprintf(directory, capacity, "%s/clox", xdg_cache);
+        return length > 0 && (size_t)length < capacity && Clox_Bytecode_Cache_Make_Directory(directory);
+    }
+
+    char const* home = getenv("HOME");
+    if (home == NULL || home[0] == '\0') {
+        return false;
+    }
+    int length = snprintf(directory, capacity, "%s/.cache", home);
+    if (length <= 0 || (size_t)length >= capacity || !Clox_Bytecode_Cache_Make_Directory(directory)) {
+        return false;
+    }
+    length = snprintf(directory, capacity, "%s/.cache/clox", home);
+    return length > 0 && (size_t)length < capacity && Clox_Bytecode_Cache_Make_Directory(directory);
+}
+
+bool Clox_Bytecode_Cache_Open(Clox_Bytecode_Cache* cache, Clox_VM const* vm, Clox_Source const* source) {
+    CLOX_DEV_ASSERT(cache != NULL && source != NULL);
+    cache->path[0] = '\0';
+    cache->key = 0;
+    cache->image = NULL;
+    cache->image_size = 0;
+    cache->mapped = false;
+
+    char directory[CLOX_BYTECODE_CACHE_MAX_PATH];
+    if (!Clox_Bytecode_Cache_Directory(directory, sizeof(directory))) {
+        return false;
+    }
+    uint64_t seed = ((uint64_t)CLOX_BYTECODE_CACHE_VERSION << 32) | Clox_Bytecode_Cache_Config(vm);
+    cache->key = Clox_Bytecode_Cache_Hash(source->text, source->length, seed);
+    int length = snprintf(cache->path, sizeof(cache->path), "%s/%016llx.loxc", directory, (unsigned long long)cache->key);
+    if (length <= 0 || (size_t)length >= sizeof(cache->path)) {
+        cache->path[0] = '\0';
+        return false;
+    }
+    return true;
+}
+
+static bool Clox_Bytecode_Cache_Map(Clox_Bytecode_Cache* cache) {
+    #ifdef CLOX_SOURCE_POSIX
+        int fd = open(cache->path, O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || (size_t)info.st_size < sizeof(Clox_Bytecode_Cache_Header)) {
+            close(fd);
+            return false;
+        }
+        // NOTE(Al-Andrew): writable but private, quickening rewrites opcodes in place and only those pages get copied
+        void* image = mmap(NULL, (size_t)info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (image == MAP_FAILED) {
+            return false;
+        }
+        cache->image = image;
+        cache->image_size = (size_t)info.st_size;
+        cache->mapped = true;
+        return true;
+    #else
+        FILE* file = fopen(cache->path, "rb");
+        if (file == NULL) {
+            return false;
+        }
+        fseek(file, 0L, SEEK_END);
+        long size = ftell(file);
+        rewind(file);
+        if (size < (long)sizeof(Clox_Bytecode_Cache_Header)) {
+            fclose(file);
+            return false;
+        }
+        cache->image = reallocate(NULL, 0, (size_t)size); // TODO(Al-Andrew, AllocFailure): handle
+        cache->image_size = fread(cache->image, 1, (size_t)size, file);
+        cache->mapped = false;
+        fclose(file);
+        return true;
+    #endif // CLOX_SOURCE_POSIX
+}
+
+static void Clox_Bytecode_Cache_Unmap(Clox_Bytecode_Cache* cache) {
+    if (cache->image == NULL) {
+        return;
+    }
+    #ifdef CLOX_SOURCE_POSIX
+        if (cache->mapped) {
+            munmap(cache->image, cache->image_size);
+        } else {
+            deallocate(cache->image);
+        }
+    #else
+        deallocate(cache->image);
+    #endif // CLOX_SOURCE_POSIX
+    cache->image = NULL;
+    cache->image_size = 0;
+    cache->mapped = false;
+}
+
+void Clox_Bytecode_Cache_Delete(Clox_Bytecode_Cache* cache) {
+    CLOX_DEV_ASSERT(cache != NULL);
+    Clox_Bytecode_Cache_Unmap(cache);
+    cache->path[0] = '\0';
+}
+
+// NOTE(Al-Andrew): `count` elements of `size` bytes at `offset` lie inside the image and are aligned to `alignment`
+static bool Clox_Bytecode_Cache_Holds(Clox_Bytecode_Cache const* cache, uint64_t offset, uint64_t count, size_t size, size_t alignment) {
+    return offset % alignment == 0 && offset <= cache->image_size && count <= (cache->image_size - offset) / size;
+}
+
+#define CLOX_BYTECODE_CACHE_CHECK(condition) if (!(condition)) { goto failed; }
+
+Clox_Function* Clox_Bytecode_Cache_Load(Clox_Bytecode_Cache* cache, Clox_VM* vm, Clox_Source const* source) {
+    CLOX_DEV_ASSERT(cache != NULL && source != NULL);
+    if (cache->path[0] == '\0' || !Clox_Bytecode_Cache_Map(cache)) {
+        return NULL;
+    }
+
+    uint8_t* image = cache->image;
+    Clox_String** strings = NULL;
+    Clox_Function** functions = NULL;
+    Clox_Bytecode_Cache_Header header;
+    memcpy(&header, image, sizeof(header));
+    CLOX_BYTECODE_CACHE_CHECK(memcmp(header.magic, "LOXC", 4) == 0);
+    CLOX_BYTECODE_CACHE_CHECK(header.version == CLOX_BYTECODE_CACHE_VERSION && header.byte_order == CLOX_BYTECODE_CACHE_BYTE_ORDER);
+    CLOX_BYTECODE_CACHE_CHECK(header.config == Clox_Bytecode_Cache_Config(vm) && header.key == cache->key);
+    CLOX_BYTECODE_CACHE_CHECK(header.source_length == source->length && header.function_count > 0);
+    CLOX_BYTECODE_CACHE_CHECK(Clox_Bytecode_Cache_Holds(cache, header.strings_offset, header.string_count, sizeof(Clox_Bytecode_Cache_String), 8));
+    CLOX_BYTECODE_CACHE_CHECK(Clox_Bytecode_Cache_Holds(cache, header.globals_offset, header.global_count, sizeof(uint32_t), 8));
+    CLOX_BYTECODE_CACHE_CHECK(Clox_Bytecode_Cache_Holds(cache, header.functions_offset, header.function_count, sizeof(Clox_Bytecode_Cache_Function), 8));
+
+    Clox_Bytecode_Cache_String const* string_table = (Clox_Bytecode_Cache_String const*)(image + header.strings_offset);
+    strings = reallocate(NULL, 0, sizeof(Clox_String*) * ((size_t)header.string_count + 1)); // TODO(Al-Andrew, AllocFailure): handle
+    for (uint32_t i = 0; i < header.string_count; ++i) {
+        CLOX_BYTECODE_CACHE_CHECK(Clox_Bytecode_Cache_Holds(cache, string_table[i].offset, string_table[i].length, 1, 1));
+        strings[i] = Clox_String_Create(vm, (char const*)image + string_table[i].offset, string_table[i].length);
+    }
+
+    // NOTE(Al-Andrew): the code names globals by slot, so the slots have to come out the same as when it was compiled
+    uint32_t const* globals = (uint32_t const*)(image + header.globals_offset);
+    for (uint32_t i = 0; i < header.global_count; ++i) {
+        CLOX_BYTECODE_CACHE_CHECK(globals[i] < header.string_count);
+        CLOX_BYTECODE_CACHE_CHECK(Clox_VM_Resolve_Global_Slot(vm, strings[globals[i]]) == i);
+    }
+
+    Clox_Bytecode_Cache_Function const* function_table = (Clox_Bytecode_Cache_Function const*)(image + header.functions_offset);
+    functions = reallocate(NULL, 0, sizeof(Clox_Function*) * header.function_count); // TODO(Al-Andrew, AllocFailure): handle
+    for (uint32_t i = 0; i < header.function_count; ++i) {
+        functions[i] = Clox_Function_Create_Empty(vm);
+    }
+    for (uint32_t i = 0; i < header.function_count; ++i) {
+        Clox_Bytecode_Cache_Function const* record = &function_table[i];
+        Clox_Function* function = functions[i];
+        CLOX_BYTECODE_CACHE_CHECK(record->name == CLOX_BYTECODE_CACHE_NONE || record->name < header.string_count);
+        CLOX_BYTECODE_CACHE_CHECK(record->arity >= 0 && record->arity <= UINT8_MAX);
+        CLOX_BYTECODE_CACHE_CHECK(record->upvalue_count >= 0 && record->upvalue_count <= UINT16_MAX + 1);
+        CLOX_BYTECODE_CACHE_CHECK(record->call_cache_count <= CLOX_MAX_CALL_CACHES);
+        CLOX_BYTECODE_CACHE_CHECK(Clox_Bytecode_Cache_Holds(cache, record->constants_offset, record->constant_count, sizeof(Clox_Bytecode_Cache_Constant), 8));
+        if (record->lazy_offset == CLOX_BYTECODE_CACHE_NOT_LAZY) {
+            CLOX_BYTECODE_CACHE_CHECK(record->code_length > 0);
+            CLOX_BYTECODE_CACHE_CHECK(Clox_Bytecode_Cache_Holds(cache, record->code_offset, record->code_length, 1, 1));
+            CLOX_BYTECODE_CACHE_CHECK(Clox_Bytecode_Cache_Holds(cache, record->lines_offset, record->code_length, sizeof(uint32_t), 4));
+            function->chunk.code = image + record->code_offset;
+            function->chunk.source_lines = (uint32_t*)(image + record->lines_offset);
+            function->chunk.used = record->code_length;
+            function->chunk.allocated = record->code_length;
+            function->chunk.mapped = true;
+
+            CLOX_BYTECODE_CACHE_CHECK(Clox_Bytecode_Cache_Holds(cache, record->inline_sites_offset, record->inline_site_count, sizeof(Clox_Bytecode_Cache_Inline_Site), 8));
+            Clox_Bytecode_Cache_Inline_Site const* sites = (Clox_Bytecode_Cache_Inline_Site const*)(image + record->inline_sites_offset);
+            for (uint32_t s = 0; s < record->inline_site_count; ++s) {
+                CLOX_BYTECODE_CACHE_CHECK(sites[s].start <= sites[s].end && sites[s].end <= record->code_length && sites[s].callee < header.string_count);
+                Clox_Chunk_Push_Inline_Site(&function->chunk, (Clox_Inline_Site){
+                    .start = sites[s].start,
+                    .end = sites[s].end,
+                    .call_line = sites[s].call_line,
+                    .callee = strings[sites[s].callee],
+                });
+            }
+        } else {
+            // NOTE(Al-Andrew): a stub, as the compiler leaves it. Clox_Compile_Lazy_Function fills in the rest
+            CLOX_BYTECODE_CACHE_CHECK(record->code_length == 0 && record->lazy_offset < source->length);
+            CLOX_BYTECODE_CACHE_CHECK(record->constant_count == 0 && record->call_cache_count == 0 && record->upvalue_count == 0);
+            CLOX_BYTECODE_CACHE_CHECK(record->inline_site_count == 0);
+            function->lazy_source = source->text + record->lazy_offset;
+            function->lazy_line = record->lazy_line;
+        }
+
+        function->name = record->name == CLOX_BYTECODE_CACHE_NONE ? NULL : strings[record->name];
+        function->arity = record->arity;
+        function->upvalue_count = record->upvalue_count;
+        function->has_captured_locals = record->has_captured_locals != 0;
+        function->call_cache_count = record->call_cache_count;
+        Clox_Function_Allocate_Call_Caches(function);
+
+        Clox_Bytecode_Cache_Constant const* constants = (Clox_Bytecode_Cache_Constant const*)(image + record->constants_offset);
+        for (uint32_t c = 0; c < record->constant_count; ++c) {
+            Clox_Value value = CLOX_VALUE_NIL;
+            switch ((Clox_Bytecode_Cache_Constant_Type)constants[c].type) {
+                case CLOX_BYTECODE_CACHE_CONSTANT_NIL: {
+                    value = CLOX_VALUE_NIL;
+                } break;
+                case CLOX_BYTECODE_CACHE_CONSTANT_BOOL: {
+                    value = CLOX_VALUE_BOOL(constants[c].bits != 0);
+                } break;
+                case CLOX_BYTECODE_CACHE_CONSTANT_NUMBER: {
+                    double number;
+                    memcpy(&number, &constants[c].bits, sizeof(number));
+                    value = CLOX_VALUE_NUMBER(number);
+                } break;
+                case CLOX_BYTECODE_CACHE_CONSTANT_INTEGER: {
+                    CLOX_BYTECODE_CACHE_CHECK(Clox_Value_Integer_Fits((int64_t)constants[c].bits));
+                    value = CLOX_VALUE_INTEGER((int64_t)constants[c].bits);
+                } break;
+                case CLOX_BYTECODE_CACHE_CONSTANT_STRING: {
+                    CLOX_BYTECODE_CACHE_CHECK(constants[c].index < header.string_count);
+                    value = CLOX_VALUE_OBJECT(strings[constants[c].index]);
+                } break;
+                case CLOX_BYTECODE_CACHE_CONSTANT_FUNCTION: {
+                    // NOTE(Al-Andrew): Store numbers functions in the order it finds them in constants, so a function
+                    //                  only ever names later ones. anything else is a cycle the verifier would walk.
+                    CLOX_BYTECODE_CACHE_CHECK(constants[c].index > i && constants[c].index < header.function_count);
+                    value = CLOX_VALUE_OBJECT(functions[constants[c].index]);
+                } break;
+                default: {
+                    goto failed;
+                } break;
+            }
+            Clox_Value_Array_Push_Back(&function->chunk.constants, value);
+        }
+
+        if (i != 0 && function->upvalue_count == 0) {
+            function->canonical_closure = Clox_Closure_Create(vm, function); // NOTE(Al-Andrew): as Clox_Compiler_End does
+        }
+    }
+
+    Clox_Function* script = functions[0];
+    deallocate(strings);
+    deallocate(functions);
+    return script;
+
+failed:
+    // NOTE(Al-Andrew): whatever was made so far stays on the VM's object list, unreachable, and goes with the VM.
+    //                  their chunks are marked mapped, so nothing ever frees or reads the code they pointed at.
+    deallocate(strings);
+    deallocate(functions);
+    Clox_Bytecode_Cache_Unmap(cache);
+    return NULL;
+}
+
+typedef struct {
+    uint8_t* bytes;
+    size_t used;
+    size_t allocated;
+} Clox_Bytecode_Cache_Writer;
+
+// NOTE(Al-Andrew): zeroed room for `size` bytes at the next multiple of 8, as an offset since growing moves the bytes
+static uint64_t Clox_Bytecode_Cache_Reserve(Clox_Bytecode_Cache_Writer* writer, size_t size) {
+    size_t offset = (writer->used + 7) & ~(size_t)7;
+    if (offset + size > writer->allocated) {
+        size_t allocated = writer->allocated == 0 ? 4096 : writer->allocated;
+        while (offset + size > allocated) {
+            allocated *= 2;
+        }
+        writer->bytes = reallocate(writer->bytes, writer->allocated, allocated); // TODO(Al-Andrew, AllocFailure): handle
+        writer->allocated = allocated;
+    }
+    memset(writer->bytes + writer->used, 0, offset + size - writer->used);
+    writer->used = offset + size;
+    return offset;
+}
+
+static uint32_t Clox_Bytecode_Cache_Index_Of(Clox_Value_Array* array, Clox_Value_Index_Map* map, Clox_Value value) {
+    uint32_t* slot = Clox_Value_Index_Map_Slot(map, array, value);
+    if (*slot == 0) {
+        Clox_Value_Array_Push_Back(array, value);
+        *slot = array->used;
+    }
+    return *slot - 1;
+}
+
+static bool Clox_Bytecode_Cache_Write_Function(Clox_Bytecode_Cache_Writer* writer, uint64_t record_offset, Clox_Function* function,
+                                               Clox_Source const* source, Clox_Value_Array* functions, Clox_Value_Index_Map* function_map,
+                                               Clox_Value_Array* strings, Clox_Value_Index_Map* string_map) {
+    Clox_Chunk* chunk = &function->chunk;
+    uint64_t constants_offset = Clox_Bytecode_Cache_Reserve(writer, sizeof(Clox_Bytecode_Cache_Constant) * chunk->constants.used);
+    for (uint32_t c = 0; c < chunk->constants.used; ++c) {
+        Clox_Value value = chunk->constants.values[c];
+        Clox_Bytecode_Cache_Constant constant = {0};
+        if (CLOX_VALUE_IS_NIL(value)) {
+            constant.type = CLOX_BYTECODE_CACHE_CONSTANT_NIL;
+        } else if (CLOX_VALUE_IS_BOOL(value)) {
+            constant.type = CLOX_BYTECODE_CACHE_CONSTANT_BOOL;
+            constant.bits = CLOX_VALUE_AS_BOOL(value) ? 1 : 0;
+        } else if (CLOX_VALUE_IS_INTEGER(value)) {
+            constant.type = CLOX_BYTECODE_CACHE_CONSTANT_INTEGER;
+            constant.bits = (uint64_t)CLOX_VALUE_AS_INTEGER(value);
+        } else if (CLOX_VALUE_IS_NUMBER(value)) {
+            double number = CLOX_VALUE_AS_DOUBLE(value);
+            constant.type = CLOX_BYTECODE_CACHE_CONSTANT_NUMBER;
+            memcpy(&constant.bits, &number, sizeof(number));
+        } else if (CLOX_VALUE_IS_OBJECT(value) && CLOX_VALUE_AS_OBJECT(value)->type == CLOX_OBJECT_TYPE_STRING) {
+            constant.type = CLOX_BYTECODE_CACHE_CONSTANT_STRING;
+            constant.index = Clox_Bytecode_Cache_Index_Of(strings, string_map, value);
+        } else if (CLOX_VALUE_IS_OBJECT(value) && CLOX_VALUE_AS_OBJECT(value)->type == CLOX_OBJECT_TYPE_FUNCTION) {
+            constant.type = CLOX_BYTECODE_CACHE_CONSTANT_FUNCTION;
+            constant.index = Clox_Bytecode_Cache_Index_Of(functions, function_map, value);
+        } else {
+            return false; // NOTE(Al-Andrew): the compiler never makes any other constant
+        }
+        memcpy(writer->bytes + constants_offset + sizeof(constant) * c, &constant, sizeof(constant));
+    }
+
+    Clox_Bytecode_Cache_Function record = {
+        .constants_offset = constants_offset,
+        .lazy_offset = CLOX_BYTECODE_CACHE_NOT_LAZY,
+        .code_length = chunk->used,
+        .constant_count = chunk->constants.used,
+        .name = function->name == NULL ? CLOX_BYTECODE_CACHE_NONE : Clox_Bytecode_Cache_Index_Of(strings, string_map, CLOX_VALUE_OBJECT(function->name)),
+        .call_cache_count = function->call_cache_count,
+        .arity = function->arity,
+        .upvalue_count = function->upvalue_count,
+        .has_captured_locals = function->has_captured_locals,
+    };
+    if (function->lazy_source != NULL) {
+        CLOX_DEV_ASSERT(function->lazy_source >= source->text && function->lazy_source < source->text + source->length);
+        record.lazy_offset = (uint64_t)(function->lazy_source - source->text);
+        record.lazy_line = function->lazy_line;
+    } else {
+        record.lines_offset = Clox_Bytecode_Cache_Reserve(writer, sizeof(uint32_t) * chunk->used);
+        memcpy(writer->bytes + record.lines_offset, chunk->source_lines, sizeof(uint32_t) * chunk->used);
+        record.code_offset = Clox_Bytecode_Cache_Reserve(writer, chunk->used);
+        memcpy(writer->bytes + record.code_offset, chunk->code, chunk->used);
+        record.inline_site_count = chunk->inline_site_count;
+        record.inline_sites_offset = Clox_Bytecode_Cache_Reserve(writer, sizeof(Clox_Bytecode_Cache_Inline_Site) * chunk->inline_site_count);
+        for (uint32_t s = 0; s < chunk->inline_site_count; ++s) {
+            Clox_Inline_Site const* site = &chunk->inline_sites[s];
+            Clox_Bytecode_Cache_Inline_Site stored = {
+                .start = site->start,
+                .end = site->end,
+                .call_line = site->call_line,
+                .callee = Clox_Bytecode_Cache_Index_Of(strings, string_map, CLOX_VALUE_OBJECT(site->callee)),
+            };
+            memcpy(writer->bytes + record.inline_sites_offset + sizeof(stored) * s, &stored, sizeof(stored));
+        }
+    }
+    memcpy(writer->bytes + record_offset, &record, sizeof(record));
+    return true;
+}
+
+bool Clox_Bytecode_Cache_Store(Clox_Bytecode_Cache* cache, Clox_VM* vm, Clox_Function* script, Clox_Source const* source) {
+    CLOX_DEV_ASSERT(cache != NULL && script != NULL && source != NULL);
+    if (cache->path[0] == '\0') {
+        return false;
+    }
+
+    Clox_Value_Array functions = Clox_Value_Array_New_Empty();
+    Clox_Value_Index_Map function_map = {0};
+    Clox_Value_Array strings = Clox_Value_Array_New_Empty();
+    Clox_Value_Index_Map string_map = {0};
+    Clox_Bytecode_Cache_Writer writer = {0};
+
+    // NOTE(Al-Andrew): every function sits in the constants of the one it is declared in, so this finds them all
+    Clox_Bytecode_Cache_Index_Of(&functions, &function_map, CLOX_VALUE_OBJECT(script));
+    for (uint32_t i = 0; i < functions.used; ++i) {
+        Clox_Chunk* chunk = &((Clox_Function*)CLOX_VALUE_AS_OBJECT(functions.values[i]))->chunk;
+        for (uint32_t c = 0; c < chunk->constants.used; ++c) {
+            Clox_Value value = chunk->constants.values[c];
+            if (CLOX_VALUE_IS_OBJECT(value) && CLOX_VALUE_AS_OBJECT(value)->type == CLOX_OBJECT_TYPE_FUNCTION) {
+                Clox_Bytecode_Cache_Index_Of(&functions, &function_map, value);
+            }
+        }
+    }
+
+    Clox_Bytecode_Cache_Header header = {
+        .magic = {'L', 'O', 'X', 'C'},
+        .version = CLOX_BYTECODE_CACHE_VERSION,
+        .byte_order = CLOX_BYTECODE_CACHE_BYTE_ORDER,
+        .config = Clox_Bytecode_Cache_Config(vm),
+        .key = cache->key,
+        .source_length = source->length,
+        .global_count = vm->global_names.used,
+        .function_count = functions.used,
+    };
+    uint64_t header_offset = Clox_Bytecode_Cache_Reserve(&writer, sizeof(header));
+
+    header.globals_offset = Clox_Bytecode_Cache_Reserve(&writer, sizeof(uint32_t) * vm->global_names.used);
+    for (uint32_t i = 0; i < vm->global_names.used; ++i) {
+        uint32_t name = Clox_Bytecode_Cache_Index_Of(&strings, &string_map, vm->global_names.values[i]);
+        memcpy(writer.bytes + header.globals_offset + sizeof(name) * i, &name, sizeof(name));
+    }
+
+    header.functions_offset = Clox_Bytecode_Cache_Reserve(&writer, sizeof(Clox_Bytecode_Cache_Function) * functions.used);
+    bool ok = true;
+    for (uint32_t i = 0; ok && i < functions.used; ++i) {
+        uint64_t record_offset = header.functions_offset + sizeof(Clox_Bytecode_Cache_Function) * i;
+        ok = Clox_Bytecode_Cache_Write_Function(&writer, record_offset, (Clox_Function*)CLOX_VALUE_AS_OBJECT(functions.values[i]),
+                                                source, &functions, &function_map, &strings, &string_map);
+    }
+    CLOX_DEV_ASSERT(!ok || header.function_count == functions.used);
+
+    header.string_count = strings.used;
+    header.strings_offset = Clox_Bytecode_Cache_Reserve(&writer, sizeof(Clox_Bytecode_Cache_String) * strings.used);
+    for (uint32_t i = 0; ok && i < strings.used; ++i) {
+        Clox_String* string = (Clox_String*)CLOX_VALUE_AS_OBJECT(strings.values[i]);
+        Clox_Bytecode_Cache_String entry = {.offset = Clox_Bytecode_Cache_Reserve(&writer, string->length), .length = string->length};
+        memcpy(writer.bytes + entry.offset, string->characters, string->length);
+        memcpy(writer.bytes + header.strings_offset + sizeof(entry) * i, &entry, sizeof(entry));
+    }
+    memcpy(writer.bytes + header_offset, &header, sizeof(header));
+
+    // NOTE(Al-Andrew): written next to the image and renamed over it, so a running clox never sees half an image and
+    //                  never has the file it mapped truncated under it
+    char temporary[CLOX_BYTECODE_CACHE_MAX_PATH + 32];
+    #ifdef CLOX_SOURCE_POSIX
+        snprintf(temporary, sizeof(temporary), "%s.%ld.tmp", cache->path, (long)getpid());
+    #else
+        snprintf(temporary, sizeof(temporary), "%s.tmp", cache->path);
+    #endif // CLOX_SOURCE_POSIX
+    FILE* file = ok ? fopen(temporary, "wb") : NULL;
+    if (file != NULL) {
+        ok = fwrite(writer.bytes, 1, writer.used, file) == writer.used;
+        ok = fclose(file) == 0 && ok;
+        ok = ok && rename(temporary, cache->path) == 0;
+        if (!ok) {
+            remove(temporary);
+        }
+    } else {
+        ok = false;
+    }
+
+    deallocate(writer.bytes);
+    Clox_Value_Array_Delete(&functions);
+    Clox_Value_Index_Map_Delete(&function_map);
+    Clox_Value_Array_Delete(&strings);
+    Clox_Value_Index_Map_Delete(&string_map);
+    return ok;
+}
\ No newline at end of file
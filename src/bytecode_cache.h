@@ -0,0 +1,39 @@
+#ifndef CLOX_BYTECODE_CACHE_H_INCLUDED
+#define CLOX_BYTECODE_CACHE_H_INCLUDED
+
+#include "common.h"
+#include "object.h"
+#include "source.h"
+
+// NOTE(Al-Andrew): bump on any change to the image layout or to what the compiler emits for the same source, old
+//                  images are then ignored and written again.
+#define CLOX_BYTECODE_CACHE_VERSION 3
+
+#ifndef CLOX_BYTECODE_CACHE_MAX_PATH
+#define CLOX_BYTECODE_CACHE_MAX_PATH 4096
+#endif // CLOX_BYTECODE_CACHE_MAX_PATH
+
+// NOTE(Al-Andrew): compiled programs kept on disk (`clox -C`) as `<key>.loxc` images, the key hashes the source text
+//                  together with everything that changes the compiler's output (-O, -L, NaN boxing, superinstructions).
+//                  the directory is $CLOX_CACHE_DIR, else $XDG_CACHE_HOME/clox, else $HOME/.cache/clox.
+//                  a loaded image is mapped copy on write and the functions run their code and line info straight from
+//                  it, quickening only copies the pages it touches. strings, constants and the function objects
+//                  themselves are still made on load, and the whole tree goes through the verifier like a compiled one.
+typedef struct {
+    char path[CLOX_BYTECODE_CACHE_MAX_PATH];
+    uint64_t key;
+    void* image;
+    size_t image_size;
+    bool mapped; // NOTE(Al-Andrew): `image` is a mapping, else a heap copy
+} Clox_Bytecode_Cache;
+
+// NOTE(Al-Andrew): false if there is no cache directory to use, nothing else is then ever read or written
+bool Clox_Bytecode_Cache_Open(Clox_Bytecode_Cache* cache, Clox_VM const* vm, Clox_Source const* source);
+// NOTE(Al-Andrew): the script function of the cached image, NULL if there is none or it doesn't fit this build. the
+//                  cache and `source` (lazy functions) have to outlive the VM.
+Clox_Function* Clox_Bytecode_Cache_Load(Clox_Bytecode_Cache* cache, Clox_VM* vm, Clox_Source const* source);
+// NOTE(Al-Andrew): writes `script` out, before it first runs, so no quickened opcodes end up in the image
+bool Clox_Bytecode_Cache_Store(Clox_Bytecode_Cache* cache, Clox_VM* vm, Clox_Function* script, Clox_Source const* source);
+void Clox_Bytecode_Cache_Delete(Clox_Bytecode_Cache* cache);
+
+#endif // CLOX_BYTECODE_CACHE_H_INCLUDED
\ No newline at end of file
@@ -9,12 +9,15 @@ Clox_Chunk Clox_Chunk_New_Empty() {
 }
 
 void Clox_Chunk_Delete(Clox_Chunk* const chunk) {
-    if(chunk->code) {
+    if(chunk->code && !chunk->mapped) {
         deallocate(chunk->code);
     }
-    if(chunk->source_lines) {
+    if(chunk->source_lines && !chunk->mapped) {
         deallocate(chunk->source_lines);
     }
+    if(chunk->inline_sites) {
+        deallocate(chunk->inline_sites);
+    }
     Clox_Value_Array_Delete(&chunk->constants);
     *chunk = (Clox_Chunk){0};
 
@@ -22,7 +25,7 @@ void Clox_Chunk_Delete(Clox_Chunk* const chunk) {
 }
 
 void Clox_Chunk_Push(Clox_Chunk* const chunk, uint8_t const data, uint32_t const source_line) {
-    CLOX_DEV_ASSERT(chunk != NULL);
+    CLOX_DEV_ASSERT(chunk != NULL && !chunk->mapped);
 
     if(chunk->used >= chunk->allocated) {
         chunk->allocated = (chunk->allocated == 0)?(8):(chunk->allocated*2);
@@ -46,6 +49,21 @@ uint32_t Clox_Chunk_Push_Constant(Clox_Chunk* const chunk, Clox_Value const valu
     return chunk->constants.used - 1;
 }
 
+void Clox_Chunk_Push_Inline_Site(Clox_Chunk* const chunk, Clox_Inline_Site const site) {
+    CLOX_DEV_ASSERT(chunk != NULL && site.start <= site.end && site.end <= chunk->used);
+
+    // NOTE(Al-Andrew): a handful per function at most, grow one at a time
+    chunk->inline_sites = reallocate(chunk->inline_sites, 0, sizeof(Clox_Inline_Site) * (chunk->inline_site_count + 1)); // TODO(Al-Andrew, AllocFailure): handle
+    chunk->inline_sites[chunk->inline_site_count++] = site;
+}
+
+void Clox_Chunk_Move_Inline_Sites(Clox_Chunk* const chunk, uint32_t const* moved_to) {
+    for (uint32_t i = 0; i < chunk->inline_site_count; ++i) {
+        chunk->inline_sites[i].start = moved_to[chunk->inline_sites[i].start];
+        chunk->inline_sites[i].end = moved_to[chunk->inline_sites[i].end];
+    }
+}
+
 void Clox_Chunk_Print(Clox_Chunk* const chunk, char const* const name) {
     CLOX_DEV_ASSERT(chunk != NULL);
     
@@ -59,6 +77,260 @@ void Clox_Chunk_Print(Clox_Chunk* const chunk, char const* const name) {
     return;
 }
 
+static char const* const s_clox_op_code_names[] = {
+    [OP_RETURN]              = "OP_RETURN",
+    [OP_CONSTANT]            = "OP_CONSTANT",
+    [OP_NIL]                 = "OP_NIL",
+    [OP_TRUE]                = "OP_TRUE",
+    [OP_FALSE]               = "OP_FALSE",
+    [OP_ARITHMETIC_NEGATION] = "OP_ARITHMETIC_NEGATION",
+    [OP_ADD]                 = "OP_ADD",
+    [OP_SUB]                 = "OP_SUB",
+    [OP_MUL]                 = "OP_MUL",
+    [OP_DIV]                 = "OP_DIV",
+    [OP_BOOLEAN_NEGATION]    = "OP_BOOLEAN_NEGATION",
+    [OP_EQUAL]               = "OP_EQUAL",
+    [OP_GREATER]             = "OP_GREATER",
+    [OP_LESS]                = "OP_LESS",
+    [OP_PRINT]               = "OP_PRINT",
+    [OP_POP]                 = "OP_POP",
+    [OP_DEFINE_GLOBAL]       = "OP_DEFINE_GLOBAL",
+    [OP_GET_GLOBAL]          = "OP_GET_GLOBAL",
+    [OP_SET_GLOBAL]          = "OP_SET_GLOBAL",
+    [OP_GET_LOCAL]           = "OP_GET_LOCAL",
+    [OP_SET_LOCAL]           = "OP_SET_LOCAL",
+    [OP_GET_UPVALUE]         = "OP_GET_UPVALUE",
+    [OP_SET_UPVALUE]         = "OP_SET_UPVALUE",
+    [OP_GET_FLAT_UPVALUE]    = "OP_GET_FLAT_UPVALUE",
+    [OP_JUMP]                = "OP_JUMP",
+    [OP_JUMP_IF_FALSE]       = "OP_JUMP_IF_FALSE",
+    [OP_LOOP]                = "OP_LOOP",
+    [OP_CALL]                = "OP_CALL",
+    [OP_TAIL_CALL]           = "OP_TAIL_CALL",
+    [OP_CLOSURE]             = "OP_CLOSURE",
+    [OP_CLOSE_UPVALUE]       = "OP_CLOSE_UPVALUE",
+    [OP_NOT_EQUAL]           = "OP_NOT_EQUAL",
+    [OP_GREATER_EQUAL]       = "OP_GREATER_EQUAL",
+    [OP_LESS_EQUAL]          = "OP_LESS_EQUAL",
+    [OP_CONSTANT_LONG]       = "OP_CONSTANT_LONG",
+    [OP_CLOSURE_LONG]        = "OP_CLOSURE_LONG",
+    [OP_SMALL_INT]           = "OP_SMALL_INT",
+    [OP_WIDE]                = "OP_WIDE",
+    [OP_JUMP_LONG]           = "OP_JUMP_LONG",
+    [OP_JUMP_IF_FALSE_LONG]  = "OP_JUMP_IF_FALSE_LONG",
+    [OP_LOOP_LONG]           = "OP_LOOP_LONG",
+    [OP_JUMP_IF_NOT_EQUAL]   = "OP_JUMP_IF_NOT_EQUAL",
+    [OP_JUMP_IF_EQUAL]       = "OP_JUMP_IF_EQUAL",
+    [OP_JUMP_IF_NOT_GREATER] = "OP_JUMP_IF_NOT_GREATER",
+    [OP_JUMP_IF_NOT_GREATER_EQUAL] = "OP_JUMP_IF_NOT_GREATER_EQUAL",
+    [OP_JUMP_IF_NOT_LESS]    = "OP_JUMP_IF_NOT_LESS",
+    [OP_JUMP_IF_NOT_LESS_EQUAL] = "OP_JUMP_IF_NOT_LESS_EQUAL",
+    [OP_ADD_NUM]             = "OP_ADD_NUM",
+    [OP_ADD_STR]             = "OP_ADD_STR",
+    [OP_SUB_NUM]             = "OP_SUB_NUM",
+    [OP_MUL_NUM]             = "OP_MUL_NUM",
+    [OP_DIV_NUM]             = "OP_DIV_NUM",
+    [OP_EQUAL_NUM]           = "OP_EQUAL_NUM",
+    [OP_GREATER_NUM]         = "OP_GREATER_NUM",
+    [OP_LESS_NUM]            = "OP_LESS_NUM",
+    [OP_ADD_INT]             = "OP_ADD_INT",
+    [OP_SUB_INT]             = "OP_SUB_INT",
+    [OP_MUL_INT]             = "OP_MUL_INT",
+    [OP_EQUAL_INT]           = "OP_EQUAL_INT",
+    [OP_GREATER_INT]         = "OP_GREATER_INT",
+    [OP_LESS_INT]            = "OP_LESS_INT",
+    [OP_GET_LOCAL_GET_LOCAL] = "OP_GET_LOCAL_GET_LOCAL",
+    [OP_GET_LOCAL_CONSTANT]  = "OP_GET_LOCAL_CONSTANT",
+    [OP_GET_LOCAL_GET_LOCAL_ADD] = "OP_GET_LOCAL_GET_LOCAL_ADD",
+    [OP_GET_LOCAL_CONSTANT_ADD]  = "OP_GET_LOCAL_CONSTANT_ADD",
+    [OP_GET_LOCAL_CONSTANT_JUMP_IF_NOT_LESS] = "OP_GET_LOCAL_CONSTANT_JUMP_IF_NOT_LESS",
+    [OP_SET_LOCAL_POP]       = "OP_SET_LOCAL_POP",
+    [OP_SET_GLOBAL_POP]      = "OP_SET_GLOBAL_POP",
+    [OP_JUMP_IF_FALSE_POP]   = "OP_JUMP_IF_FALSE_POP",
+    [OP_POP_LOOP]            = "OP_POP_LOOP",
+    [OP_GET_LOCAL_SMALL_INT] = "OP_GET_LOCAL_SMALL_INT",
+    [OP_GET_LOCAL_SMALL_INT_ADD] = "OP_GET_LOCAL_SMALL_INT_ADD",
+    [OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS] = "OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS",
+};
+
+char const* Clox_Op_Code_Name(Clox_Op_Code const opcode) {
+    if ((uint32_t)opcode >= sizeof(s_clox_op_code_names) / sizeof(s_clox_op_code_names[0]) || s_clox_op_code_names[opcode] == NULL) {
+        return "OP_UNKNOWN";
+    }
+    return s_clox_op_code_names[opcode];
+}
+
+Clox_Op_Code Clox_Op_Code_Generic(Clox_Op_Code const opcode) {
+    switch (opcode) {
+        case OP_ADD_NUM: /* fallthrough */
+        case OP_ADD_INT: /* fallthrough */
+        case OP_ADD_STR: return OP_ADD;
+        case OP_SUB_NUM: /* fallthrough */
+        case OP_SUB_INT: return OP_SUB;
+        case OP_MUL_NUM: /* fallthrough */
+        case OP_MUL_INT: return OP_MUL;
+        case OP_DIV_NUM: return OP_DIV;
+        case OP_EQUAL_NUM: /* fallthrough */
+        case OP_EQUAL_INT: return OP_EQUAL;
+        case OP_GREATER_NUM: /* fallthrough */
+        case OP_GREATER_INT: return OP_GREATER;
+        case OP_LESS_NUM: /* fallthrough */
+        case OP_LESS_INT: return OP_LESS;
+        case OP_GET_LOCAL_GET_LOCAL: /* fallthrough */
+        case OP_GET_LOCAL_CONSTANT: /* fallthrough */
+        case OP_GET_LOCAL_GET_LOCAL_ADD: /* fallthrough */
+        case OP_GET_LOCAL_CONSTANT_ADD: /* fallthrough */
+        case OP_GET_LOCAL_CONSTANT_JUMP_IF_NOT_LESS: /* fallthrough */
+        case OP_GET_LOCAL_SMALL_INT: /* fallthrough */
+        case OP_GET_LOCAL_SMALL_INT_ADD: /* fallthrough */
+        case OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS: return OP_GET_LOCAL;
+        case OP_SET_LOCAL_POP: return OP_SET_LOCAL;
+        case OP_SET_GLOBAL_POP: return OP_SET_GLOBAL;
+        case OP_JUMP_IF_FALSE_POP: return OP_JUMP_IF_FALSE;
+        case OP_POP_LOOP: return OP_POP;
+        default: return opcode;
+    }
+}
+
+uint32_t Clox_Op_Code_Operand_Length(Clox_Op_Code const opcode) {
+    switch (Clox_Op_Code_Generic(opcode)) {
+        case OP_CONSTANT: /* fallthrough */
+        case OP_GET_LOCAL: /* fallthrough */
+        case OP_SET_LOCAL: /* fallthrough */
+        case OP_GET_UPVALUE: /* fallthrough */
+        case OP_SET_UPVALUE: /* fallthrough */
+        case OP_GET_FLAT_UPVALUE: /* fallthrough */
+        case OP_CLOSURE: /* fallthrough */
+        case OP_SMALL_INT: {
+            return 1;
+        } break;
+        case OP_CONSTANT_LONG: /* fallthrough */
+        case OP_CLOSURE_LONG: /* fallthrough */
+        case OP_DEFINE_GLOBAL: /* fallthrough */
+        case OP_GET_GLOBAL: /* fallthrough */
+        case OP_SET_GLOBAL: /* fallthrough */
+        case OP_JUMP: /* fallthrough */
+        case OP_JUMP_IF_FALSE: /* fallthrough */
+        case OP_JUMP_IF_NOT_EQUAL: /* fallthrough */
+        case OP_JUMP_IF_EQUAL: /* fallthrough */
+        case OP_JUMP_IF_NOT_GREATER: /* fallthrough */
+        case OP_JUMP_IF_NOT_GREATER_EQUAL: /* fallthrough */
+        case OP_JUMP_IF_NOT_LESS: /* fallthrough */
+        case OP_JUMP_IF_NOT_LESS_EQUAL: /* fallthrough */
+        case OP_LOOP: {
+            return 2;
+        } break;
+        case OP_CALL: /* fallthrough */
+        case OP_TAIL_CALL: /* fallthrough */
+        case OP_WIDE: {
+            return 3;
+        } break;
+        case OP_JUMP_LONG: /* fallthrough */
+        case OP_JUMP_IF_FALSE_LONG: /* fallthrough */
+        case OP_LOOP_LONG: {
+            return 4;
+        } break;
+        default: {
+            return 0;
+        } break;
+    }
+}
+
+bool Clox_Op_Code_Is_Compare_And_Branch(Clox_Op_Code const opcode) {
+    return opcode >= OP_JUMP_IF_NOT_EQUAL && opcode <= OP_JUMP_IF_NOT_LESS_EQUAL;
+}
+
+// NOTE(Al-Andrew): the passes that rewrite code only know the compact encoding, they leave chunks with these alone
+bool Clox_Chunk_Has_Wide_Operands(Clox_Chunk* const chunk) {
+    for (uint32_t offset = 0; offset < chunk->used; offset += Clox_Chunk_Instruction_Length(chunk, offset)) {
+        switch (chunk->code[offset]) {
+            case OP_WIDE: /* fallthrough */
+            case OP_JUMP_LONG: /* fallthrough */
+            case OP_JUMP_IF_FALSE_LONG: /* fallthrough */
+            case OP_LOOP_LONG: {
+                return true;
+            } break;
+            case OP_CLOSURE: /* fallthrough */
+            case OP_CLOSURE_LONG: {
+                // NOTE(Al-Andrew): every capture up to the first wide one is two bytes
+                uint32_t length = Clox_Chunk_Instruction_Length(chunk, offset);
+                for (uint32_t capture = chunk->code[offset] == OP_CLOSURE ? 2 : 3; capture < length; capture += 2) {
+                    if (chunk->code[offset + capture] & CLOX_CAPTURE_FLAG_WIDE) return true;
+                }
+            } break;
+            default: break;
+        }
+    }
+    return false;
+}
+
+// NOTE(Al-Andrew): the comparison a compare-and-branch opcode evaluates, it jumps when that comes out false.
+Clox_Op_Code Clox_Op_Code_Branch_Comparison(Clox_Op_Code const opcode) {
+    switch (opcode) {
+        case OP_JUMP_IF_NOT_EQUAL: return OP_EQUAL;
+        case OP_JUMP_IF_EQUAL: return OP_NOT_EQUAL;
+        case OP_JUMP_IF_NOT_GREATER: return OP_GREATER;
+        case OP_JUMP_IF_NOT_GREATER_EQUAL: return OP_GREATER_EQUAL;
+        case OP_JUMP_IF_NOT_LESS: return OP_LESS;
+        case OP_JUMP_IF_NOT_LESS_EQUAL: return OP_LESS_EQUAL;
+        default: CLOX_UNREACHABLE();
+    }
+    return OP_RETURN;
+}
+
+// NOTE(Al-Andrew): captures are a flags byte and an index byte, or an index short with CLOX_CAPTURE_FLAG_WIDE
+static uint32_t Clox_Chunk_Closure_Length(Clox_Chunk* const chunk, uint32_t const offset) {
+    uint32_t length = chunk->code[offset] == OP_CLOSURE ? 2 : 3;
+    uint16_t constant = chunk->code[offset] == OP_CLOSURE ? chunk->code[offset + 1] : (uint16_t)((chunk->code[offset + 1] << 8) | chunk->code[offset + 2]);
+    Clox_Function* function = (Clox_Function*)(CLOX_VALUE_AS_OBJECT(chunk->constants.values[constant]));
+    for (int i = 0; i < function->upvalue_count; i++) {
+        length += (chunk->code[offset + length] & CLOX_CAPTURE_FLAG_WIDE) ? 3 : 2;
+    }
+    return length;
+}
+
+uint32_t Clox_Chunk_Instruction_Length(Clox_Chunk* const chunk, uint32_t const offset) {
+    CLOX_DEV_ASSERT(chunk != NULL);
+    CLOX_DEV_ASSERT(offset < chunk->used);
+
+    Clox_Op_Code opcode = chunk->code[offset];
+    switch (opcode) {
+        case OP_CLOSURE: /* fallthrough */
+        case OP_CLOSURE_LONG: {
+            return Clox_Chunk_Closure_Length(chunk, offset);
+        } break;
+        case OP_GET_LOCAL_GET_LOCAL: /* fallthrough */
+        case OP_GET_LOCAL_CONSTANT: /* fallthrough */
+        case OP_GET_LOCAL_SMALL_INT: {
+            return 2 + 2;
+        } break;
+        case OP_GET_LOCAL_GET_LOCAL_ADD: /* fallthrough */
+        case OP_GET_LOCAL_CONSTANT_ADD: /* fallthrough */
+        case OP_GET_LOCAL_SMALL_INT_ADD: {
+            return 2 + 2 + 1;
+        } break;
+        case OP_GET_LOCAL_CONSTANT_JUMP_IF_NOT_LESS: /* fallthrough */
+        case OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS: {
+            return 2 + 2 + 3;
+        } break;
+        case OP_SET_LOCAL_POP: {
+            return 2 + 1;
+        } break;
+        case OP_SET_GLOBAL_POP: {
+            return 3 + 1;
+        } break;
+        case OP_JUMP_IF_FALSE_POP: {
+            return 3 + 1;
+        } break;
+        case OP_POP_LOOP: {
+            return 1 + 3;
+        } break;
+        default: {
+            return 1 + Clox_Op_Code_Operand_Length(opcode);
+        } break;
+    }
+}
+
 uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset) {
     CLOX_DEV_ASSERT(chunk != NULL);
     CLOX_DEV_ASSERT(offset <= chunk->used);
@@ -85,6 +357,17 @@ uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset
             printf("'\n");
             return offset + 2;    
         } break;
+        case OP_CONSTANT_LONG: {
+            uint16_t constant_idx = (uint16_t)((chunk->code[offset + 1] << 8) | chunk->code[offset + 2]);
+            printf("%-16s %4d '", "OP_CONSTANT_LONG", constant_idx);
+            Clox_Value_Print(chunk->constants.values[constant_idx]);
+            printf("'\n");
+            return offset + 3;
+        } break;
+        case OP_SMALL_INT: {
+            printf("%-16s %4d\n", "OP_SMALL_INT", (int8_t)chunk->code[offset + 1]);
+            return offset + 2;
+        } break;
         case OP_NIL: {
             printf("OP_NIL\n");
             return offset + 1;
@@ -133,6 +416,12 @@ uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset
             printf("OP_EQUAL\n");
             return offset + 1;
         } break;
+        case OP_NOT_EQUAL: /* fallthrough */
+        case OP_GREATER_EQUAL: /* fallthrough */
+        case OP_LESS_EQUAL: {
+            printf("%s\n", Clox_Op_Code_Name(opcode));
+            return offset + 1;
+        } break;
         case OP_PRINT: {
             printf("OP_PRINT\n");
             return offset + 1;
@@ -142,25 +431,22 @@ uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset
             return offset + 1;
         } break;
         case OP_DEFINE_GLOBAL: {
-            uint8_t var_name_idx = chunk->code[offset + 1];
-            printf("%-16s %4d '", "OP_DEFINE_GLOBAL", var_name_idx);
-            Clox_Value_Print(chunk->constants.values[var_name_idx]);
-            printf("'\n");
-            return offset + 2;
+            uint16_t slot = (uint16_t)(chunk->code[offset + 1] << 8);
+            slot |= chunk->code[offset + 2];
+            printf("%-16s slot %4d\n", "OP_DEFINE_GLOBAL", slot);
+            return offset + 3;
         } break;
         case OP_GET_GLOBAL: {
-            uint8_t var_name_idx = chunk->code[offset + 1];
-            printf("%-16s %4d '", "OP_GET_GLOBAL", var_name_idx);
-            Clox_Value_Print(chunk->constants.values[var_name_idx]);
-            printf("'\n");
-            return offset + 2;
+            uint16_t slot = (uint16_t)(chunk->code[offset + 1] << 8);
+            slot |= chunk->code[offset + 2];
+            printf("%-16s slot %4d\n", "OP_GET_GLOBAL", slot);
+            return offset + 3;
         } break;
         case OP_SET_GLOBAL: {
-            uint8_t var_name_idx = chunk->code[offset + 1];
-            printf("%-16s %4d '", "OP_SET_GLOBAL", var_name_idx);
-            Clox_Value_Print(chunk->constants.values[var_name_idx]);
-            printf("'\n");
-            return offset + 2;
+            uint16_t slot = (uint16_t)(chunk->code[offset + 1] << 8);
+            slot |= chunk->code[offset + 2];
+            printf("%-16s slot %4d\n", "OP_SET_GLOBAL", slot);
+            return offset + 3;
         } break;
         case OP_GET_LOCAL: {
             uint8_t var_name_idx = chunk->code[offset + 1];
@@ -190,6 +476,18 @@ uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset
             printf("%-16s %4d -> %04X\n", "OP_JUMP", offset, target);
             return offset + 3;
         } break;
+        case OP_JUMP_IF_NOT_EQUAL: /* fallthrough */
+        case OP_JUMP_IF_EQUAL: /* fallthrough */
+        case OP_JUMP_IF_NOT_GREATER: /* fallthrough */
+        case OP_JUMP_IF_NOT_GREATER_EQUAL: /* fallthrough */
+        case OP_JUMP_IF_NOT_LESS: /* fallthrough */
+        case OP_JUMP_IF_NOT_LESS_EQUAL: {
+            uint16_t jump = (uint16_t)(chunk->code[offset + 1] << 8);
+            jump |= chunk->code[offset + 2];
+            uint32_t target = offset + 3 + jump;
+            printf("%-16s %4d -> %04X\n", Clox_Op_Code_Name(opcode), offset, target);
+            return offset + 3;
+        } break;
         case OP_LOOP: {
             uint16_t jump = (uint16_t)(chunk->code[offset + 1] << 8);
             jump |= chunk->code[offset + 2];
@@ -198,25 +496,48 @@ uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset
             printf("%-16s %4d -> %04X\n", "OP_LOOP", offset, target);
             return offset + 3;
         } break;
+        case OP_JUMP_LONG: /* fallthrough */
+        case OP_JUMP_IF_FALSE_LONG: /* fallthrough */
+        case OP_LOOP_LONG: {
+            uint32_t jump = Clox_Chunk_Read_Long_Operand(&chunk->code[offset + 1]);
+            uint32_t target = opcode == OP_LOOP_LONG ? offset + 5 - jump : offset + 5 + jump;
+            printf("%-16s %4d -> %04X\n", Clox_Op_Code_Name(opcode), offset, target);
+            return offset + 5;
+        } break;
+        case OP_WIDE: {
+            uint16_t operand = (uint16_t)((chunk->code[offset + 2] << 8) | chunk->code[offset + 3]);
+            printf("%-16s %s %4d\n", "OP_WIDE", Clox_Op_Code_Name(chunk->code[offset + 1]), operand);
+            return offset + 4;
+        } break;
         case OP_CALL: {
             uint8_t argc = chunk->code[offset + 1];
-            printf("%-16s argc: %4d\n", "OP_CALL", argc);
-            return offset + 2;
+            uint16_t cache = (uint16_t)((chunk->code[offset + 2] << 8) | chunk->code[offset + 3]);
+            printf("%-16s argc: %4d cache: %4d\n", "OP_CALL", argc, cache);
+            return offset + 4;
         } break;
-            case OP_CLOSURE: {
-            uint8_t constant = chunk->code[offset + 1];
-            printf("%-16s %4d ", "OP_CLOSURE", constant);
+        case OP_TAIL_CALL: {
+            uint8_t argc = chunk->code[offset + 1];
+            uint16_t cache = (uint16_t)((chunk->code[offset + 2] << 8) | chunk->code[offset + 3]);
+            printf("%-16s argc: %4d cache: %4d\n", "OP_TAIL_CALL", argc, cache);
+            return offset + 4;
+        } break;
+            case OP_CLOSURE: /* fallthrough */
+            case OP_CLOSURE_LONG: {
+            uint32_t capture = opcode == OP_CLOSURE ? offset + 2 : offset + 3;
+            uint16_t constant = opcode == OP_CLOSURE ? chunk->code[offset + 1] : (uint16_t)((chunk->code[offset + 1] << 8) | chunk->code[offset + 2]);
+            printf("%-16s %4d ", Clox_Op_Code_Name(opcode), constant);
             Clox_Value_Print(chunk->constants.values[constant]);
             printf("\n");
 
-            Clox_Function* function = (Clox_Function*)(chunk->constants.values[constant].object);
+            Clox_Function* function = (Clox_Function*)(CLOX_VALUE_AS_OBJECT(chunk->constants.values[constant]));
             for (int j = 0; j < function->upvalue_count; j++) {
-                int isLocal = chunk->code[offset + j*2];
-                int index = chunk->code[offset + j*2 + 1];
-                printf("%04d    |                     %s %d\n", offset + j , isLocal ? "local" : "upvalue", index);
+                int flags = chunk->code[capture];
+                int index = (flags & CLOX_CAPTURE_FLAG_WIDE) ? (chunk->code[capture + 1] << 8) | chunk->code[capture + 2] : chunk->code[capture + 1];
+                printf("%04d    |                     %s %d%s\n", capture, (flags & CLOX_CAPTURE_FLAG_LOCAL) ? "local" : "upvalue", index, (flags & CLOX_CAPTURE_FLAG_BY_VALUE) ? " (by value)" : "");
+                capture += (flags & CLOX_CAPTURE_FLAG_WIDE) ? 3 : 2;
             }
 
-            return offset + 2 + function->upvalue_count*2;
+            return capture;
         } break;
         case OP_GET_UPVALUE: {
             uint8_t var_name_idx = chunk->code[offset + 1];
@@ -230,10 +551,100 @@ uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset
             printf("'\n");
             return offset + 2;
         } break;
+        case OP_GET_FLAT_UPVALUE: {
+            uint8_t var_name_idx = chunk->code[offset + 1];
+            printf("%-16s %4d\n", "OP_GET_FLAT_UPVALUE", var_name_idx);
+            return offset + 2;
+        } break;
         case OP_CLOSE_UPVALUE: {
             printf("OP_CLOSE_UPVALUE\n");
             return offset + 1;
         } break;
+        case OP_ADD_NUM: /* fallthrough */
+        case OP_ADD_STR: /* fallthrough */
+        case OP_SUB_NUM: /* fallthrough */
+        case OP_MUL_NUM: /* fallthrough */
+        case OP_DIV_NUM: /* fallthrough */
+        case OP_EQUAL_NUM: /* fallthrough */
+        case OP_GREATER_NUM: /* fallthrough */
+        case OP_LESS_NUM: /* fallthrough */
+        case OP_ADD_INT: /* fallthrough */
+        case OP_SUB_INT: /* fallthrough */
+        case OP_MUL_INT: /* fallthrough */
+        case OP_EQUAL_INT: /* fallthrough */
+        case OP_GREATER_INT: /* fallthrough */
+        case OP_LESS_INT: {
+            printf("%s\n", Clox_Op_Code_Name(opcode));
+            return offset + 1;
+        } break;
+        case OP_GET_LOCAL_GET_LOCAL: /* fallthrough */
+        case OP_GET_LOCAL_GET_LOCAL_ADD: {
+            uint8_t lhs_idx = chunk->code[offset + 1];
+            uint8_t rhs_idx = chunk->code[offset + 3];
+            printf("%-16s %4d %4d\n", Clox_Op_Code_Name(opcode), lhs_idx, rhs_idx);
+            return offset + Clox_Chunk_Instruction_Length(chunk, offset);
+        } break;
+        case OP_GET_LOCAL_CONSTANT: /* fallthrough */
+        case OP_GET_LOCAL_CONSTANT_ADD: {
+            uint8_t local_idx = chunk->code[offset + 1];
+            uint8_t constant_idx = chunk->code[offset + 3];
+            printf("%-16s %4d %4d '", Clox_Op_Code_Name(opcode), local_idx, constant_idx);
+            Clox_Value_Print(chunk->constants.values[constant_idx]);
+            printf("'\n");
+            return offset + Clox_Chunk_Instruction_Length(chunk, offset);
+        } break;
+        case OP_GET_LOCAL_CONSTANT_JUMP_IF_NOT_LESS: {
+            uint8_t local_idx = chunk->code[offset + 1];
+            uint8_t constant_idx = chunk->code[offset + 3];
+            uint16_t jump = (uint16_t)(chunk->code[offset + 5] << 8);
+            jump |= chunk->code[offset + 6];
+            uint32_t target = offset + 7 + jump;
+            printf("%-16s %4d %4d '", Clox_Op_Code_Name(opcode), local_idx, constant_idx);
+            Clox_Value_Print(chunk->constants.values[constant_idx]);
+            printf("' -> %04X\n", target);
+            return offset + Clox_Chunk_Instruction_Length(chunk, offset);
+        } break;
+        case OP_GET_LOCAL_SMALL_INT: /* fallthrough */
+        case OP_GET_LOCAL_SMALL_INT_ADD: {
+            uint8_t local_idx = chunk->code[offset + 1];
+            int8_t immediate = (int8_t)chunk->code[offset + 3];
+            printf("%-16s %4d %4d\n", Clox_Op_Code_Name(opcode), local_idx, immediate);
+            return offset + Clox_Chunk_Instruction_Length(chunk, offset);
+        } break;
+        case OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS: {
+            uint8_t local_idx = chunk->code[offset + 1];
+            int8_t immediate = (int8_t)chunk->code[offset + 3];
+            uint16_t jump = (uint16_t)(chunk->code[offset + 5] << 8);
+            jump |= chunk->code[offset + 6];
+            uint32_t target = offset + 7 + jump;
+            printf("%-16s %4d %4d -> %04X\n", Clox_Op_Code_Name(opcode), local_idx, immediate, target);
+            return offset + Clox_Chunk_Instruction_Length(chunk, offset);
+        } break;
+        case OP_SET_LOCAL_POP: {
+            uint8_t var_name_idx = chunk->code[offset + 1];
+            printf("%-16s %4d\n", "OP_SET_LOCAL_POP", var_name_idx);
+            return offset + Clox_Chunk_Instruction_Length(chunk, offset);
+        } break;
+        case OP_SET_GLOBAL_POP: {
+            uint16_t slot = (uint16_t)(chunk->code[offset + 1] << 8);
+            slot |= chunk->code[offset + 2];
+            printf("%-16s slot %4d\n", "OP_SET_GLOBAL_POP", slot);
+            return offset + Clox_Chunk_Instruction_Length(chunk, offset);
+        } break;
+        case OP_JUMP_IF_FALSE_POP: {
+            uint16_t jump = (uint16_t)(chunk->code[offset + 1] << 8);
+            jump |= chunk->code[offset + 2];
+            uint32_t target = offset + 3 + jump;
+            printf("%-16s %4d -> %04X\n", "OP_JUMP_IF_FALSE_POP", offset, target);
+            return offset + Clox_Chunk_Instruction_Length(chunk, offset);
+        } break;
+        case OP_POP_LOOP: {
+            uint16_t jump = (uint16_t)(chunk->code[offset + 2] << 8);
+            jump |= chunk->code[offset + 3];
+            uint32_t target = offset + 4 - jump;
+            printf("%-16s %4d -> %04X\n", "OP_POP_LOOP", offset, target);
+            return offset + Clox_Chunk_Instruction_Length(chunk, offset);
+        } break;
         default: {
             printf("Unknown opcode %d\n", (uint32_t)opcode);
             return offset + 1;
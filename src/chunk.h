@@ -5,6 +5,11 @@
 #include "value_array.h"
 #include <stdint.h>
 
+// NOTE(Al-Andrew): flags byte in front of each capture's index in OP_CLOSURE
+#define CLOX_CAPTURE_FLAG_LOCAL    0x1 // captures a local of the enclosing frame, else one of its upvalues
+#define CLOX_CAPTURE_FLAG_BY_VALUE 0x2 // the variable is never reassigned, copy the value into the closure
+#define CLOX_CAPTURE_FLAG_WIDE     0x4 // the index is a short, for slots past 255
+
 typedef enum {
     OP_RETURN = 0,
     OP_CONSTANT,
@@ -29,20 +34,97 @@ typedef enum {
     OP_SET_LOCAL,
     OP_GET_UPVALUE,
     OP_SET_UPVALUE,
+    OP_GET_FLAT_UPVALUE,
     OP_JUMP,
     OP_JUMP_IF_FALSE,
     OP_LOOP,
     OP_CALL,
+    OP_TAIL_CALL,
     OP_CLOSURE,
     OP_CLOSE_UPVALUE,
+    OP_NOT_EQUAL,
+    OP_GREATER_EQUAL,
+    OP_LESS_EQUAL,
+    OP_CONSTANT_LONG, // NOTE(Al-Andrew): constant index as a short, for chunks with more than 256 constants
+    OP_CLOSURE_LONG,
+    OP_SMALL_INT, // NOTE(Al-Andrew): pushes its signed operand byte as an integer, never touches the constant pool
+    OP_WIDE, // NOTE(Al-Andrew): prefix, the local or upvalue instruction after it takes a short instead of a byte
+    OP_JUMP_LONG, // NOTE(Al-Andrew): 32 bit offsets, only in functions whose jumps don't fit a short
+    OP_JUMP_IF_FALSE_LONG,
+    OP_LOOP_LONG,
+
+    // NOTE(Al-Andrew): compare-and-branch. pop two operands, compare them and jump when the comparison doesn't hold.
+    //                  emitted by the compiler when a comparison is the whole condition of an if/while/for, so no
+    //                  boolean is ever pushed and neither arm has to pop one.
+    OP_JUMP_IF_NOT_EQUAL,
+    OP_JUMP_IF_EQUAL,
+    OP_JUMP_IF_NOT_GREATER,
+    OP_JUMP_IF_NOT_GREATER_EQUAL,
+    OP_JUMP_IF_NOT_LESS,
+    OP_JUMP_IF_NOT_LESS_EQUAL,
+
+    // NOTE(Al-Andrew): quickened forms, only ever written into a chunk by the VM at runtime (see CLOX_VM_QUICKENING).
+    OP_ADD_NUM,
+    OP_ADD_STR,
+    OP_SUB_NUM,
+    OP_MUL_NUM,
+    OP_DIV_NUM,
+    OP_EQUAL_NUM,
+    OP_GREATER_NUM,
+    OP_LESS_NUM,
+    OP_ADD_INT,
+    OP_SUB_INT,
+    OP_MUL_INT,
+    OP_EQUAL_INT,
+    OP_GREATER_INT,
+    OP_LESS_INT,
+
+    // NOTE(Al-Andrew): superinstructions. Written over the first opcode of the sequence they replace by
+    //                  Clox_Peephole_Fuse_Superinstructions; the rest of the original bytes are left in place,
+    //                  so the chunk keeps its length, its jump offsets and its source_lines.
+    //                  Picked from dynamic pair counts over benchmarks/ and tests/file_tests/, reproduce with:
+    //                      xmake f --superinstructions=n --profile_opcodes=y && xmake
+    //                      for f in benchmarks/*.lox tests/file_tests/*.lox; do xmake run clox $f 2>&1 >/dev/null | grep ^pair; done |
+    //                          awk '{c[$3" "$4]+=$2} END {for (k in c) print c[k], k}' | sort -rn
+    //                  Top pairs at the time of writing (share of all dispatched pairs):
+    //                      GET_LOCAL CONSTANT 11.9%, POP LOOP 5.9%, SET_LOCAL POP 5.4%, JUMP_IF_FALSE POP 4.9%,
+    //                      LESS JUMP_IF_FALSE 4.9%, CONSTANT LESS 4.9%, CONSTANT ADD 3.9%, GET_LOCAL ADD 3.7%,
+    //                      GET_LOCAL GET_LOCAL 3.1%, SET_GLOBAL POP 2.2%
+    OP_GET_LOCAL_GET_LOCAL,
+    OP_GET_LOCAL_CONSTANT,
+    OP_GET_LOCAL_GET_LOCAL_ADD,
+    OP_GET_LOCAL_CONSTANT_ADD,
+    OP_GET_LOCAL_CONSTANT_JUMP_IF_NOT_LESS,
+    OP_SET_LOCAL_POP,
+    OP_SET_GLOBAL_POP,
+    OP_JUMP_IF_FALSE_POP,
+    OP_POP_LOOP,
+    OP_GET_LOCAL_SMALL_INT,
+    OP_GET_LOCAL_SMALL_INT_ADD,
+    OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS,
 } Clox_Op_Code;
 
+typedef struct Clox_String Clox_String;
+
+// NOTE(Al-Andrew): code in [start, end) was compiled from the body of a call the compiler inlined, its source_lines
+//                  are the callee's. runtime errors print it as a frame of its own, called from `call_line`. one
+//                  inlined inside another comes before it, so the first site holding an offset is the innermost.
+typedef struct {
+    uint32_t start;
+    uint32_t end;
+    uint32_t call_line;
+    Clox_String* callee; // NOTE(Al-Andrew): its name
+} Clox_Inline_Site;
+
 typedef struct {
     uint32_t used;
     uint32_t allocated;
     uint8_t* code;
     uint32_t* source_lines;
     Clox_Value_Array constants;
+    Clox_Inline_Site* inline_sites;
+    uint32_t inline_site_count;
+    bool mapped; // NOTE(Al-Andrew): code and source_lines live in a .loxc image (see bytecode_cache.h), never pushed to or freed
 } Clox_Chunk;
 
 Clox_Chunk Clox_Chunk_New_Empty();
@@ -51,8 +133,25 @@ void Clox_Chunk_Delete(Clox_Chunk* const chunk);
 
 void Clox_Chunk_Push(Clox_Chunk* const chunk, uint8_t const data, uint32_t const source_line);
 uint32_t Clox_Chunk_Push_Constant(Clox_Chunk* const chunk, Clox_Value const value); 
+void Clox_Chunk_Push_Inline_Site(Clox_Chunk* const chunk, Clox_Inline_Site const site);
+// NOTE(Al-Andrew): for the passes that lay the code out again. `moved_to[offset]` is where the instruction that
+//                  starts at `offset` went, where the next one kept went if it was dropped or `offset` is inside an
+//                  instruction, and `moved_to[used]` is the new end. a site can end inside one when a condition jump
+//                  turned the inlined body's last comparison into a compare-and-branch, it then takes the branch along.
+void Clox_Chunk_Move_Inline_Sites(Clox_Chunk* const chunk, uint32_t const* moved_to);
 
 void Clox_Chunk_Print(Clox_Chunk* const chunk, char const* const name);
 uint32_t Clox_Chunk_Print_Op_Code(Clox_Chunk* const chunk, uint32_t const offset);
+char const* Clox_Op_Code_Name(Clox_Op_Code const opcode);
+uint32_t Clox_Chunk_Instruction_Length(Clox_Chunk* const chunk, uint32_t const offset);
+Clox_Op_Code Clox_Op_Code_Generic(Clox_Op_Code const opcode);
+uint32_t Clox_Op_Code_Operand_Length(Clox_Op_Code const opcode);
+bool Clox_Op_Code_Is_Compare_And_Branch(Clox_Op_Code const opcode);
+bool Clox_Chunk_Has_Wide_Operands(Clox_Chunk* const chunk);
+
+static inline uint32_t Clox_Chunk_Read_Long_Operand(uint8_t const* operand) {
+    return ((uint32_t)operand[0] << 24) | ((uint32_t)operand[1] << 16) | ((uint32_t)operand[2] << 8) | operand[3];
+}
+Clox_Op_Code Clox_Op_Code_Branch_Comparison(Clox_Op_Code const opcode);
 
 #endif // CLOX_COMMON_H_INCLUDED
\ No newline at end of file
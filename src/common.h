@@ -15,6 +15,13 @@
 #define CLOX_DEV_ASSERT(exp) { assert((exp)); }
 #define CLOX_UNREACHABLE() { assert(false); }
 
+// NOTE(Al-Andrew): for cold paths called from several VM handlers, inlining them everywhere bloats the dispatch loop
+#if defined(__GNUC__)
+    #define CLOX_NOINLINE __attribute__((noinline))
+#else
+    #define CLOX_NOINLINE
+#endif // __GNUC__
+
 
 typedef struct {
     const char* string;
@@ -1,17 +1,43 @@
 #include "compiler.h"
 #include "scanner.h"
+#include "token_ring.h"
 #include "chunk.h"
+#include "memory.h"
 #include "object.h"
+#include "optimizer.h"
+#include "peephole.h"
+#include "vm.h"
+#include <errno.h>
 #include <stdint.h>
 #include <string.h>
 
 // #define CLOX_DEBUG_PRINT_COMPILED_CHUNKS
 
 
+typedef enum {
+    CLOX_CAPTURE_UNDECIDED,
+    CLOX_CAPTURE_BY_REFERENCE,
+    CLOX_CAPTURE_BY_VALUE,
+} Clox_Capture_Kind;
+
+// NOTE(Al-Andrew): a function that can be inlined, its parameters and where the `<expression>` of its single
+//                  `return <expression>;` starts in the source. the expression is compiled again at every call site.
+typedef struct {
+    Clox_Function* function;
+    Clox_Token parameters[CLOX_COMPILER_INLINE_MAX_ARITY];
+    char const* start;
+    int line;
+    uint32_t global_slot; // NOTE(Al-Andrew): UINT32_MAX for local function bindings
+} Clox_Inline_Body;
+
 typedef struct {
     Clox_Token name;
     int depth;
     bool is_captured;
+    bool is_reassigned;   // NOTE(Al-Andrew): assigned to after its declaration somewhere before the current position
+    int brace_depth;      // NOTE(Al-Andrew): parser->brace_depth of the block this local lives in
+    Clox_Capture_Kind capture;
+    Clox_Inline_Body const* inline_body; // NOTE(Al-Andrew): set for local function bindings that can be inlined
 } Clox_Local;
 
 typedef enum {
@@ -20,8 +46,9 @@ typedef enum {
 } Clox_Function_Type;
 
 typedef struct {
-    uint8_t index;
+    uint16_t index;
     bool isLocal;
+    bool by_value;
 } Clox_Upvalue;
 
 typedef struct Clox_Compiler Clox_Compiler;
@@ -29,34 +56,72 @@ struct Clox_Compiler {
     Clox_Compiler* enclosing;
     Clox_Function* function;
     Clox_Function_Type type;
-    Clox_Local locals[UINT8_MAX + 1];
-    Clox_Upvalue upvalues[UINT8_MAX + 1];
+    Clox_Local* locals;
+    int locals_capacity;
+    Clox_Upvalue* upvalues;
+    int upvalues_capacity;
     int localCount;
     int scopeDepth;
+    int last_call_offset; // NOTE(Al-Andrew): offset of the most recently emitted OP_CALL, -1 if none yet
+    int last_comparison_offset; // NOTE(Al-Andrew): same for the comparison opcodes
+    int last_jump_target; // NOTE(Al-Andrew): offset the most recently patched jump lands on, -1 if none yet
+    int temporaries; // NOTE(Al-Andrew): values the expression being compiled has pushed above the locals so far
+    int last_callee_offset; // NOTE(Al-Andrew): where the load of last_callee starts, it ends at last_callee_end
+    int last_callee_end;
+    Clox_Inline_Body const* last_callee; // NOTE(Al-Andrew): the inlinable function the most recent variable load named
+    Clox_Value_Index_Map constant_map; // NOTE(Al-Andrew): over function->chunk.constants
+    bool long_jumps; // NOTE(Al-Andrew): forward jumps get 32 bit offsets, see Clox_Compiler_Rewind_For_Long_Jumps
+    bool jump_overflow; // NOTE(Al-Andrew): a forward jump didn't fit a short
 };
 
 typedef struct {
     Clox_Token current;
     Clox_Token previous;
     Clox_Scanner* scanner;
+    Clox_Token_Ring* ring; // NOTE(Al-Andrew): pipelined compiles take their tokens from here, see Clox_Compiler_Advance
+    char const* source;
+    Clox_Source_Stream* stream; // NOTE(Al-Andrew): `source` is still arriving through this, see source.h
+    Clox_Hash_Table global_bindings; // NOTE(Al-Andrew): see Clox_Compiler_Collect_Global_Bindings
+    bool global_bindings_collected;
     Clox_VM* vm;
     Clox_Compiler* compiler;
+    Clox_Inline_Body inline_bodies[CLOX_COMPILER_MAX_INLINE_BODIES];
+    int inline_body_count;
+    int inline_base; // NOTE(Al-Andrew): first local the inlined body being compiled may see, -1 outside of one
+    int inline_depth;
+    int brace_depth; // NOTE(Al-Andrew): braces opened and not yet closed, up to and including `previous`
     bool had_error;
     bool panic_mode;
 } Clox_Parser;
 
+// NOTE(Al-Andrew): compiles into compiler->function if the caller set one (a lazy function), into a new one otherwise
 static void Clox_Compiler_Init(Clox_Parser* parser, Clox_Compiler* compiler, Clox_Function_Type type) {
     compiler->enclosing = parser->compiler;
-    compiler->function = NULL;
     compiler->type = type;
     compiler->localCount = 0;
     compiler->scopeDepth = 0;
-    memset(compiler->locals, 0, sizeof(compiler->locals));
-    compiler->function = Clox_Function_Create_Empty(parser->vm);
+    compiler->last_call_offset = -1;
+    compiler->last_comparison_offset = -1;
+    compiler->last_jump_target = -1;
+    compiler->temporaries = 0;
+    compiler->last_callee_offset = -1;
+    compiler->last_callee_end = -1;
+    compiler->last_callee = NULL;
+    compiler->constant_map = (Clox_Value_Index_Map){0};
+    compiler->long_jumps = false;
+    compiler->jump_overflow = false;
+    compiler->locals_capacity = 16;
+    compiler->locals = reallocate(NULL, 0, sizeof(Clox_Local) * compiler->locals_capacity); // TODO(Al-Andrew, AllocFailure): handle
+    memset(compiler->locals, 0, sizeof(Clox_Local) * compiler->locals_capacity);
+    compiler->upvalues_capacity = 0;
+    compiler->upvalues = NULL;
 
     parser->compiler = compiler;
-    if (type != CLOX_FUNCTION_TYPE_SCRIPT) {
-        parser->compiler->function->name = Clox_String_Create(parser->vm, parser->previous.start, parser->previous.length);
+    if (compiler->function == NULL) {
+        compiler->function = Clox_Function_Create_Empty(parser->vm);
+        if (type != CLOX_FUNCTION_TYPE_SCRIPT) {
+            compiler->function->name = Clox_String_Create(parser->vm, parser->previous.start, parser->previous.length);
+        }
     }
     Clox_Local* local = &parser->compiler->locals[parser->compiler->localCount++];
     local->depth = 0;
@@ -64,10 +129,39 @@ static void Clox_Compiler_Init(Clox_Parser* parser, Clox_Compiler* compiler, Clo
     local->name.length = 0;
     local->is_captured = false;
 }
+
+// NOTE(Al-Andrew): not part of Clox_Compiler_End, whoever declared the compiler still reads its upvalues and
+//                  parameters after that.
+static void Clox_Compiler_Delete(Clox_Compiler* compiler) {
+    if (compiler->locals) deallocate(compiler->locals);
+    if (compiler->upvalues) deallocate(compiler->upvalues);
+    compiler->locals = NULL;
+    compiler->upvalues = NULL;
+    compiler->locals_capacity = 0;
+    compiler->upvalues_capacity = 0;
+}
 static inline void Clox_Compiler_Emit_Return(Clox_Parser* parser);
 static inline Clox_Function* Clox_Compiler_End(Clox_Parser* parser) {
     Clox_Compiler_Emit_Return(parser);
     Clox_Function* to_return = parser->compiler->function;
+    Clox_Function_Allocate_Call_Caches(to_return);
+    if (parser->compiler->type != CLOX_FUNCTION_TYPE_SCRIPT && to_return->upvalue_count == 0 && to_return->canonical_closure == NULL) {
+        // NOTE(Al-Andrew): nothing to capture, so every closure over this function would be identical. make the one
+        //                  OP_CLOSURE will hand out instead of allocating.
+        to_return->canonical_closure = Clox_Closure_Create(parser->vm, to_return);
+    }
+    if (!parser->had_error && parser->vm->optimize) {
+        Clox_Optimizer_Optimize_Function(to_return);
+    }
+    if (!parser->had_error) {
+        Clox_Peephole_Optimize(&to_return->chunk, to_return->name != NULL ? to_return->name->characters : "<script>");
+    }
+    #ifdef CLOX_COMPILER_SUPERINSTRUCTIONS
+    if (!parser->had_error) {
+        Clox_Peephole_Fuse_Superinstructions(&to_return->chunk);
+    }
+    #endif // CLOX_COMPILER_SUPERINSTRUCTIONS
+    Clox_Value_Index_Map_Delete(&parser->compiler->constant_map);
     parser->compiler = parser->compiler->enclosing;
     return to_return;
 }
@@ -183,10 +277,15 @@ static inline void Clox_Compiler_Error(Clox_Parser* parser, const char* message)
 static inline void Clox_Compiler_Advance(Clox_Parser* parser) {
 
     parser->previous = parser->current;
+    if (parser->previous.type == CLOX_TOKEN_LEFT_BRACE) {
+        parser->brace_depth++;
+    } else if (parser->previous.type == CLOX_TOKEN_RIGHT_BRACE) {
+        parser->brace_depth--;
+    }
 
     for (;;) {
         
-        parser->current = Clox_Scanner_Get_Token(parser->scanner);
+        parser->current = parser->ring != NULL ? Clox_Token_Ring_Next(parser->ring) : Clox_Scanner_Get_Token(parser->scanner);
         
         if (parser->current.type != CLOX_TOKEN_ERROR) {
             break;
@@ -194,6 +293,14 @@ static inline void Clox_Compiler_Advance(Clox_Parser* parser) {
 
         Clox_Compiler_Error_At_Current(parser);
     }
+
+    if (parser->ring != NULL) {
+        // NOTE(Al-Andrew): the scanner thread is ahead of us, keep `scanner` where it would be had it just given us
+        //                  `current` so lookaheads and checkpoints copying it still start at the right place
+        parser->scanner->start = parser->current.start;
+        parser->scanner->current = parser->current.start + parser->current.length;
+        parser->scanner->line = parser->current.line;
+    }
 }
 
 static inline void Clox_Compiler_Consume(Clox_Parser* parser, Clox_Token_Type tkn_type, char const* const message) {
@@ -236,24 +343,54 @@ static inline void Clox_Compiler_Emit_Bytes(Clox_Parser* parser, uint32_t count,
     va_end(args);
 }
 
-static inline uint8_t Clox_Compiler_Make_Constant(Clox_Parser* parser, Clox_Value value) {
-  int constant = Clox_Chunk_Push_Constant(Clox_Compiler_Current_Chunk(parser), value);
-  
-  if (constant > UINT8_MAX) {
-    Clox_Compiler_Error_At_Token(parser, &parser->previous, "Too many constants in one chunk.");
-    return 0;
-  }
-
-  return (uint8_t)constant;
+// NOTE(Al-Andrew): every literal used to get its own entry, now a chunk only ever holds one of each
+static inline uint32_t Clox_Compiler_Make_Constant(Clox_Parser* parser, Clox_Value value) {
+    Clox_Chunk* chunk = Clox_Compiler_Current_Chunk(parser);
+    uint32_t* slot = Clox_Value_Index_Map_Slot(&parser->compiler->constant_map, &chunk->constants, value);
+    if (*slot != 0) {
+        return *slot - 1;
+    }
+    if (chunk->constants.used > UINT16_MAX) {
+        Clox_Compiler_Error_At_Token(parser, &parser->previous, "Too many constants in one chunk.");
+        return 0;
+    }
+    uint32_t constant = Clox_Chunk_Push_Constant(chunk, value);
+    *slot = constant + 1;
+    return constant;
 }
 
+// NOTE(Al-Andrew): small integers are immediates and never reach the pool, the first 256 constants take one
+//                  operand byte and the rest two.
 static inline void Clox_Compiler_Emit_Constant(Clox_Parser* parser, Clox_Value value) {
-    Clox_Compiler_Emit_Bytes(parser, 2, OP_CONSTANT, Clox_Compiler_Make_Constant(parser, value));
+    int8_t small;
+    if (Clox_Value_Is_Small_Integer(value, &small)) {
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_SMALL_INT, (uint8_t)small);
+        return;
+    }
+    uint32_t constant = Clox_Compiler_Make_Constant(parser, value);
+    if (constant <= UINT8_MAX) {
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_CONSTANT, constant);
+    } else {
+        Clox_Compiler_Emit_Bytes(parser, 3, OP_CONSTANT_LONG, (constant >> 8) & 0xff, constant & 0xff);
+    }
 }
 
 static inline void Clox_Compiler_Compile_Number(Clox_Parser* parser, bool can_assign) {
     (void)can_assign;
-    double value = strtod(parser->previous.start, NULL);
+    Clox_Token const* token = &parser->previous;
+
+    // NOTE(Al-Andrew): literals without a fractional part start out as integers, anything past
+    //                  CLOX_VALUE_INTEGER_LIMIT stays a double like before.
+    if (memchr(token->start, '.', token->length) == NULL) {
+        errno = 0;
+        long long value = strtoll(token->start, NULL, 10);
+        if (errno != ERANGE && Clox_Value_Integer_Fits((int64_t)value)) {
+            Clox_Compiler_Emit_Constant(parser, CLOX_VALUE_INTEGER((int64_t)value));
+            return;
+        }
+    }
+
+    double value = strtod(token->start, NULL);
     Clox_Compiler_Emit_Constant(parser, CLOX_VALUE_NUMBER(value));
 }
 
@@ -335,21 +472,24 @@ static void Clox_Compiler_Compile_Binary(Clox_Parser* parser, bool can_assign) {
     (void)can_assign;
   Clox_Token_Type operator = parser->previous.type;
   Clox_Parse_Rule* rule = Clox_Get_Parse_Rule(operator);
+  parser->compiler->temporaries++;
   Clox_Compiler_Parse_Precendence(parser, (Clox_Precedence)(rule->precedence + 1));
+  parser->compiler->temporaries--;
 
   switch (operator) {
-    case CLOX_TOKEN_PLUS:          Clox_Compiler_Emit_Byte(parser, OP_ADD); break;
-    case CLOX_TOKEN_MINUS:         Clox_Compiler_Emit_Byte(parser, OP_SUB); break;
-    case CLOX_TOKEN_STAR:          Clox_Compiler_Emit_Byte(parser, OP_MUL); break;
-    case CLOX_TOKEN_SLASH:         Clox_Compiler_Emit_Byte(parser, OP_DIV); break;
+    case CLOX_TOKEN_PLUS:          Clox_Compiler_Emit_Byte(parser, OP_ADD); return;
+    case CLOX_TOKEN_MINUS:         Clox_Compiler_Emit_Byte(parser, OP_SUB); return;
+    case CLOX_TOKEN_STAR:          Clox_Compiler_Emit_Byte(parser, OP_MUL); return;
+    case CLOX_TOKEN_SLASH:         Clox_Compiler_Emit_Byte(parser, OP_DIV); return;
     case CLOX_TOKEN_EQUAL_EQUAL:   Clox_Compiler_Emit_Byte(parser, OP_EQUAL); break;
-    case CLOX_TOKEN_BANG_EQUAL:    Clox_Compiler_Emit_Bytes(parser, 2, OP_EQUAL, OP_BOOLEAN_NEGATION); break;
-    case CLOX_TOKEN_GREATER_EQUAL: Clox_Compiler_Emit_Bytes(parser, 2, OP_LESS, OP_BOOLEAN_NEGATION); break;
-    case CLOX_TOKEN_GREATER:       Clox_Compiler_Emit_Bytes(parser, 1, OP_GREATER); break;
-    case CLOX_TOKEN_LESS_EQUAL:    Clox_Compiler_Emit_Bytes(parser, 2, OP_GREATER, OP_BOOLEAN_NEGATION); break;
-    case CLOX_TOKEN_LESS:          Clox_Compiler_Emit_Bytes(parser, 1, OP_LESS); break;
+    case CLOX_TOKEN_BANG_EQUAL:    Clox_Compiler_Emit_Byte(parser, OP_NOT_EQUAL); break;
+    case CLOX_TOKEN_GREATER_EQUAL: Clox_Compiler_Emit_Byte(parser, OP_GREATER_EQUAL); break;
+    case CLOX_TOKEN_GREATER:       Clox_Compiler_Emit_Byte(parser, OP_GREATER); break;
+    case CLOX_TOKEN_LESS_EQUAL:    Clox_Compiler_Emit_Byte(parser, OP_LESS_EQUAL); break;
+    case CLOX_TOKEN_LESS:          Clox_Compiler_Emit_Byte(parser, OP_LESS); break;
     default: CLOX_UNREACHABLE();
   }
+  parser->compiler->last_comparison_offset = Clox_Compiler_Current_Chunk(parser)->used - 1;
 }
 
 static void Clox_Compiler_Compile_Print_Statement(Clox_Parser* parser) {
@@ -404,31 +544,78 @@ static void Clox_Compiler_End_Scope(Clox_Parser* parser) {
 static void Clox_Compiler_Compile_Statement(Clox_Parser* parser);
 
 static int Clox_Compiler_Emit_Jump(Clox_Parser* parser, uint8_t instruction) {
+    if (parser->compiler->long_jumps) {
+        Clox_Compiler_Emit_Bytes(parser, 5, instruction == OP_JUMP ? OP_JUMP_LONG : OP_JUMP_IF_FALSE_LONG, 0xff, 0xff, 0xff, 0xff);
+        return Clox_Compiler_Current_Chunk(parser)->used - 4;
+    }
     Clox_Compiler_Emit_Bytes(parser, 3, instruction, 0xff, 0xff);
     return Clox_Compiler_Current_Chunk(parser)->used - 2;
 }
 
 static void Clox_Compiler_Patch_Jump(Clox_Parser* parser, int offset) {
+    Clox_Chunk* chunk = Clox_Compiler_Current_Chunk(parser);
+    if (parser->compiler->long_jumps) {
+        uint32_t jump = chunk->used - offset - 4;
+        chunk->code[offset] = (jump >> 24) & 0xff;
+        chunk->code[offset + 1] = (jump >> 16) & 0xff;
+        chunk->code[offset + 2] = (jump >> 8) & 0xff;
+        chunk->code[offset + 3] = jump & 0xff;
+        parser->compiler->last_jump_target = chunk->used;
+        return;
+    }
+
     // NOTE(Al-Andrew): -2 to adjust for the bytecode for the jump offset itself.
-    int jump = Clox_Compiler_Current_Chunk(parser)->used - offset - 2;
+    int jump = chunk->used - offset - 2;
 
     if (jump > UINT16_MAX) {
-        Clox_Compiler_Error(parser, "Too much code to jump over.");
+        // NOTE(Al-Andrew): not an error, the body gets compiled again with long jumps once we're through it
+        parser->compiler->jump_overflow = true;
     }
 
-    Clox_Compiler_Current_Chunk(parser)->code[offset] = (jump >> 8) & 0xff;
-    Clox_Compiler_Current_Chunk(parser)->code[offset + 1] = jump & 0xff;
+    chunk->code[offset] = (jump >> 8) & 0xff;
+    chunk->code[offset + 1] = jump & 0xff;
+    parser->compiler->last_jump_target = chunk->used;
 }
 
-static void Clox_Compiler_Emit_Loop(Clox_Parser* parser, int loop_start) {
-    Clox_Compiler_Emit_Byte(parser, OP_LOOP);
+// NOTE(Al-Andrew): the jump an if/while/for takes when its condition doesn't hold. if the condition ended in a
+//                  comparison that nothing jumps past (`a and b < c` does) the comparison becomes a compare-and-branch
+//                  that pops its operands, otherwise the condition stays on the stack for OP_JUMP_IF_FALSE and both
+//                  paths have to pop it, `condition_on_stack` tells the caller which one it got.
+static int Clox_Compiler_Emit_Condition_Jump(Clox_Parser* parser, bool* condition_on_stack) {
+    Clox_Chunk* chunk = Clox_Compiler_Current_Chunk(parser);
+    int comparison = parser->compiler->last_comparison_offset;
+    if (parser->compiler->long_jumps || comparison < 0 || (uint32_t)comparison != chunk->used - 1 || parser->compiler->last_jump_target == (int)chunk->used) {
+        *condition_on_stack = true;
+        return Clox_Compiler_Emit_Jump(parser, OP_JUMP_IF_FALSE);
+    }
+
+    Clox_Op_Code branch;
+    switch (chunk->code[comparison]) {
+        case OP_EQUAL:         branch = OP_JUMP_IF_NOT_EQUAL; break;
+        case OP_NOT_EQUAL:     branch = OP_JUMP_IF_EQUAL; break;
+        case OP_GREATER:       branch = OP_JUMP_IF_NOT_GREATER; break;
+        case OP_GREATER_EQUAL: branch = OP_JUMP_IF_NOT_GREATER_EQUAL; break;
+        case OP_LESS:          branch = OP_JUMP_IF_NOT_LESS; break;
+        case OP_LESS_EQUAL:    branch = OP_JUMP_IF_NOT_LESS_EQUAL; break;
+        default: CLOX_UNREACHABLE(); branch = OP_JUMP_IF_FALSE; break;
+    }
+    chunk->code[comparison] = branch;
+    parser->compiler->last_comparison_offset = -1;
+    *condition_on_stack = false;
+    Clox_Compiler_Emit_Bytes(parser, 2, 0xff, 0xff);
+    return chunk->used - 2;
+}
 
-    int offset = Clox_Compiler_Current_Chunk(parser)->used - loop_start + 2;
-    if (offset > UINT16_MAX) {
-        Clox_Compiler_Error(parser, "Loop body too large.");
+// NOTE(Al-Andrew): the distance back is known up front, so only the loops that need it get the long encoding
+static void Clox_Compiler_Emit_Loop(Clox_Parser* parser, int loop_start) {
+    uint32_t offset = Clox_Compiler_Current_Chunk(parser)->used - loop_start + 3;
+    if (offset <= UINT16_MAX) {
+        Clox_Compiler_Emit_Bytes(parser, 3, OP_LOOP, (offset >> 8) & 0xff, offset & 0xff);
+        return;
     }
 
-    Clox_Compiler_Emit_Bytes(parser, 2, (offset >> 8) & 0xff, offset & 0xff);
+    offset += 2;
+    Clox_Compiler_Emit_Bytes(parser, 5, OP_LOOP_LONG, (offset >> 24) & 0xff, (offset >> 16) & 0xff, (offset >> 8) & 0xff, offset & 0xff);
 }
 
 static void Clox_Compiler_Compile_If_Statement(Clox_Parser* parser) {
@@ -436,13 +623,18 @@ static void Clox_Compiler_Compile_If_Statement(Clox_Parser* parser) {
     Clox_Compiler_Compile_Expression(parser);
     Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_PAREN, "Expect ')' after condition."); 
 
-    int thenJump = Clox_Compiler_Emit_Jump(parser, OP_JUMP_IF_FALSE);
-    Clox_Compiler_Emit_Byte(parser, OP_POP);
+    bool condition_on_stack;
+    int thenJump = Clox_Compiler_Emit_Condition_Jump(parser, &condition_on_stack);
+    if (condition_on_stack) {
+        Clox_Compiler_Emit_Byte(parser, OP_POP);
+    }
     Clox_Compiler_Compile_Statement(parser);
     int elseJump = Clox_Compiler_Emit_Jump(parser, OP_JUMP);
 
     Clox_Compiler_Patch_Jump(parser, thenJump);
-    Clox_Compiler_Emit_Byte(parser, OP_POP);
+    if (condition_on_stack) {
+        Clox_Compiler_Emit_Byte(parser, OP_POP);
+    }
 
     if (Clox_Compiler_Match(parser, CLOX_TOKEN_ELSE)) {
         Clox_Compiler_Compile_Statement(parser);
@@ -456,13 +648,18 @@ static void Clox_Copmiler_Compile_While_Statement(Clox_Parser* parser) {
     Clox_Compiler_Compile_Expression(parser);
     Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_PAREN, "Expect ')' after condition."); 
 
-    int exitJump = Clox_Compiler_Emit_Jump(parser, OP_JUMP_IF_FALSE);
-    Clox_Compiler_Emit_Byte(parser, OP_POP);
+    bool condition_on_stack;
+    int exitJump = Clox_Compiler_Emit_Condition_Jump(parser, &condition_on_stack);
+    if (condition_on_stack) {
+        Clox_Compiler_Emit_Byte(parser, OP_POP);
+    }
     Clox_Compiler_Compile_Statement(parser); // NOTE(Al-Andrew): the loop body
     Clox_Compiler_Emit_Loop(parser, loopStart);
 
     Clox_Compiler_Patch_Jump(parser, exitJump);
-    Clox_Compiler_Emit_Byte(parser, OP_POP);
+    if (condition_on_stack) {
+        Clox_Compiler_Emit_Byte(parser, OP_POP);
+    }
 }
 
 static void Clox_Compiler_Compile_Variable_Declaration(Clox_Parser* parser);
@@ -481,13 +678,16 @@ static void Clox_Copmiler_Compile_For_Statement(Clox_Parser* parser) {
     int loopStart = Clox_Compiler_Current_Chunk(parser)->used;
 
     int exitJump = -1;
+    bool condition_on_stack = false;
     if (!Clox_Compiler_Match(parser,CLOX_TOKEN_SEMICOLON)) {
         Clox_Compiler_Compile_Expression(parser);
         Clox_Compiler_Consume(parser, CLOX_TOKEN_SEMICOLON, "Expect ';' after loop condition.");
 
         // Jump out of the loop if the condition is false.
-        exitJump = Clox_Compiler_Emit_Jump(parser, OP_JUMP_IF_FALSE);
-        Clox_Compiler_Emit_Byte(parser, OP_POP); // Condition.
+        exitJump = Clox_Compiler_Emit_Condition_Jump(parser, &condition_on_stack);
+        if (condition_on_stack) {
+            Clox_Compiler_Emit_Byte(parser, OP_POP); // Condition.
+        }
     }
     if (!Clox_Compiler_Match(parser, CLOX_TOKEN_RIGHT_PAREN)) {
         int bodyJump = Clox_Compiler_Emit_Jump(parser, OP_JUMP);
@@ -506,7 +706,9 @@ static void Clox_Copmiler_Compile_For_Statement(Clox_Parser* parser) {
 
     if (exitJump != -1) {
         Clox_Compiler_Patch_Jump(parser, exitJump);
-        Clox_Compiler_Emit_Byte(parser, OP_POP); // Condition.
+        if (condition_on_stack) {
+            Clox_Compiler_Emit_Byte(parser, OP_POP); // Condition.
+        }
     }
 
     Clox_Compiler_End_Scope(parser);
@@ -523,6 +725,14 @@ static void Clox_Copmiler_Compile_Return_Statement(Clox_Parser* parser) {
     } else {
         Clox_Compiler_Compile_Expression(parser);
         Clox_Compiler_Consume(parser, CLOX_TOKEN_SEMICOLON, "Expect ';' after return value.");
+
+        // NOTE(Al-Andrew): if the call is the very last thing the expression emitted then its result is the return
+        //                  value and nothing else in this frame is needed after it. we keep the OP_RETURN behind it
+        //                  so other paths that jump here (and/or) and native callees still return normally.
+        Clox_Chunk* chunk = Clox_Compiler_Current_Chunk(parser);
+        if (parser->compiler->last_call_offset >= 0 && (uint32_t)parser->compiler->last_call_offset == chunk->used - 4) {
+            chunk->code[parser->compiler->last_call_offset] = OP_TAIL_CALL;
+        }
         Clox_Compiler_Emit_Byte(parser, OP_RETURN);
     }
 }
@@ -575,8 +785,16 @@ static void Clox_Compiler_Synchronize(Clox_Parser* parser) {
     }
 }
 
-static uint8_t Clox_Compiler_Emit_Identifier_Constant(Clox_Parser* parser) {
-    return Clox_Compiler_Make_Constant(parser ,CLOX_VALUE_OBJECT(Clox_String_Create(parser->vm, parser->previous.start, parser->previous.length)));
+static uint16_t Clox_Compiler_Resolve_Global(Clox_Parser* parser) {
+    Clox_String* name = Clox_String_Create(parser->vm, parser->previous.start, parser->previous.length);
+    uint32_t slot = Clox_VM_Resolve_Global_Slot(parser->vm, name);
+
+    if (slot > UINT16_MAX) {
+        Clox_Compiler_Error(parser, "Too many global variables.");
+        return 0;
+    }
+
+    return (uint16_t)slot;
 }
 
 static void Clox_Compiler_Mark_Local_Initialized(Clox_Parser* parser) {
@@ -585,15 +803,25 @@ static void Clox_Compiler_Mark_Local_Initialized(Clox_Parser* parser) {
 }
 
 static void Clox_Compiler_Add_Local(Clox_Parser* parser, Clox_Token token) {
-    if (parser->compiler->localCount == UINT8_MAX) {
+    if (parser->compiler->localCount == CLOX_COMPILER_MAX_LOCALS) {
         Clox_Compiler_Error(parser, "Too many local variables in function.");
         return;
     }
+    if (parser->compiler->localCount == parser->compiler->locals_capacity) {
+        Clox_Compiler* compiler = parser->compiler;
+        compiler->locals = reallocate(compiler->locals, sizeof(Clox_Local) * compiler->locals_capacity, sizeof(Clox_Local) * compiler->locals_capacity * 2); // TODO(Al-Andrew, AllocFailure): handle
+        memset(compiler->locals + compiler->locals_capacity, 0, sizeof(Clox_Local) * compiler->locals_capacity);
+        compiler->locals_capacity *= 2;
+    }
     
     Clox_Local* local = &parser->compiler->locals[parser->compiler->localCount++];
     local->name = token;
     local->depth = -1;
     local->is_captured = false;
+    local->is_reassigned = false;
+    local->brace_depth = parser->brace_depth;
+    local->capture = CLOX_CAPTURE_UNDECIDED;
+    local->inline_body = NULL;
 }
 
 static bool Clox_Identifiers_Compare(Clox_Token* a, Clox_Token* b) {
@@ -621,7 +849,7 @@ static void Clox_Compiler_Declare_Variable(Clox_Parser* parser) {
     Clox_Compiler_Add_Local(parser, *name);
 }
 
-static uint8_t Clox_Compiler_Parse_Variable(Clox_Parser* parser, char const * const message) {
+static uint16_t Clox_Compiler_Parse_Variable(Clox_Parser* parser, char const * const message) {
     Clox_Compiler_Consume(parser, CLOX_TOKEN_IDENTIFIER, message);
     
     Clox_Compiler_Declare_Variable(parser);
@@ -629,19 +857,19 @@ static uint8_t Clox_Compiler_Parse_Variable(Clox_Parser* parser, char const * co
         return 0;
     }
     
-    return Clox_Compiler_Emit_Identifier_Constant(parser);
+    return Clox_Compiler_Resolve_Global(parser);
 }
 
-static void Clox_Compiler_Emit_Define_Variable(Clox_Parser* parser, uint8_t global) {
+static void Clox_Compiler_Emit_Define_Variable(Clox_Parser* parser, uint16_t global) {
     if (parser->compiler->scopeDepth > 0) {
         Clox_Compiler_Mark_Local_Initialized(parser);
         return;
     }
-    Clox_Compiler_Emit_Bytes(parser, 2, OP_DEFINE_GLOBAL, global);
+    Clox_Compiler_Emit_Bytes(parser, 3, OP_DEFINE_GLOBAL, (global >> 8) & 0xff, global & 0xff);
 }
 
 static void Clox_Compiler_Compile_Variable_Declaration(Clox_Parser* parser) {
-    uint8_t global = Clox_Compiler_Parse_Variable(parser, "Expect variable name.");
+    uint16_t global = Clox_Compiler_Parse_Variable(parser, "Expect variable name.");
 
     if (Clox_Compiler_Match(parser, CLOX_TOKEN_EQUAL)) {
         Clox_Compiler_Compile_Expression(parser);
@@ -653,9 +881,94 @@ static void Clox_Compiler_Compile_Variable_Declaration(Clox_Parser* parser) {
     Clox_Compiler_Emit_Define_Variable(parser, global);
 }
 
-static void Clox_Compiler_Emit_Fuction(Clox_Parser* parser, Clox_Function_Type type) {
-    Clox_Compiler compiler = { 0 };
-    Clox_Compiler_Init(parser ,&compiler, type);
+// NOTE(Al-Andrew): called with the `{` of a function body just consumed. finds the expression of a body that is
+//                  nothing but `return <expression>;`. expressions can't contain braces so the first `;` ends it,
+//                  and naming the function itself anywhere in it rules out direct recursion.
+static char const* Clox_Compiler_Find_Inline_Expression(Clox_Parser* parser, Clox_Token* name, int* line) {
+    if (parser->current.type != CLOX_TOKEN_RETURN) {
+        return NULL;
+    }
+
+    Clox_Scanner lookahead = *parser->scanner;
+    Clox_Token token = Clox_Scanner_Get_Token(&lookahead);
+    if (token.type == CLOX_TOKEN_SEMICOLON) {
+        return NULL;
+    }
+    char const* start = token.start;
+    *line = token.line;
+
+    for (;;) {
+        switch (token.type) {
+            case CLOX_TOKEN_SEMICOLON: {
+                token = Clox_Scanner_Get_Token(&lookahead);
+                return token.type == CLOX_TOKEN_RIGHT_BRACE ? start : NULL;
+            } break;
+            case CLOX_TOKEN_LEFT_BRACE: /* fallthrough */
+            case CLOX_TOKEN_RIGHT_BRACE: /* fallthrough */
+            case CLOX_TOKEN_ERROR: /* fallthrough */
+            case CLOX_TOKEN_EOF: {
+                return NULL;
+            } break;
+            case CLOX_TOKEN_IDENTIFIER: {
+                if (Clox_Identifiers_Compare(&token, name) == 0) {
+                    return NULL;
+                }
+            } break;
+            default: {
+                /* no-op */
+            } break;
+        }
+        token = Clox_Scanner_Get_Token(&lookahead);
+    }
+}
+
+// NOTE(Al-Andrew): one pass over the whole source, the first time a top level function could be inlined. every name
+//                  after a `fun` counts 1, every name after a `var` or in front of an `=` counts 2, so a global is
+//                  only ever bound by its declaration if its count is exactly 1. shadowing locals count as well.
+static void Clox_Compiler_Collect_Global_Bindings(Clox_Parser* parser) {
+    Clox_Scanner lookahead = *parser->scanner; // NOTE(Al-Andrew): rewound rather than rebuilt, saves another strlen
+    lookahead.start = lookahead.current = parser->source;
+    lookahead.line = 1;
+    Clox_Token previous = {0};
+    for (Clox_Token token = Clox_Scanner_Get_Token(&lookahead); token.type != CLOX_TOKEN_EOF; previous = token, token = Clox_Scanner_Get_Token(&lookahead)) {
+        Clox_Token const* name = NULL;
+        double weight = 2;
+        if (token.type == CLOX_TOKEN_IDENTIFIER && previous.type == CLOX_TOKEN_FUN) {
+            name = &token;
+            weight = 1;
+        } else if (token.type == CLOX_TOKEN_IDENTIFIER && previous.type == CLOX_TOKEN_VAR) {
+            name = &token;
+        } else if (token.type == CLOX_TOKEN_EQUAL && previous.type == CLOX_TOKEN_IDENTIFIER) {
+            name = &previous;
+        }
+        if (name == NULL) {
+            continue;
+        }
+        Clox_String* key = Clox_String_Create(parser->vm, name->start, name->length);
+        Clox_Value count = CLOX_VALUE_NUMBER(0);
+        Clox_Hash_Table_Get(&parser->global_bindings, key, &count);
+        Clox_Hash_Table_Set(&parser->global_bindings, key, CLOX_VALUE_NUMBER(CLOX_VALUE_AS_NUMBER(count) + weight));
+    }
+    parser->global_bindings_collected = true;
+}
+
+// NOTE(Al-Andrew): a global function is only statically known if its declaration is the one binding the name ever
+//                  gets. the REPL compiles a line at a time so there a later line could always rebind it, and a streamed
+//                  source would have to be read to its end before the first function could be compiled.
+static bool Clox_Compiler_Is_Global_Rebound(Clox_Parser* parser, Clox_Token* name) {
+    if (parser->vm->incremental || parser->stream != NULL) {
+        return true;
+    }
+    if (!parser->global_bindings_collected) {
+        Clox_Compiler_Collect_Global_Bindings(parser);
+    }
+
+    Clox_Value count = {0};
+    Clox_String* key = Clox_String_Create(parser->vm, name->start, name->length);
+    return !Clox_Hash_Table_Get(&parser->global_bindings, key, &count) || CLOX_VALUE_AS_NUMBER(count) != 1;
+}
+
+static void Clox_Compiler_Compile_Parameters(Clox_Parser* parser) {
     Clox_Compiler_Begin_Scope(parser); 
 
     Clox_Compiler_Consume(parser, CLOX_TOKEN_LEFT_PAREN, "Expect '(' after function name.");
@@ -665,30 +978,179 @@ static void Clox_Compiler_Emit_Fuction(Clox_Parser* parser, Clox_Function_Type t
             if (parser->compiler->function->arity > 255) {
                 Clox_Compiler_Error_At_Token(parser, &parser->current, "Can't have more than 255 parameters.");
             }
-            uint8_t constant = Clox_Compiler_Parse_Variable(parser, "Expect parameter name.");
+            uint16_t constant = Clox_Compiler_Parse_Variable(parser, "Expect parameter name.");
             Clox_Compiler_Emit_Define_Variable(parser, constant);
         } while (Clox_Compiler_Match(parser, CLOX_TOKEN_COMMA));
     }
     Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_PAREN, "Expect ')' after parameters.");
     Clox_Compiler_Consume(parser, CLOX_TOKEN_LEFT_BRACE, "Expect '{' before function body.");
-    Clox_Compiler_Compile_Block(parser);
+    for (int i = 1; i < parser->compiler->localCount; i++) {
+        parser->compiler->locals[i].brace_depth = parser->brace_depth; // NOTE(Al-Andrew): parameters live in the body
+    }
+}
+
+// NOTE(Al-Andrew): where a function body starts. a forward jump is emitted before we know how far it goes, so when one
+//                  doesn't fit its short the whole body is compiled again from here with 32 bit offsets for every
+//                  forward jump. only huge generated functions ever pay for that, the rest keep the short encoding.
+typedef struct {
+    Clox_Scanner scanner;
+    Clox_Token current;
+    Clox_Token previous;
+    int brace_depth;
+    int inline_body_count;
+    int local_count;
+} Clox_Compiler_Checkpoint;
+
+static Clox_Compiler_Checkpoint Clox_Compiler_Save_Checkpoint(Clox_Parser* parser) {
+    return (Clox_Compiler_Checkpoint){
+        .scanner = *parser->scanner,
+        .current = parser->current,
+        .previous = parser->previous,
+        .brace_depth = parser->brace_depth,
+        .inline_body_count = parser->inline_body_count,
+        .local_count = parser->compiler->localCount,
+    };
+}
+
+// NOTE(Al-Andrew): true if the body just compiled has to be compiled again, everything it did is undone. what it did
+//                  to the enclosing compilers (captured locals, their upvalues) comes out the same the second time.
+static bool Clox_Compiler_Rewind_For_Long_Jumps(Clox_Parser* parser, Clox_Compiler_Checkpoint const* checkpoint) {
+    Clox_Compiler* compiler = parser->compiler;
+    if (!compiler->jump_overflow || parser->had_error) {
+        return false;
+    }
+    CLOX_DEV_ASSERT(!compiler->long_jumps);
+
+    if (parser->ring != NULL) {
+        // NOTE(Al-Andrew): the ring can't go back, the rest of the source is scanned on this thread
+        Clox_Token_Ring_Delete(parser->ring);
+        parser->ring = NULL;
+    }
+    *parser->scanner = checkpoint->scanner;
+    parser->current = checkpoint->current;
+    parser->previous = checkpoint->previous;
+    parser->brace_depth = checkpoint->brace_depth;
+    parser->inline_body_count = checkpoint->inline_body_count;
+
+    Clox_Function* function = compiler->function;
+    Clox_Chunk_Delete(&function->chunk);
+    function->chunk = Clox_Chunk_New_Empty();
+    function->upvalue_count = 0;
+    function->call_cache_count = 0;
+    function->has_captured_locals = false;
+
+    Clox_Value_Index_Map_Delete(&compiler->constant_map);
+    compiler->localCount = checkpoint->local_count;
+    compiler->last_call_offset = -1;
+    compiler->last_comparison_offset = -1;
+    compiler->last_jump_target = -1;
+    compiler->temporaries = 0;
+    compiler->last_callee_offset = -1;
+    compiler->last_callee_end = -1;
+    compiler->last_callee = NULL;
+    compiler->long_jumps = true;
+    compiler->jump_overflow = false;
+    return true;
+}
+
+// NOTE(Al-Andrew): the pre-scan of a lazy function's body, runs from its `{` to the matching `}`. the scanner still
+//                  reports anything it can't tokenize, everything else waits for the body to be compiled.
+static void Clox_Compiler_Skip_Block(Clox_Parser* parser) {
+    int depth = parser->brace_depth;
+    while (parser->brace_depth >= depth && !Clox_Compiler_Check(parser, CLOX_TOKEN_EOF)) {
+        Clox_Compiler_Advance(parser);
+    }
+    if (parser->brace_depth >= depth) {
+        Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_BRACE, "Expect '}' after block.");
+    }
+}
 
-    Clox_Function* function = Clox_Compiler_End(parser);
-    #ifdef CLOX_DEBUG_PRINT_COMPILED_CHUNKS
-        Clox_Chunk_Print(&function->chunk, function->name != NULL ? function->name->characters : "<script>");
-    #endif // CLOX_DEBUG_PRINT_COMPILED_CHUNKS
-    Clox_Compiler_Emit_Bytes(parser, 2, OP_CLOSURE, Clox_Compiler_Make_Constant(parser, CLOX_VALUE_OBJECT(function)));
+// NOTE(Al-Andrew): returns the next free entry of parser->inline_bodies filled in for `function` if it can be inlined,
+//                  the caller decides whether it is statically known and keeps it by bumping inline_body_count.
+static Clox_Inline_Body* Clox_Compiler_Emit_Fuction(Clox_Parser* parser, Clox_Function_Type type) {
+    Clox_Token name = parser->previous;
+    Clox_Compiler compiler = { 0 };
+    // NOTE(Al-Andrew): only functions declared at the top level of the script are compiled lazily. they can only ever
+    //                  see globals, so there are no captures to find ahead of time and the source is all a later
+    //                  compile needs. bodies we could inline are tiny and compiled right away.
+    bool lazy = parser->vm->lazy && !parser->vm->incremental && parser->compiler->type == CLOX_FUNCTION_TYPE_SCRIPT && parser->compiler->scopeDepth == 0;
+    Clox_Compiler_Init(parser ,&compiler, type);
+
+    char const* parameters = parser->current.start;
+    int parameters_line = parser->current.line;
+    Clox_Compiler_Compile_Parameters(parser);
+    int inline_line = 0;
+    char const* inline_start = Clox_Compiler_Find_Inline_Expression(parser, &name, &inline_line);
+
+    Clox_Function* function = parser->compiler->function;
+    if (lazy && inline_start == NULL) {
+        Clox_Compiler_Skip_Block(parser);
+        function->lazy_source = parameters;
+        function->lazy_line = parameters_line;
+        function->canonical_closure = Clox_Closure_Create(parser->vm, function);
+        CLOX_DEV_ASSERT(compiler.constant_map.slots == NULL); // NOTE(Al-Andrew): the parameter list has no constants
+        parser->compiler = parser->compiler->enclosing;
+    } else {
+        Clox_Compiler_Checkpoint checkpoint = Clox_Compiler_Save_Checkpoint(parser);
+        do {
+            Clox_Compiler_Compile_Block(parser);
+        } while (Clox_Compiler_Rewind_For_Long_Jumps(parser, &checkpoint));
+        function = Clox_Compiler_End(parser);
+        #ifdef CLOX_DEBUG_PRINT_COMPILED_CHUNKS
+            Clox_Chunk_Print(&function->chunk, function->name != NULL ? function->name->characters : "<script>");
+        #endif // CLOX_DEBUG_PRINT_COMPILED_CHUNKS
+    }
+    uint32_t constant = Clox_Compiler_Make_Constant(parser, CLOX_VALUE_OBJECT(function));
+    if (constant <= UINT8_MAX) {
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_CLOSURE, constant);
+    } else {
+        Clox_Compiler_Emit_Bytes(parser, 3, OP_CLOSURE_LONG, (constant >> 8) & 0xff, constant & 0xff);
+    }
 
     for (int i = 0; i < function->upvalue_count; i++) {
-        Clox_Compiler_Emit_Bytes(parser, 2, (compiler.upvalues[i].isLocal ? 1 : 0), (compiler.upvalues[i].index));
+        uint16_t index = compiler.upvalues[i].index;
+        uint8_t flags = (compiler.upvalues[i].isLocal ? CLOX_CAPTURE_FLAG_LOCAL : 0) | (compiler.upvalues[i].by_value ? CLOX_CAPTURE_FLAG_BY_VALUE : 0);
+        if (index <= UINT8_MAX) {
+            Clox_Compiler_Emit_Bytes(parser, 2, flags, index);
+        } else {
+            Clox_Compiler_Emit_Bytes(parser, 3, flags | CLOX_CAPTURE_FLAG_WIDE, (index >> 8) & 0xff, index & 0xff);
+        }
+    }
+
+    if (inline_start == NULL || parser->had_error || function->upvalue_count != 0 || function->arity > CLOX_COMPILER_INLINE_MAX_ARITY ||
+        function->chunk.used > CLOX_COMPILER_INLINE_MAX_BYTES || parser->inline_body_count == CLOX_COMPILER_MAX_INLINE_BODIES) {
+        Clox_Compiler_Delete(&compiler);
+        return NULL;
+    }
+    Clox_Inline_Body* inline_body = &parser->inline_bodies[parser->inline_body_count];
+    inline_body->function = function;
+    for (int i = 0; i < function->arity; i++) {
+        inline_body->parameters[i] = compiler.locals[1 + i].name;
     }
+    inline_body->start = inline_start;
+    inline_body->line = inline_line;
+    inline_body->global_slot = UINT32_MAX;
+    Clox_Compiler_Delete(&compiler);
+    return inline_body;
 }
 
 static void Clox_Compiler_Compile_Function_Declaration(Clox_Parser* parser) {
-    uint8_t global = Clox_Compiler_Parse_Variable(parser, "Expect function name.");
+    uint16_t global = Clox_Compiler_Parse_Variable(parser, "Expect function name.");
+    Clox_Token name = parser->previous;
     Clox_Compiler_Mark_Local_Initialized(parser);
-    Clox_Compiler_Emit_Fuction(parser, CLOX_FUNCTION_TYPE_FUNCTION);
+    Clox_Inline_Body* inline_body = Clox_Compiler_Emit_Fuction(parser, CLOX_FUNCTION_TYPE_FUNCTION);
     Clox_Compiler_Emit_Define_Variable(parser, global);
+
+    if (inline_body == NULL) {
+        return;
+    }
+    if (parser->compiler->scopeDepth > 0) {
+        parser->compiler->locals[parser->compiler->localCount - 1].inline_body = inline_body;
+        parser->inline_body_count++;
+    } else if (!Clox_Compiler_Is_Global_Rebound(parser, &name)) {
+        inline_body->global_slot = global;
+        parser->inline_body_count++;
+    }
 }
 
 void Clox_Compiler_Compile_Declaration(Clox_Parser* parser) {
@@ -720,7 +1182,47 @@ static int Clox_Compiler_Resolve_Local(Clox_Parser* parser, Clox_Compiler* compi
     return -1;
 }
 
-static int Clox_Compiler_Add_Upvalue(Clox_Parser* parser, Clox_Compiler* compiler, uint8_t index, bool isLocal) {
+// NOTE(Al-Andrew): scans the tokens from the parser's position to the end of `local`'s block for `name =`. shadowing
+//                  names and invalid assignment targets count as well, we only need to never miss a real one.
+static bool Clox_Compiler_Is_Assigned_Later(Clox_Parser* parser, Clox_Local* local) {
+    Clox_Scanner lookahead = *parser->scanner;
+    Clox_Token previous = parser->previous;
+    Clox_Token token = parser->current;
+    int depth = parser->brace_depth;
+
+    for (;;) {
+        if (token.type == CLOX_TOKEN_EQUAL && previous.type == CLOX_TOKEN_IDENTIFIER && Clox_Identifiers_Compare(&previous, &local->name) == 0) {
+            return true;
+        }
+        if (token.type == CLOX_TOKEN_EOF) {
+            return false;
+        }
+        if (token.type == CLOX_TOKEN_LEFT_BRACE) {
+            depth++;
+        } else if (token.type == CLOX_TOKEN_RIGHT_BRACE) {
+            depth--;
+            if (depth < local->brace_depth) {
+                return false;
+            }
+        }
+        previous = token;
+        token = Clox_Scanner_Get_Token(&lookahead);
+    }
+}
+
+// NOTE(Al-Andrew): a local that is never assigned after its declaration can be copied into the closure when it is
+//                  created instead of going through an upvalue object. decided once, on the first capture: anything
+//                  assigned before that point is flagged already and anything after it is found by the lookahead.
+//                  a local function capturing itself is fine too, OP_CLOSURE pushes the closure before it captures.
+static bool Clox_Compiler_Capture_By_Value(Clox_Parser* parser, Clox_Local* local) {
+    if (local->capture == CLOX_CAPTURE_UNDECIDED) {
+        bool by_value = !local->is_reassigned && !Clox_Compiler_Is_Assigned_Later(parser, local);
+        local->capture = by_value ? CLOX_CAPTURE_BY_VALUE : CLOX_CAPTURE_BY_REFERENCE;
+    }
+    return local->capture == CLOX_CAPTURE_BY_VALUE;
+}
+
+static int Clox_Compiler_Add_Upvalue(Clox_Parser* parser, Clox_Compiler* compiler, uint16_t index, bool isLocal, bool by_value) {
     int upvalueCount = compiler->function->upvalue_count;
 
     for (int i = 0; i < upvalueCount; i++) {
@@ -730,13 +1232,19 @@ static int Clox_Compiler_Add_Upvalue(Clox_Parser* parser, Clox_Compiler* compile
         }
     }
 
-    if (upvalueCount == UINT8_MAX) {
+    if (upvalueCount == CLOX_COMPILER_MAX_UPVALUES) {
         Clox_Compiler_Error(parser, "Too many closure variables in function.");
         return -1;
     }
+    if (upvalueCount == compiler->upvalues_capacity) {
+        int capacity = compiler->upvalues_capacity == 0 ? 8 : compiler->upvalues_capacity * 2;
+        compiler->upvalues = reallocate(compiler->upvalues, sizeof(Clox_Upvalue) * compiler->upvalues_capacity, sizeof(Clox_Upvalue) * capacity); // TODO(Al-Andrew, AllocFailure): handle
+        compiler->upvalues_capacity = capacity;
+    }
 
     compiler->upvalues[upvalueCount].isLocal = isLocal;
     compiler->upvalues[upvalueCount].index = index;
+    compiler->upvalues[upvalueCount].by_value = by_value;
     return compiler->function->upvalue_count++;
 }
 
@@ -745,43 +1253,98 @@ static int Clox_Compiler_Resolve_Upvalue(Clox_Parser* parser, Clox_Compiler* com
 
     int local = Clox_Compiler_Resolve_Local(parser, compiler->enclosing, token);
     if (local != -1) {
-        compiler->enclosing->locals[local].is_captured = true;
-        return Clox_Compiler_Add_Upvalue(parser, compiler, (uint8_t)local, true);
+        bool by_value = Clox_Compiler_Capture_By_Value(parser, &compiler->enclosing->locals[local]);
+        if (!by_value) {
+            compiler->enclosing->locals[local].is_captured = true;
+            compiler->enclosing->function->has_captured_locals = true;
+        }
+        return Clox_Compiler_Add_Upvalue(parser, compiler, (uint16_t)local, true, by_value);
     }
 
     int upvalue = Clox_Compiler_Resolve_Upvalue(parser, compiler->enclosing, token);
     if (upvalue != -1) {
-        return Clox_Compiler_Add_Upvalue(parser, compiler, (uint8_t)upvalue, false);
+        return Clox_Compiler_Add_Upvalue(parser, compiler, (uint16_t)upvalue, false, compiler->enclosing->upvalues[upvalue].by_value);
     }
 
     return -1;
 }
 
 
+// NOTE(Al-Andrew): remembers that the load just emitted from `offset` on produced a function we can inline, a call
+//                  right behind it compiles the body in its place.
+static void Clox_Compiler_Note_Callee(Clox_Parser* parser, int offset, Clox_Inline_Body const* inline_body) {
+    parser->compiler->last_callee_offset = offset;
+    parser->compiler->last_callee_end = Clox_Compiler_Current_Chunk(parser)->used;
+    parser->compiler->last_callee = inline_body;
+}
+
+static Clox_Inline_Body const* Clox_Compiler_Global_Inline_Body(Clox_Parser* parser, uint16_t slot) {
+    for (int i = 0; i < parser->inline_body_count; i++) {
+        if (parser->inline_bodies[i].global_slot == slot) {
+            return &parser->inline_bodies[i];
+        }
+    }
+    return NULL;
+}
+
+// NOTE(Al-Andrew): a local function binding is statically known when it is never assigned after its declaration,
+//                  which is the same question capturing it by value asks, so that decision gets reused.
+static Clox_Inline_Body const* Clox_Compiler_Local_Inline_Body(Clox_Parser* parser, Clox_Local* local) {
+    if (local->inline_body == NULL || !Clox_Compiler_Capture_By_Value(parser, local)) {
+        return NULL;
+    }
+    return local->inline_body;
+}
+
+// NOTE(Al-Andrew): a local or upvalue instruction, with the OP_WIDE prefix once `slot` doesn't fit its operand byte
+static void Clox_Compiler_Emit_Slot_Op(Clox_Parser* parser, uint8_t op, int slot) {
+    if (slot <= UINT8_MAX) {
+        Clox_Compiler_Emit_Bytes(parser, 2, op, slot);
+    } else {
+        Clox_Compiler_Emit_Bytes(parser, 4, OP_WIDE, op, (slot >> 8) & 0xff, slot & 0xff);
+    }
+}
+
 static inline void Clox_Compiler_Compile_Named_Variable(Clox_Parser* parser, bool can_assign) {
     uint8_t getOp, setOp;
     Clox_Token* name = &parser->previous; 
     int arg = Clox_Compiler_Resolve_Local(parser, parser->compiler, name);
+    if (arg != -1 && arg < parser->inline_base) {
+        arg = -1; // NOTE(Al-Andrew): an inlined body only sees its parameters, every other name in it is a global
+    }
     if (arg != -1) {
         getOp = OP_GET_LOCAL;
         setOp = OP_SET_LOCAL;
-    } else if ((arg = Clox_Compiler_Resolve_Upvalue(parser, parser->compiler, name)) != -1) {
-        getOp = OP_GET_UPVALUE;
+    } else if (parser->inline_base < 0 && (arg = Clox_Compiler_Resolve_Upvalue(parser, parser->compiler, name)) != -1) {
+        getOp = parser->compiler->upvalues[arg].by_value ? OP_GET_FLAT_UPVALUE : OP_GET_UPVALUE;
         setOp = OP_SET_UPVALUE;
 
     } else {
-        arg = Clox_Compiler_Emit_Identifier_Constant(parser);
-        getOp = OP_GET_GLOBAL;
-        setOp = OP_SET_GLOBAL;
+        uint16_t slot = Clox_Compiler_Resolve_Global(parser);
+        if (can_assign && Clox_Compiler_Match(parser, CLOX_TOKEN_EQUAL)) {
+            Clox_Compiler_Compile_Expression(parser);
+            Clox_Compiler_Emit_Bytes(parser, 3, OP_SET_GLOBAL, (slot >> 8) & 0xff, slot & 0xff);
+        } else {
+            int offset = Clox_Compiler_Current_Chunk(parser)->used;
+            Clox_Compiler_Emit_Bytes(parser, 3, OP_GET_GLOBAL, (slot >> 8) & 0xff, slot & 0xff);
+            Clox_Compiler_Note_Callee(parser, offset, Clox_Compiler_Global_Inline_Body(parser, slot));
+        }
+        return;
     }
 
-    // uint8_t arg = Clox_Compiler_Emit_Identifier_Constant(parser);
-
     if (can_assign && Clox_Compiler_Match(parser, CLOX_TOKEN_EQUAL)) {
+        if (setOp == OP_SET_LOCAL) {
+            parser->compiler->locals[arg].is_reassigned = true;
+        }
+        CLOX_DEV_ASSERT(getOp != OP_GET_FLAT_UPVALUE); // NOTE(Al-Andrew): the lookahead saw this `=`
         Clox_Compiler_Compile_Expression(parser);
-        Clox_Compiler_Emit_Bytes(parser, 2, setOp, (uint8_t)arg);
+        Clox_Compiler_Emit_Slot_Op(parser, setOp, arg);
     } else {
-        Clox_Compiler_Emit_Bytes(parser, 2, getOp, (uint8_t)arg);
+        int offset = Clox_Compiler_Current_Chunk(parser)->used;
+        Clox_Compiler_Emit_Slot_Op(parser, getOp, arg);
+        if (getOp == OP_GET_LOCAL) {
+            Clox_Compiler_Note_Callee(parser, offset, Clox_Compiler_Local_Inline_Body(parser, &parser->compiler->locals[arg]));
+        }
     }
 }
 
@@ -820,43 +1383,196 @@ static uint8_t Clox_Compiler_Compile_Argument_List(Clox_Parser* parser) {
         do {
             Clox_Compiler_Compile_Expression(parser);
             argCount++;
+            parser->compiler->temporaries++;
         } while (Clox_Compiler_Match(parser, CLOX_TOKEN_COMMA));
     }
     Clox_Compiler_Consume(parser, CLOX_TOKEN_RIGHT_PAREN, "Expect ')' after arguments.");
+    parser->compiler->temporaries -= argCount;
     return argCount;
 }
 
+// NOTE(Al-Andrew): counts the arguments between the `(` just consumed and its `)` without compiling them, -1 if the
+//                  parentheses don't close.
+static int Clox_Compiler_Count_Arguments(Clox_Parser* parser) {
+    if (parser->current.type == CLOX_TOKEN_RIGHT_PAREN) {
+        return 0;
+    }
+
+    Clox_Scanner lookahead = *parser->scanner;
+    Clox_Token token = parser->current;
+    int count = 1;
+    int depth = 0;
+    for (;;) {
+        switch (token.type) {
+            case CLOX_TOKEN_LEFT_PAREN: {
+                depth++;
+            } break;
+            case CLOX_TOKEN_RIGHT_PAREN: {
+                if (depth == 0) {
+                    return count;
+                }
+                depth--;
+            } break;
+            case CLOX_TOKEN_COMMA: {
+                if (depth == 0) {
+                    count++;
+                }
+            } break;
+            case CLOX_TOKEN_ERROR: /* fallthrough */
+            case CLOX_TOKEN_EOF: {
+                return -1;
+            } break;
+            default: {
+                /* no-op */
+            } break;
+        }
+        token = Clox_Scanner_Get_Token(&lookahead);
+    }
+}
+
+// NOTE(Al-Andrew): replaces a call to a statically known inlinable function. the callee load is dropped, the arguments
+//                  stay on the stack as locals named after the parameters and the body's expression is compiled again
+//                  from the callee's source, so its instructions keep the callee's lines for runtime errors. an inline
+//                  site on the chunk tells the traceback which call they came from. values the surrounding expression
+//                  has pushed get nameless locals first so local indices are stack slots again. the result is moved
+//                  into the first argument's slot and the rest popped.
+static bool Clox_Compiler_Inline_Call(Clox_Parser* parser) {
+    Clox_Compiler* compiler = parser->compiler;
+    Clox_Chunk* chunk = Clox_Compiler_Current_Chunk(parser);
+    Clox_Inline_Body const* body = compiler->last_callee;
+    if (body == NULL || compiler->last_callee_end != (int)chunk->used || compiler->last_jump_target == (int)chunk->used) {
+        return false;
+    }
+    if (parser->inline_depth == CLOX_COMPILER_INLINE_MAX_DEPTH || Clox_Compiler_Count_Arguments(parser) != body->function->arity) {
+        return false;
+    }
+    // NOTE(Al-Andrew): `var x = f(...);` in a block declared x already but its slot is where the result will go
+    bool has_pending = compiler->localCount > 0 && compiler->locals[compiler->localCount - 1].depth == -1;
+    int base = compiler->localCount - (has_pending ? 1 : 0);
+    if (base + compiler->temporaries + body->function->arity >= UINT8_MAX) {
+        return false;
+    }
+
+    chunk->used = compiler->last_callee_offset;
+    compiler->last_callee = NULL;
+    int arity = Clox_Compiler_Compile_Argument_List(parser);
+    uint32_t call_line = (uint32_t)parser->previous.line; // NOTE(Al-Andrew): the line OP_CALL would have had
+
+    Clox_Local pending = compiler->locals[base];
+    compiler->localCount = base;
+    for (int i = 0; i < compiler->temporaries + arity; i++) {
+        Clox_Compiler_Add_Local(parser, i < compiler->temporaries ? (Clox_Token){0} : body->parameters[i - compiler->temporaries]);
+        compiler->locals[compiler->localCount - 1].depth = compiler->scopeDepth;
+    }
+    int first_parameter = base + compiler->temporaries;
+
+    Clox_Scanner* scanner = parser->scanner;
+    Clox_Token_Ring* ring = parser->ring;
+    Clox_Token current = parser->current;
+    Clox_Token previous = parser->previous;
+    int temporaries = compiler->temporaries;
+    int inline_base = parser->inline_base;
+    Clox_Scanner body_scanner = {.start = body->start, .current = body->start, .line = body->line};
+    uint32_t body_start = chunk->used;
+
+    parser->scanner = &body_scanner;
+    parser->ring = NULL;
+    parser->inline_base = first_parameter;
+    parser->inline_depth++;
+    compiler->temporaries = 0;
+    Clox_Compiler_Advance(parser);
+    Clox_Compiler_Compile_Expression(parser);
+    parser->scanner = scanner;
+    parser->ring = ring;
+    parser->current = current;
+    parser->previous = previous;
+    parser->inline_base = inline_base;
+    parser->inline_depth--;
+    compiler->temporaries = temporaries;
+    if (chunk->used > body_start) {
+        Clox_Chunk_Push_Inline_Site(chunk, (Clox_Inline_Site){
+            .start = body_start,
+            .end = chunk->used,
+            .call_line = call_line,
+            .callee = body->function->name,
+        });
+    }
+
+    if (arity > 0) {
+        Clox_Compiler_Emit_Bytes(parser, 2, OP_SET_LOCAL, (uint8_t)first_parameter);
+        for (int i = 0; i < arity; i++) {
+            Clox_Compiler_Emit_Byte(parser, OP_POP);
+        }
+    }
+
+    compiler->localCount = base;
+    if (has_pending) {
+        compiler->locals[compiler->localCount++] = pending;
+    }
+    return true;
+}
+
 static void Clox_Compiler_Compile_Call(Clox_Parser* parser, bool can_assign) {
     (void)can_assign;
 
+    if (Clox_Compiler_Inline_Call(parser)) {
+        return;
+    }
+
+    parser->compiler->temporaries++; // NOTE(Al-Andrew): the callee
     uint8_t argCount = Clox_Compiler_Compile_Argument_List(parser);
+    parser->compiler->temporaries--;
 
     if (argCount == 255) {
         Clox_Compiler_Error(parser, "Can't have more than 255 arguments.");
     }
 
-    Clox_Compiler_Emit_Bytes(parser, 2, OP_CALL, argCount);
+    // NOTE(Al-Andrew): past CLOX_MAX_CALL_CACHES sites in one function the rest share the last cache entry. still
+    //                  correct since the cache checks the callee, it just stops being monomorphic.
+    Clox_Function* function = parser->compiler->function;
+    uint16_t cache_index = (uint16_t)(function->call_cache_count < CLOX_MAX_CALL_CACHES ? function->call_cache_count++ : CLOX_MAX_CALL_CACHES - 1);
+
+    parser->compiler->last_call_offset = Clox_Compiler_Current_Chunk(parser)->used;
+    Clox_Compiler_Emit_Bytes(parser, 4, OP_CALL, argCount, (cache_index >> 8) & 0xff, cache_index & 0xff);
 }
 
 
 
-Clox_Function* Clox_Compile_Source_To_Function(Clox_VM* vm, const char* source) {
+static Clox_Function* Clox_Compiler_Compile_Script(Clox_VM* vm, const char* source, Clox_Source_Stream* stream) {
     Clox_Parser parser = {0};
     Clox_Scanner scanner = Clox_Scanner_New(source);
+    scanner.stream = stream;
     Clox_Compiler compiler = {0};
     parser.vm = vm;
     parser.scanner = &scanner;
+    parser.source = source;
+    parser.stream = stream;
+    parser.inline_base = -1;
     Clox_Compiler_Init(&parser, &compiler, CLOX_FUNCTION_TYPE_SCRIPT);
     parser.compiler = &compiler;
     // compiling_chunk = chunk;
+    Clox_Token_Ring ring;
+    // NOTE(Al-Andrew): a streamed source is refilled by whichever scanner reaches its sentinel, lookaheads included,
+    //                  so its scanning stays on this thread
+    if (vm->pipelined && !vm->incremental && stream == NULL && Clox_Token_Ring_Start(&ring, scanner)) {
+        parser.ring = &ring;
+    }
     
     Clox_Compiler_Advance(&parser);
     
-    while (!Clox_Compiler_Match(&parser, CLOX_TOKEN_EOF)) {
-        Clox_Compiler_Compile_Declaration(&parser);
-    }
+    Clox_Compiler_Checkpoint checkpoint = Clox_Compiler_Save_Checkpoint(&parser);
+    do {
+        while (!Clox_Compiler_Match(&parser, CLOX_TOKEN_EOF)) {
+            Clox_Compiler_Compile_Declaration(&parser);
+        }
+    } while (Clox_Compiler_Rewind_For_Long_Jumps(&parser, &checkpoint));
 
+    if (parser.ring != NULL) {
+        Clox_Token_Ring_Delete(parser.ring);
+    }
+    Clox_Hash_Table_Destory(&parser.global_bindings);
     Clox_Function* fn = Clox_Compiler_End(&parser);
+    Clox_Compiler_Delete(&compiler);
 
 #ifdef CLOX_DEBUG_PRINT_COMPILED_CHUNKS
     if (!parser.had_error) {
@@ -864,4 +1580,43 @@ Clox_Function* Clox_Compile_Source_To_Function(Clox_VM* vm, const char* source)
     }
 #endif
     return parser.had_error?NULL: fn;
+}
+
+Clox_Function* Clox_Compile_Source_To_Function(Clox_VM* vm, const char* source) {
+    return Clox_Compiler_Compile_Script(vm, source, NULL);
+}
+
+Clox_Function* Clox_Compile_Stream_To_Function(Clox_VM* vm, Clox_Source_Stream* stream) {
+    return Clox_Compiler_Compile_Script(vm, stream->buffer, stream);
+}
+
+bool Clox_Compile_Lazy_Function(Clox_VM* vm, Clox_Function* function) {
+    CLOX_DEV_ASSERT(function->lazy_source != NULL);
+    Clox_Parser parser = {0};
+    Clox_Scanner scanner = {.start = function->lazy_source, .current = function->lazy_source, .line = function->lazy_line};
+    Clox_Compiler compiler = {0};
+    parser.vm = vm;
+    parser.scanner = &scanner;
+    parser.source = function->lazy_source;
+    parser.inline_base = -1;
+    compiler.function = function;
+    function->arity = 0; // NOTE(Al-Andrew): counted again by the real parameter list
+    function->lazy_source = NULL;
+    Clox_Compiler_Init(&parser, &compiler, CLOX_FUNCTION_TYPE_FUNCTION);
+
+    Clox_Compiler_Advance(&parser);
+    Clox_Compiler_Compile_Parameters(&parser);
+    Clox_Compiler_Checkpoint checkpoint = Clox_Compiler_Save_Checkpoint(&parser);
+    do {
+        Clox_Compiler_Compile_Block(&parser);
+    } while (Clox_Compiler_Rewind_For_Long_Jumps(&parser, &checkpoint));
+    Clox_Compiler_End(&parser);
+    Clox_Compiler_Delete(&compiler);
+
+#ifdef CLOX_DEBUG_PRINT_COMPILED_CHUNKS
+    if (!parser.had_error) {
+        Clox_Chunk_Print(&function->chunk, function->name->characters);
+    }
+#endif
+    return !parser.had_error;
 }
\ No newline at end of file
@@ -4,7 +4,43 @@
 #include "chunk.h"
 #include "value.h"
 #include "object.h"
+#include "source.h"
+
+// NOTE(Al-Andrew): calls to small functions whose body is a single `return <expression>;` get that expression compiled
+//                  in place of the call. bounds on the callee's compiled size, its parameter count and how deep inlined
+//                  bodies may inline further (this is what stops mutually recursive helpers). 0 bytes turns it off.
+#ifndef CLOX_COMPILER_INLINE_MAX_BYTES
+#define CLOX_COMPILER_INLINE_MAX_BYTES 32
+#endif // CLOX_COMPILER_INLINE_MAX_BYTES
+
+#ifndef CLOX_COMPILER_INLINE_MAX_ARITY
+#define CLOX_COMPILER_INLINE_MAX_ARITY 8
+#endif // CLOX_COMPILER_INLINE_MAX_ARITY
+
+#ifndef CLOX_COMPILER_INLINE_MAX_DEPTH
+#define CLOX_COMPILER_INLINE_MAX_DEPTH 4
+#endif // CLOX_COMPILER_INLINE_MAX_DEPTH
+
+#ifndef CLOX_COMPILER_MAX_INLINE_BODIES
+#define CLOX_COMPILER_MAX_INLINE_BODIES 64
+#endif // CLOX_COMPILER_MAX_INLINE_BODIES
+
+// NOTE(Al-Andrew): the first 256 locals and upvalues of a function are named by a byte, the rest by an OP_WIDE short.
+#ifndef CLOX_COMPILER_MAX_LOCALS
+#define CLOX_COMPILER_MAX_LOCALS (UINT16_MAX + 1)
+#endif // CLOX_COMPILER_MAX_LOCALS
+
+#ifndef CLOX_COMPILER_MAX_UPVALUES
+#define CLOX_COMPILER_MAX_UPVALUES (UINT16_MAX + 1)
+#endif // CLOX_COMPILER_MAX_UPVALUES
 
 Clox_Function* Clox_Compile_Source_To_Function(Clox_VM* vm, const char* source);
+// NOTE(Al-Andrew): same, but starts on the lines that arrived so far and waits for more as it gets to them. the stream
+//                  has to outlive the functions, lazy ones compile from its buffer later.
+Clox_Function* Clox_Compile_Stream_To_Function(Clox_VM* vm, Clox_Source_Stream* stream);
+
+// NOTE(Al-Andrew): compiles the body of a function Clox_Compile_Source_To_Function left as a stub (Clox_VM.lazy) into
+//                  that same function, from the source it was compiled from. false if the body has errors.
+bool Clox_Compile_Lazy_Function(Clox_VM* vm, Clox_Function* function);
 
 #endif // CLOX_COMPILER_H_INCLUDED
\ No newline at end of file
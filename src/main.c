@@ -1,6 +1,7 @@
 #include "common.h"
 #include "chunk.h"
 #include "vm.h"
+#include "source.h"
 #include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -10,15 +11,23 @@
 int Clox_Print_Help() {
 
     printf("clox - interpeter for the lox programming language, written in C\n");
-    printf("\nUsage: clox [file]\n");
+    printf("\nUsage: clox [-O] [-L] [-P] [-C] [file]\n");
     printf("WHERE:\n");
-    printf("    [file] - one file containing lox source code for the interpreter to run.\n");
+    printf("    -O     - run the optimizer over the compiled bytecode before executing it.\n");
+    printf("    -L     - compile function bodies only when they are first called.\n");
+    printf("    -P     - scan the source on a second thread while it is being compiled.\n");
+    printf("    -C     - keep the compiled program in $CLOX_CACHE_DIR (default ~/.cache/clox) and reuse it while\n");
+    printf("             the source doesn't change.\n");
+    printf("    [file] - one file containing lox source code for the interpreter to run. `-` or a pipe is compiled\n");
+    printf("             as its lines arrive.\n");
 
     return 1;
 }
 
-int Clox_Repl() {
+int Clox_Repl(bool optimize) {
     Clox_VM vm = Clox_VM_New_Empty();
+    vm.optimize = optimize;
+    vm.incremental = true;
     char line[1024];
     for (;;) {
         printf("> ");
@@ -38,40 +47,35 @@ int Clox_Repl() {
     return 0;
 }
 
-char* Clox_Read_File(const char* path_to_file) {
-    
-    FILE* file = fopen(path_to_file, "rb");
-    if(file == NULL) {
-        printf("[Error] Could not get descriptor for file %s.\n", path_to_file);
-        return NULL;
-    }
-
-    fseek(file, 0L, SEEK_END);
-    size_t fileSize = ftell(file);
-    rewind(file);
-
-    char* buffer = (char*)reallocate(NULL, 0, fileSize + 1);
-
-    if(buffer == NULL) {
-        return NULL;
-    }
-
+int Clox_Run_File(const char* path_to_file, bool optimize, bool lazy, bool pipelined, bool cached) {
+    bool streamed = Clox_Source_Is_Stream(path_to_file);
+    Clox_Source source = {0};
+    Clox_Source_Stream stream = {0};
+    bool loaded = streamed ? Clox_Source_Stream_Open(&stream, path_to_file) : Clox_Source_Load_File(&source, path_to_file);
 
-    size_t bytesRead = fread(buffer, sizeof(char), fileSize, file);
-    buffer[bytesRead] = '\0';
-
-    fclose(file);
-    return buffer;
-}
-
-int Clox_Run_File(const char* path_to_file) {
-    char* source = Clox_Read_File(path_to_file);
     Clox_VM vm = Clox_VM_New_Empty();
-
-    Clox_Interpret_Result result = Clox_VM_Interpret_Source(&vm, source);
-    deallocate(source);
-    source = NULL;
+    vm.optimize = optimize;
+    vm.lazy = lazy;
+    vm.pipelined = pipelined;
+
+    Clox_Interpret_Result result = {.status = INTERPRET_COMPILE_ERROR};
+    Clox_Bytecode_Cache cache;
+    bool use_cache = loaded && cached && !streamed && Clox_Bytecode_Cache_Open(&cache, &vm, &source);
+    if (use_cache) {
+        result = Clox_VM_Interpret_Cached(&vm, &source, &cache);
+    } else if (loaded) {
+        result = streamed ? Clox_VM_Interpret_Stream(&vm, &stream) : Clox_VM_Interpret_Source(&vm, source.text);
+    }
     Clox_VM_Delete(&vm);
+    // NOTE(Al-Andrew): after the VM, lazy functions compile from the source and cached ones run from the image
+    if (use_cache) {
+        Clox_Bytecode_Cache_Delete(&cache);
+    }
+    if (loaded && streamed) {
+        Clox_Source_Stream_Delete(&stream);
+    } else if (loaded) {
+        Clox_Source_Delete(&source);
+    }
     return result.status;
 }
 
@@ -79,10 +83,23 @@ int Clox_Run_File(const char* path_to_file) {
 int main(int argc, char** argv)
 {
     // TODO(Al-Andrew, Args): make/use a proper command line argumnets parser
+    bool optimize = false;
+    bool lazy = false;
+    bool pipelined = false;
+    bool cached = false;
+    while (argc > 1 && (strcmp(argv[1], "-O") == 0 || strcmp(argv[1], "-L") == 0 || strcmp(argv[1], "-P") == 0 || strcmp(argv[1], "-C") == 0)) {
+        optimize |= argv[1][1] == 'O';
+        lazy |= argv[1][1] == 'L';
+        pipelined |= argv[1][1] == 'P';
+        cached |= argv[1][1] == 'C';
+        argc -= 1;
+        argv += 1;
+    }
+
     if(argc == 1) {
-        return Clox_Repl();
+        return Clox_Repl(optimize);
     } else if (argc == 2) {
-        return Clox_Run_File(argv[1]);
+        return Clox_Run_File(argv[1], optimize, lazy, pipelined, cached);
     } else {
         return Clox_Print_Help();
     }
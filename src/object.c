@@ -28,6 +28,9 @@ void Clox_Object_Deallocate(Clox_VM* vm, Clox_Object* object) {
         case CLOX_OBJECT_TYPE_FUNCTION: {
             Clox_Function* function = (Clox_Function*)object;
             Clox_Chunk_Delete(&function->chunk);
+            if (function->call_caches) {
+                deallocate(function->call_caches);
+            }
             deallocate(object);
         } break;
     }
@@ -99,9 +102,26 @@ Clox_Function* Clox_Function_Create_Empty(Clox_VM* vm) {
     function->upvalue_count = 0;
     function->name = NULL;
     function->chunk = Clox_Chunk_New_Empty();
+    function->max_stack_height = 0;
+    function->verified = false;
+    function->call_cache_count = 0;
+    function->call_caches = NULL;
+    function->has_captured_locals = false;
+    function->canonical_closure = NULL;
+    function->lazy_source = NULL;
+    function->lazy_line = 0;
     return function;
 }
 
+void Clox_Function_Allocate_Call_Caches(Clox_Function* function) {
+    CLOX_DEV_ASSERT(function->call_caches == NULL);
+    if (function->call_cache_count == 0) {
+        return;
+    }
+    function->call_caches = reallocate(NULL, 0, sizeof(Clox_Call_Cache) * function->call_cache_count); // TODO(Al-Andrew, AllocFailure): handle
+    memset(function->call_caches, 0, sizeof(Clox_Call_Cache) * function->call_cache_count);
+}
+
 Clox_Native* Clox_Native_Create(Clox_VM* vm, Clox_Native_Fn lambda) {
     Clox_Native* native = (Clox_Native*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_NATIVE, sizeof(Clox_Native));
     native->function = lambda;
@@ -111,40 +131,30 @@ Clox_Native* Clox_Native_Create(Clox_VM* vm, Clox_Native_Fn lambda) {
 
 Clox_Closure* Clox_Closure_Create(Clox_VM* vm, Clox_Function* function) {
 
-    Clox_Closure* closure = (Clox_Closure*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_CLOSURE, sizeof(Clox_Closure) + sizeof(Clox_UpvalueObj*) * function->upvalue_count);
+    Clox_Closure* closure = (Clox_Closure*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_CLOSURE, sizeof(Clox_Closure) + sizeof(Clox_Closure_Upvalue) * function->upvalue_count);
     closure->function = function;
     closure->upvalue_count = function->upvalue_count;
 
     for (int i = 0; i < function->upvalue_count; i++) {
-        closure->upvalues[i] = NULL;
+        closure->upvalues[i].upvalue = NULL;
     }
     return closure;
 }
 
 Clox_UpvalueObj* Clox_UpvalueObj_Create(Clox_VM* vm, Clox_Value* slot) {
-    
-    Clox_UpvalueObj* prevUpvalue = NULL;
-    Clox_UpvalueObj* upvalue = vm->open_upvalues;
-    while (upvalue != NULL && upvalue->location > slot) {
-        prevUpvalue = upvalue;
-        upvalue = upvalue->next;
-    }
+    CLOX_DEV_ASSERT(slot >= vm->stack && slot < vm->stack_top);
 
-    if (upvalue != NULL && upvalue->location == slot) {
-        return upvalue;
+    Clox_UpvalueObj** open_upvalue = &vm->open_upvalues[slot - vm->stack];
+    if (*open_upvalue != NULL) {
+        return *open_upvalue;
     }
 
     Clox_UpvalueObj* created_upvalue = (Clox_UpvalueObj*)Clox_Object_Allocate(vm, CLOX_OBJECT_TYPE_UPVALUE, sizeof(Clox_UpvalueObj));
     created_upvalue->location = slot;
-    created_upvalue->next = NULL;
-    created_upvalue->next = upvalue;
     created_upvalue->closed = CLOX_VALUE_NIL;
 
-    if (prevUpvalue == NULL) {
-        vm->open_upvalues = created_upvalue;
-    } else {
-        prevUpvalue->next = created_upvalue;
-    }
+    *open_upvalue = created_upvalue;
+    vm->open_upvalue_count++;
 
     return created_upvalue;
 }
@@ -48,34 +48,66 @@ struct Clox_String {
 Clox_String* Clox_String_Create(Clox_VM* vm, const char* string, uint32_t len);
 
 typedef struct Clox_Function Clox_Function;
+typedef struct Clox_Closure Clox_Closure;
+
+// NOTE(Al-Andrew): one per OP_CALL site, remembers the last closure's function called from there so the next call
+//                  to the same function can skip Clox_VM_Call_Value. `function` is NULL until the site is first hit.
+typedef struct {
+    Clox_Function* function;
+    uint8_t* entry;
+    int arity;
+    uint32_t max_stack_height;
+    #ifdef CLOX_DEBUG_CALL_CACHE_STATS
+    uint64_t hits;
+    uint64_t misses;
+    #endif // CLOX_DEBUG_CALL_CACHE_STATS
+} Clox_Call_Cache;
+
+#define CLOX_MAX_CALL_CACHES (UINT16_MAX + 1)
+
 struct Clox_Function {
     Clox_Object obj;
     int arity;
     int upvalue_count;
     Clox_Chunk chunk;
     Clox_String* name;
+    uint32_t max_stack_height; // NOTE(Al-Andrew): in slots, counted from the callee slot. set by the verifier
+    bool verified;
+    uint32_t call_cache_count;
+    Clox_Call_Cache* call_caches;
+    bool has_captured_locals; // NOTE(Al-Andrew): set by the compiler, frames of functions without it never close upvalues
+    Clox_Closure* canonical_closure; // NOTE(Al-Andrew): the one closure shared by every OP_CLOSURE of a function with no upvalues
+    char const* lazy_source; // NOTE(Al-Andrew): where the parameter list starts while the body waits for its first call, `clox -L`
+    int lazy_line;
 };
 
 
 Clox_Function* Clox_Function_Create_Empty(Clox_VM* vm);
+void Clox_Function_Allocate_Call_Caches(Clox_Function* function);
 
 
 typedef struct Clox_UpvalueObj Clox_UpvalueObj;
 struct Clox_UpvalueObj {
     Clox_Object obj;
     Clox_Value* location;
-    Clox_UpvalueObj* next;
     Clox_Value closed;
 };
 
 Clox_UpvalueObj* Clox_UpvalueObj_Create(Clox_VM* vm, Clox_Value* slot);
 
-typedef struct {
+// NOTE(Al-Andrew): which member is live is decided by the CLOX_CAPTURE_FLAG_BY_VALUE flag the compiler gave the
+//                  capture in OP_CLOSURE, and the verifier checks every upvalue opcode against it.
+typedef union {
+    Clox_UpvalueObj* upvalue;
+    Clox_Value value;
+} Clox_Closure_Upvalue;
+
+struct Clox_Closure {
     Clox_Object obj;
     Clox_Function* function;
     int upvalue_count;
-    Clox_UpvalueObj* upvalues[];
-} Clox_Closure;
+    Clox_Closure_Upvalue upvalues[];
+};
 
 Clox_Closure* Clox_Closure_Create(Clox_VM* vm, Clox_Function* function);
 Clox_UpvalueObj* Clox_Closure_Capture_Upvalue(Clox_VM* vm, Clox_Value* value);
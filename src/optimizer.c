@@ -0,0 +1,924 @@
+#include "optimizer.h"
+#include "common.h"
+#include "chunk.h"
+#include "memory.h"
+#include <string.h>
+
+#define CLOX_OPTIMIZER_NONE UINT32_MAX
+#define CLOX_OPTIMIZER_MAX_ROUNDS 4
+
+// NOTE(Al-Andrew): per stack slot lattice used to propagate constants between blocks. values >= 0 index known_constants.
+#define CLOX_OPTIMIZER_UNREACHED -2
+#define CLOX_OPTIMIZER_VARYING   -1
+
+typedef struct {
+    Clox_Op_Code opcode;      // NOTE(Al-Andrew): generic opcode, passes rewrite it in place
+    uint32_t offset;          // of the original instruction, its operands are read from there unless `rewritten`
+    uint32_t length;
+    uint32_t line;
+    uint32_t target;          // instruction a jump lands on
+    uint32_t block;
+    uint8_t operand;          // operand of a rewritten OP_CONSTANT, OP_SMALL_INT or OP_GET_LOCAL
+    bool rewritten;
+    bool removed;
+} Clox_IR_Instruction;
+
+typedef struct {
+    uint32_t first;
+    uint32_t end;
+    int32_t entry_depth;
+    int32_t* entry_state;     // NOTE(Al-Andrew): lattice value per stack slot on entry, entry_depth of them
+    bool queued;
+} Clox_IR_Block;
+
+typedef enum {
+    CLOX_IR_VALUE_OPAQUE,
+    CLOX_IR_VALUE_CONSTANT,
+    CLOX_IR_VALUE_EXPRESSION,
+} Clox_IR_Value_Kind;
+
+// NOTE(Al-Andrew): value numbers are local to a block. two stack entries with the same value number hold the same
+//                  value, constants get one per distinct constant and expressions one per (opcode, operands).
+typedef struct {
+    Clox_IR_Value_Kind kind;
+    Clox_Op_Code opcode;
+    uint32_t lhs;             // NOTE(Al-Andrew): the known_constants index for CLOX_IR_VALUE_CONSTANT
+    uint32_t rhs;
+} Clox_IR_Value;
+
+typedef struct {
+    uint32_t value;
+    uint32_t start;           // NOTE(Al-Andrew): first and last instruction computing it, NONE if it came from a predecessor
+    uint32_t end;
+    bool has_effects;         // NOTE(Al-Andrew): computing it stores, calls or defines something
+    bool may_trap;            // NOTE(Al-Andrew): computing it can raise a runtime error
+} Clox_IR_Stack_Entry;
+
+typedef struct {
+    Clox_Function* function;
+    Clox_Chunk* chunk;
+
+    Clox_IR_Instruction* instructions;
+    uint32_t instruction_count;
+    Clox_IR_Block* blocks;
+    uint32_t block_count;
+    uint32_t* worklist;
+    uint32_t worklist_used;
+
+    bool captured[UINT8_MAX + 1]; // NOTE(Al-Andrew): slots some closure captures, their value can change behind our back
+    Clox_Value_Array known_constants;
+    Clox_Value_Index_Map known_constant_map;
+    Clox_Value_Index_Map chunk_constant_map; // NOTE(Al-Andrew): over chunk->constants, for Rewrite_To_Constant
+
+    Clox_IR_Value* values;
+    uint32_t value_count;
+    uint32_t value_capacity;
+    uint32_t* value_table;        // NOTE(Al-Andrew): open addressing, value numbers of constants and expressions
+    uint32_t value_table_capacity;
+
+    Clox_IR_Stack_Entry* stack;
+    uint32_t depth;
+    uint32_t stack_capacity;
+} Clox_Optimizer;
+
+static uint32_t Clox_Optimizer_Known_Constant(Clox_Optimizer* optimizer, Clox_Value value) {
+    uint32_t* slot = Clox_Value_Index_Map_Slot(&optimizer->known_constant_map, &optimizer->known_constants, value);
+    if (*slot == 0) {
+        Clox_Value_Array_Push_Back(&optimizer->known_constants, value);
+        *slot = optimizer->known_constants.used;
+    }
+    return *slot - 1;
+}
+
+// NOTE(Al-Andrew): folding has to give exactly what the VM would compute, see the matching handlers in vm.c.
+//                  returns false for anything that would trap or that we don't want to evaluate at compile time.
+static bool Clox_Optimizer_Fold_Binary(Clox_Op_Code opcode, Clox_Value lhs, Clox_Value rhs, Clox_Value* result) {
+    bool numbers = CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs);
+    bool integers = CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs);
+    int64_t integer;
+    switch (opcode) {
+        case OP_ADD: {
+            if (!numbers) return false;
+            if (integers && !Clox_Value_Add_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &integer)) {
+                *result = CLOX_VALUE_INTEGER(integer);
+            } else {
+                *result = CLOX_VALUE_NUMBER(CLOX_VALUE_AS_NUMBER(lhs) + CLOX_VALUE_AS_NUMBER(rhs));
+            }
+        } break;
+        case OP_SUB: {
+            if (!numbers) return false;
+            if (integers && !Clox_Value_Sub_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &integer)) {
+                *result = CLOX_VALUE_INTEGER(integer);
+            } else {
+                *result = CLOX_VALUE_NUMBER(CLOX_VALUE_AS_NUMBER(lhs) - CLOX_VALUE_AS_NUMBER(rhs));
+            }
+        } break;
+        case OP_MUL: {
+            if (!numbers) return false;
+            if (integers && !Clox_Value_Mul_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &integer)) {
+                *result = CLOX_VALUE_INTEGER(integer);
+            } else {
+                *result = CLOX_VALUE_NUMBER(CLOX_VALUE_AS_NUMBER(lhs) * CLOX_VALUE_AS_NUMBER(rhs));
+            }
+        } break;
+        case OP_DIV: {
+            if (!numbers) return false;
+            if (integers && !Clox_Value_Div_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &integer)) {
+                *result = CLOX_VALUE_INTEGER(integer);
+            } else {
+                *result = CLOX_VALUE_NUMBER(CLOX_VALUE_AS_NUMBER(lhs) / CLOX_VALUE_AS_NUMBER(rhs));
+            }
+        } break;
+        case OP_GREATER: {
+            if (!numbers) return false;
+            *result = CLOX_VALUE_BOOL(integers ? CLOX_VALUE_AS_INTEGER(lhs) > CLOX_VALUE_AS_INTEGER(rhs)
+                                               : CLOX_VALUE_AS_NUMBER(lhs) > CLOX_VALUE_AS_NUMBER(rhs));
+        } break;
+        case OP_LESS: {
+            if (!numbers) return false;
+            *result = CLOX_VALUE_BOOL(integers ? CLOX_VALUE_AS_INTEGER(lhs) < CLOX_VALUE_AS_INTEGER(rhs)
+                                               : CLOX_VALUE_AS_NUMBER(lhs) < CLOX_VALUE_AS_NUMBER(rhs));
+        } break;
+        case OP_GREATER_EQUAL: {
+            if (!numbers) return false;
+            *result = CLOX_VALUE_BOOL(integers ? CLOX_VALUE_AS_INTEGER(lhs) >= CLOX_VALUE_AS_INTEGER(rhs)
+                                               : CLOX_VALUE_AS_NUMBER(lhs) >= CLOX_VALUE_AS_NUMBER(rhs));
+        } break;
+        case OP_LESS_EQUAL: {
+            if (!numbers) return false;
+            *result = CLOX_VALUE_BOOL(integers ? CLOX_VALUE_AS_INTEGER(lhs) <= CLOX_VALUE_AS_INTEGER(rhs)
+                                               : CLOX_VALUE_AS_NUMBER(lhs) <= CLOX_VALUE_AS_NUMBER(rhs));
+        } break;
+        case OP_NOT_EQUAL: {
+            if (!Clox_Optimizer_Fold_Binary(OP_EQUAL, lhs, rhs, result)) return false;
+            *result = CLOX_VALUE_BOOL(!CLOX_VALUE_AS_BOOL(*result));
+        } break;
+        case OP_EQUAL: {
+            if (numbers) {
+                *result = CLOX_VALUE_BOOL(integers ? CLOX_VALUE_AS_INTEGER(lhs) == CLOX_VALUE_AS_INTEGER(rhs)
+                                                   : CLOX_VALUE_AS_NUMBER(lhs) == CLOX_VALUE_AS_NUMBER(rhs));
+            } else if (CLOX_VALUE_IS_OBJECT(lhs) || CLOX_VALUE_IS_OBJECT(rhs)) {
+                return false;
+            } else if (CLOX_VALUE_TYPE_OF(lhs) != CLOX_VALUE_TYPE_OF(rhs)) {
+                *result = CLOX_VALUE_BOOL(false);
+            } else {
+                *result = CLOX_VALUE_BOOL(CLOX_VALUE_IS_BOOL(lhs) ? CLOX_VALUE_AS_BOOL(lhs) == CLOX_VALUE_AS_BOOL(rhs) : true);
+            }
+        } break;
+        default: {
+            return false;
+        } break;
+    }
+    return true;
+}
+
+static bool Clox_Optimizer_Fold_Unary(Clox_Op_Code opcode, Clox_Value operand, Clox_Value* result) {
+    switch (opcode) {
+        case OP_ARITHMETIC_NEGATION: {
+            int64_t integer;
+            if (CLOX_VALUE_IS_INTEGER(operand) && !Clox_Value_Negate_Overflows(CLOX_VALUE_AS_INTEGER(operand), &integer)) {
+                *result = CLOX_VALUE_INTEGER(integer);
+            } else if (CLOX_VALUE_IS_NUMBER(operand)) {
+                *result = CLOX_VALUE_NUMBER(-CLOX_VALUE_AS_NUMBER(operand));
+            } else {
+                return false;
+            }
+        } break;
+        case OP_BOOLEAN_NEGATION: {
+            // NOTE(Al-Andrew): the VM only negates nil and booleans, anything else is a runtime error
+            if (CLOX_VALUE_IS_NIL(operand)) {
+                *result = CLOX_VALUE_BOOL(true);
+            } else if (CLOX_VALUE_IS_BOOL(operand)) {
+                *result = CLOX_VALUE_BOOL(!CLOX_VALUE_AS_BOOL(operand));
+            } else {
+                return false;
+            }
+        } break;
+        default: {
+            return false;
+        } break;
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// NOTE(Al-Andrew): value numbering
+
+static uint32_t Clox_Optimizer_Value_Hash(Clox_IR_Value const* value) {
+    uint32_t hash = 2166136261u;
+    hash = (hash ^ (uint32_t)value->kind) * 16777619u;
+    hash = (hash ^ (uint32_t)value->opcode) * 16777619u;
+    hash = (hash ^ value->lhs) * 16777619u;
+    hash = (hash ^ value->rhs) * 16777619u;
+    return hash;
+}
+
+static uint32_t Clox_Optimizer_Add_Value(Clox_Optimizer* optimizer, Clox_IR_Value value) {
+    if (optimizer->value_count == optimizer->value_capacity) {
+        uint32_t old_capacity = optimizer->value_capacity;
+        optimizer->value_capacity = old_capacity == 0 ? 64 : old_capacity * 2;
+        optimizer->values = reallocate(optimizer->values, sizeof(Clox_IR_Value) * old_capacity, sizeof(Clox_IR_Value) * optimizer->value_capacity); // TODO(Al-Andrew, AllocFailure): handle
+    }
+    optimizer->values[optimizer->value_count] = value;
+    return optimizer->value_count++;
+}
+
+static void Clox_Optimizer_Reset_Values(Clox_Optimizer* optimizer) {
+    optimizer->value_count = 0;
+    for (uint32_t i = 0; i < optimizer->value_table_capacity; ++i) {
+        optimizer->value_table[i] = CLOX_OPTIMIZER_NONE;
+    }
+}
+
+static void Clox_Optimizer_Grow_Value_Table(Clox_Optimizer* optimizer) {
+    uint32_t old_capacity = optimizer->value_table_capacity;
+    uint32_t* old_table = optimizer->value_table;
+    optimizer->value_table_capacity = old_capacity == 0 ? 128 : old_capacity * 2;
+    optimizer->value_table = reallocate(NULL, 0, sizeof(uint32_t) * optimizer->value_table_capacity); // TODO(Al-Andrew, AllocFailure): handle
+    for (uint32_t i = 0; i < optimizer->value_table_capacity; ++i) {
+        optimizer->value_table[i] = CLOX_OPTIMIZER_NONE;
+    }
+    for (uint32_t i = 0; i < old_capacity; ++i) {
+        if (old_table[i] == CLOX_OPTIMIZER_NONE) continue;
+        uint32_t mask = optimizer->value_table_capacity - 1;
+        uint32_t slot = Clox_Optimizer_Value_Hash(&optimizer->values[old_table[i]]) & mask;
+        while (optimizer->value_table[slot] != CLOX_OPTIMIZER_NONE) {
+            slot = (slot + 1) & mask;
+        }
+        optimizer->value_table[slot] = old_table[i];
+    }
+    if (old_table != NULL) {
+        deallocate(old_table);
+    }
+}
+
+// NOTE(Al-Andrew): the value number of `value`, a new one if it wasn't seen in this block yet. `is_new` is optional.
+static uint32_t Clox_Optimizer_Number_Value(Clox_Optimizer* optimizer, Clox_IR_Value value, bool* is_new) {
+    if (optimizer->value_count * 2 >= optimizer->value_table_capacity) {
+        Clox_Optimizer_Grow_Value_Table(optimizer);
+    }
+    uint32_t mask = optimizer->value_table_capacity - 1;
+    uint32_t slot = Clox_Optimizer_Value_Hash(&value) & mask;
+    while (optimizer->value_table[slot] != CLOX_OPTIMIZER_NONE) {
+        Clox_IR_Value const* known = &optimizer->values[optimizer->value_table[slot]];
+        if (known->kind == value.kind && known->opcode == value.opcode && known->lhs == value.lhs && known->rhs == value.rhs) {
+            if (is_new != NULL) *is_new = false;
+            return optimizer->value_table[slot];
+        }
+        slot = (slot + 1) & mask;
+    }
+    uint32_t number = Clox_Optimizer_Add_Value(optimizer, value);
+    optimizer->value_table[slot] = number;
+    if (is_new != NULL) *is_new = true;
+    return number;
+}
+
+static uint32_t Clox_Optimizer_Opaque_Value(Clox_Optimizer* optimizer) {
+    return Clox_Optimizer_Add_Value(optimizer, (Clox_IR_Value){.kind = CLOX_IR_VALUE_OPAQUE});
+}
+
+static uint32_t Clox_Optimizer_Constant_Value(Clox_Optimizer* optimizer, Clox_Value constant) {
+    Clox_IR_Value value = {.kind = CLOX_IR_VALUE_CONSTANT, .lhs = Clox_Optimizer_Known_Constant(optimizer, constant)};
+    return Clox_Optimizer_Number_Value(optimizer, value, NULL);
+}
+
+static bool Clox_Optimizer_Is_Constant(Clox_Optimizer* optimizer, uint32_t value, Clox_Value* constant) {
+    if (optimizer->values[value].kind != CLOX_IR_VALUE_CONSTANT) {
+        return false;
+    }
+    if (constant != NULL) {
+        *constant = optimizer->known_constants.values[optimizer->values[value].lhs];
+    }
+    return true;
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// NOTE(Al-Andrew): lifting the chunk into instructions and basic blocks
+
+static bool Clox_Optimizer_Is_Jump(Clox_Op_Code opcode) {
+    return opcode == OP_JUMP || opcode == OP_JUMP_IF_FALSE || opcode == OP_LOOP || Clox_Op_Code_Is_Compare_And_Branch(opcode);
+}
+
+static bool Clox_Optimizer_Ends_Block(Clox_Op_Code opcode) {
+    return Clox_Optimizer_Is_Jump(opcode) || opcode == OP_RETURN;
+}
+
+static void Clox_Optimizer_Lift(Clox_Optimizer* optimizer) {
+    Clox_Chunk* chunk = optimizer->chunk;
+    uint32_t* instruction_at = reallocate(NULL, 0, sizeof(uint32_t) * chunk->used); // TODO(Al-Andrew, AllocFailure): handle
+    optimizer->instructions = reallocate(NULL, 0, sizeof(Clox_IR_Instruction) * chunk->used); // TODO(Al-Andrew, AllocFailure): handle
+    optimizer->instruction_count = 0;
+
+    for (uint32_t offset = 0; offset < chunk->used;) {
+        uint32_t length = Clox_Chunk_Instruction_Length(chunk, offset);
+        instruction_at[offset] = optimizer->instruction_count;
+        optimizer->instructions[optimizer->instruction_count++] = (Clox_IR_Instruction){
+            .opcode = (Clox_Op_Code)chunk->code[offset],
+            .offset = offset,
+            .length = length,
+            .line = chunk->source_lines[offset],
+            .target = CLOX_OPTIMIZER_NONE,
+        };
+        offset += length;
+    }
+
+    bool* is_leader = reallocate(NULL, 0, sizeof(bool) * (optimizer->instruction_count + 1)); // TODO(Al-Andrew, AllocFailure): handle
+    memset(is_leader, 0, sizeof(bool) * (optimizer->instruction_count + 1));
+    is_leader[0] = true;
+    memset(optimizer->captured, 0, sizeof(optimizer->captured));
+    for (uint32_t i = 0; i < optimizer->instruction_count; ++i) {
+        Clox_IR_Instruction* instruction = &optimizer->instructions[i];
+        uint8_t const* operands = &chunk->code[instruction->offset + 1];
+        if (Clox_Optimizer_Is_Jump(instruction->opcode)) {
+            uint16_t jump = (uint16_t)((operands[0] << 8) | operands[1]);
+            uint32_t next = instruction->offset + 3;
+            instruction->target = instruction_at[instruction->opcode == OP_LOOP ? next - jump : next + jump];
+            is_leader[instruction->target] = true;
+        }
+        if (Clox_Optimizer_Ends_Block(instruction->opcode)) {
+            is_leader[i + 1] = true;
+        }
+        if (instruction->opcode == OP_CLOSURE || instruction->opcode == OP_CLOSURE_LONG) {
+            for (uint32_t capture = instruction->opcode == OP_CLOSURE ? 2 : 3; capture < instruction->length; capture += 2) {
+                if (operands[capture - 1] & CLOX_CAPTURE_FLAG_LOCAL) {
+                    optimizer->captured[operands[capture]] = true;
+                }
+            }
+        }
+    }
+
+    optimizer->block_count = 0;
+    for (uint32_t i = 0; i < optimizer->instruction_count; ++i) {
+        optimizer->block_count += is_leader[i];
+    }
+    optimizer->blocks = reallocate(NULL, 0, sizeof(Clox_IR_Block) * optimizer->block_count); // TODO(Al-Andrew, AllocFailure): handle
+    optimizer->worklist = reallocate(NULL, 0, sizeof(uint32_t) * optimizer->block_count); // TODO(Al-Andrew, AllocFailure): handle
+    optimizer->worklist_used = 0;
+    uint32_t block = CLOX_OPTIMIZER_NONE;
+    for (uint32_t i = 0; i < optimizer->instruction_count; ++i) {
+        if (is_leader[i]) {
+            block += 1;
+            optimizer->blocks[block] = (Clox_IR_Block){.first = i, .entry_depth = -1};
+        }
+        optimizer->blocks[block].end = i + 1;
+        optimizer->instructions[i].block = block;
+    }
+
+    deallocate(is_leader);
+    deallocate(instruction_at);
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// NOTE(Al-Andrew): abstract interpretation of one block over value numbers. The same walk computes the constants
+//                  flowing out of a block while the dataflow runs and rewrites the block once it has converged.
+
+static void Clox_Optimizer_Push(Clox_Optimizer* optimizer, Clox_IR_Stack_Entry entry) {
+    if (optimizer->depth == optimizer->stack_capacity) {
+        uint32_t old_capacity = optimizer->stack_capacity;
+        optimizer->stack_capacity = old_capacity == 0 ? 64 : old_capacity * 2;
+        optimizer->stack = reallocate(optimizer->stack, sizeof(Clox_IR_Stack_Entry) * old_capacity, sizeof(Clox_IR_Stack_Entry) * optimizer->stack_capacity); // TODO(Al-Andrew, AllocFailure): handle
+    }
+    optimizer->stack[optimizer->depth++] = entry;
+}
+
+static Clox_IR_Stack_Entry Clox_Optimizer_Pop(Clox_Optimizer* optimizer) {
+    CLOX_DEV_ASSERT(optimizer->depth > 0);
+    return optimizer->stack[--optimizer->depth];
+}
+
+// NOTE(Al-Andrew): true if nothing but removed instructions sits between `after` and `before`, i.e. `before` consumes
+//                  whatever `after` left on the stack right away.
+static bool Clox_Optimizer_Adjacent(Clox_Optimizer* optimizer, uint32_t after, uint32_t before) {
+    for (uint32_t i = after + 1; i < before; ++i) {
+        if (!optimizer->instructions[i].removed) return false;
+    }
+    return true;
+}
+
+static void Clox_Optimizer_Remove_Range(Clox_Optimizer* optimizer, uint32_t first, uint32_t last) {
+    for (uint32_t i = first; i <= last; ++i) {
+        optimizer->instructions[i].removed = true;
+    }
+}
+
+// NOTE(Al-Andrew): the entries `count` deep at the top of the stack, computed right before `consumer` and removable
+//                  as a whole: they came from this block, follow each other and have no side effects.
+static bool Clox_Optimizer_Can_Replace_Operands(Clox_Optimizer* optimizer, uint32_t count, uint32_t consumer) {
+    uint32_t next = consumer;
+    for (uint32_t i = 0; i < count; ++i) {
+        Clox_IR_Stack_Entry const* entry = &optimizer->stack[optimizer->depth - 1 - i];
+        if (entry->start == CLOX_OPTIMIZER_NONE || entry->has_effects || !Clox_Optimizer_Adjacent(optimizer, entry->end, next)) {
+            return false;
+        }
+        next = entry->start;
+    }
+    return true;
+}
+
+// NOTE(Al-Andrew): pushes a constant with OP_NIL/OP_TRUE/OP_FALSE/OP_SMALL_INT/OP_CONSTANT, false if the chunk ran out of
+//                  constant slots. never OP_CONSTANT_LONG, the lowered code must not grow.
+static bool Clox_Optimizer_Rewrite_To_Constant(Clox_Optimizer* optimizer, uint32_t index, Clox_Value constant) {
+    Clox_IR_Instruction* instruction = &optimizer->instructions[index];
+    int8_t small;
+    if (CLOX_VALUE_IS_NIL(constant)) {
+        instruction->opcode = OP_NIL;
+    } else if (CLOX_VALUE_IS_BOOL(constant)) {
+        instruction->opcode = CLOX_VALUE_AS_BOOL(constant) ? OP_TRUE : OP_FALSE;
+    } else if (Clox_Value_Is_Small_Integer(constant, &small)) {
+        instruction->opcode = OP_SMALL_INT;
+        instruction->operand = (uint8_t)small;
+    } else {
+        Clox_Value_Array* constants = &optimizer->chunk->constants;
+        uint32_t* slot = Clox_Value_Index_Map_Slot(&optimizer->chunk_constant_map, constants, constant);
+        uint32_t found = *slot != 0 ? *slot - 1 : constants->used;
+        if (found > UINT8_MAX) {
+            return false;
+        }
+        if (*slot == 0) {
+            *slot = Clox_Chunk_Push_Constant(optimizer->chunk, constant) + 1;
+        }
+        instruction->opcode = OP_CONSTANT;
+        instruction->operand = (uint8_t)found;
+    }
+    instruction->rewritten = true;
+    return true;
+}
+
+// NOTE(Al-Andrew): a non captured slot below `limit` that already holds `value`, or NONE.
+static uint32_t Clox_Optimizer_Find_Slot(Clox_Optimizer* optimizer, uint32_t value, uint32_t limit) {
+    if (limit > UINT8_MAX + 1) limit = UINT8_MAX + 1;
+    for (uint32_t slot = 0; slot < limit; ++slot) {
+        if (!optimizer->captured[slot] && optimizer->stack[slot].value == value) {
+            return slot;
+        }
+    }
+    return CLOX_OPTIMIZER_NONE;
+}
+
+static void Clox_Optimizer_Enter_Block(Clox_Optimizer* optimizer, Clox_IR_Block const* block) {
+    Clox_Optimizer_Reset_Values(optimizer);
+    optimizer->depth = 0;
+    for (int32_t slot = 0; slot < block->entry_depth; ++slot) {
+        int32_t state = block->entry_state[slot];
+        uint32_t value = (state >= 0 && !optimizer->captured[slot])
+            ? Clox_Optimizer_Constant_Value(optimizer, optimizer->known_constants.values[state])
+            : Clox_Optimizer_Opaque_Value(optimizer);
+        Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = value, .start = CLOX_OPTIMIZER_NONE, .end = CLOX_OPTIMIZER_NONE});
+    }
+}
+
+static void Clox_Optimizer_Flow_To(Clox_Optimizer* optimizer, uint32_t block_index) {
+    Clox_IR_Block* block = &optimizer->blocks[block_index];
+    bool changed = false;
+    if (block->entry_depth < 0) {
+        block->entry_depth = (int32_t)optimizer->depth;
+        block->entry_state = reallocate(NULL, 0, sizeof(int32_t) * (optimizer->depth + 1)); // TODO(Al-Andrew, AllocFailure): handle
+        for (uint32_t slot = 0; slot < optimizer->depth; ++slot) {
+            block->entry_state[slot] = CLOX_OPTIMIZER_UNREACHED;
+        }
+        changed = true;
+    }
+    CLOX_DEV_ASSERT(block->entry_depth == (int32_t)optimizer->depth);
+
+    for (uint32_t slot = 0; slot < optimizer->depth; ++slot) {
+        Clox_Value constant;
+        int32_t incoming = (!optimizer->captured[slot] && Clox_Optimizer_Is_Constant(optimizer, optimizer->stack[slot].value, &constant))
+            ? (int32_t)Clox_Optimizer_Known_Constant(optimizer, constant)
+            : CLOX_OPTIMIZER_VARYING;
+        int32_t* state = &block->entry_state[slot];
+        int32_t met = (*state == CLOX_OPTIMIZER_UNREACHED || *state == incoming) ? incoming : CLOX_OPTIMIZER_VARYING;
+        if (met != *state) {
+            *state = met;
+            changed = true;
+        }
+    }
+
+    if (changed && !block->queued) {
+        block->queued = true;
+        optimizer->worklist[optimizer->worklist_used++] = block_index;
+    }
+}
+
+static void Clox_Optimizer_Run_Block(Clox_Optimizer* optimizer, uint32_t block_index, bool transform) {
+    Clox_IR_Block const* block = &optimizer->blocks[block_index];
+    Clox_Chunk const* chunk = optimizer->chunk;
+    Clox_Optimizer_Enter_Block(optimizer, block);
+
+    uint32_t pending_pop = CLOX_OPTIMIZER_NONE;       // NOTE(Al-Andrew): the OP_POP right before this instruction, if any
+    Clox_IR_Stack_Entry popped = {0};
+
+    for (uint32_t index = block->first; index < block->end; ++index) {
+        Clox_IR_Instruction* instruction = &optimizer->instructions[index];
+        if (instruction->removed) {
+            continue;
+        }
+        uint8_t const* operands = &chunk->code[instruction->offset + 1];
+        uint32_t last_pop = pending_pop;
+        pending_pop = CLOX_OPTIMIZER_NONE;
+
+        switch (instruction->opcode) {
+            case OP_CONSTANT: {
+                Clox_Value constant = chunk->constants.values[instruction->rewritten ? instruction->operand : operands[0]];
+                uint32_t value = Clox_Optimizer_Constant_Value(optimizer, constant);
+                Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = value, .start = index, .end = index});
+            } break;
+            case OP_CONSTANT_LONG: {
+                Clox_Value constant = chunk->constants.values[(operands[0] << 8) | operands[1]];
+                uint32_t value = Clox_Optimizer_Constant_Value(optimizer, constant);
+                Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = value, .start = index, .end = index});
+            } break;
+            case OP_SMALL_INT: {
+                int8_t immediate = (int8_t)(instruction->rewritten ? instruction->operand : operands[0]);
+                uint32_t value = Clox_Optimizer_Constant_Value(optimizer, CLOX_VALUE_INTEGER(immediate));
+                Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = value, .start = index, .end = index});
+            } break;
+            case OP_NIL: /* fallthrough */
+            case OP_TRUE: /* fallthrough */
+            case OP_FALSE: {
+                Clox_Value constant = instruction->opcode == OP_NIL ? CLOX_VALUE_NIL : CLOX_VALUE_BOOL(instruction->opcode == OP_TRUE);
+                uint32_t value = Clox_Optimizer_Constant_Value(optimizer, constant);
+                Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = value, .start = index, .end = index});
+            } break;
+            case OP_GET_LOCAL: {
+                uint8_t slot = instruction->rewritten ? instruction->operand : operands[0];
+                if (optimizer->captured[slot]) {
+                    Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = Clox_Optimizer_Opaque_Value(optimizer), .start = index, .end = index});
+                    break;
+                }
+                uint32_t value = optimizer->stack[slot].value;
+                // NOTE(Al-Andrew): `x = e; x` compiles to SET_LOCAL x, POP, GET_LOCAL x. the value we just popped is
+                //                  the one we would load, so keep it on the stack instead.
+                if (transform && last_pop != CLOX_OPTIMIZER_NONE && popped.value == value) {
+                    optimizer->instructions[last_pop].removed = true;
+                    instruction->removed = true;
+                    Clox_Optimizer_Push(optimizer, popped);
+                    break;
+                }
+                Clox_Value constant;
+                if (transform && Clox_Optimizer_Is_Constant(optimizer, value, &constant)) {
+                    Clox_Optimizer_Rewrite_To_Constant(optimizer, index, constant);
+                }
+                Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = value, .start = index, .end = index});
+            } break;
+            case OP_SET_LOCAL: {
+                uint8_t slot = operands[0];
+                Clox_IR_Stack_Entry* top = &optimizer->stack[optimizer->depth - 1];
+                if (optimizer->captured[slot]) {
+                    optimizer->stack[slot].value = Clox_Optimizer_Opaque_Value(optimizer);
+                } else if (transform && optimizer->stack[slot].value == top->value) {
+                    instruction->removed = true; // NOTE(Al-Andrew): the slot already holds it
+                    break;
+                } else {
+                    optimizer->stack[slot].value = top->value;
+                }
+                top->end = index;
+                top->has_effects = true;
+            } break;
+            case OP_GET_UPVALUE: {
+                Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = Clox_Optimizer_Opaque_Value(optimizer), .start = index, .end = index});
+            } break;
+            case OP_GET_FLAT_UPVALUE: {
+                // NOTE(Al-Andrew): captured by value, it can't change for the lifetime of the closure
+                Clox_IR_Value key = {.kind = CLOX_IR_VALUE_EXPRESSION, .opcode = OP_GET_FLAT_UPVALUE, .lhs = operands[0], .rhs = CLOX_OPTIMIZER_NONE};
+                uint32_t value = Clox_Optimizer_Number_Value(optimizer, key, NULL);
+                Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = value, .start = index, .end = index});
+            } break;
+            case OP_SET_UPVALUE: /* fallthrough */
+            case OP_SET_GLOBAL: {
+                Clox_IR_Stack_Entry* top = &optimizer->stack[optimizer->depth - 1];
+                top->end = index;
+                top->has_effects = true;
+                top->may_trap = top->may_trap || instruction->opcode == OP_SET_GLOBAL;
+            } break;
+            case OP_GET_GLOBAL: {
+                Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = Clox_Optimizer_Opaque_Value(optimizer), .start = index, .end = index, .may_trap = true});
+            } break;
+            case OP_DEFINE_GLOBAL: /* fallthrough */
+            case OP_PRINT: /* fallthrough */
+            case OP_CLOSE_UPVALUE: {
+                Clox_Optimizer_Pop(optimizer);
+            } break;
+            case OP_POP: {
+                Clox_IR_Stack_Entry entry = Clox_Optimizer_Pop(optimizer);
+                // NOTE(Al-Andrew): a value nobody looks at, drop the code computing it if that code can't be observed
+                if (transform && entry.start != CLOX_OPTIMIZER_NONE && !entry.has_effects && !entry.may_trap &&
+                    Clox_Optimizer_Adjacent(optimizer, entry.end, index)) {
+                    Clox_Optimizer_Remove_Range(optimizer, entry.start, index);
+                    break;
+                }
+                pending_pop = index;
+                popped = entry;
+            } break;
+            case OP_ARITHMETIC_NEGATION: /* fallthrough */
+            case OP_BOOLEAN_NEGATION: {
+                Clox_IR_Stack_Entry operand = optimizer->stack[optimizer->depth - 1];
+                Clox_IR_Stack_Entry result = {.start = operand.start, .end = index, .has_effects = operand.has_effects, .may_trap = true};
+                Clox_Value constant, folded;
+                if (Clox_Optimizer_Is_Constant(optimizer, operand.value, &constant) && Clox_Optimizer_Fold_Unary(instruction->opcode, constant, &folded)) {
+                    result.value = Clox_Optimizer_Constant_Value(optimizer, folded);
+                    result.may_trap = operand.may_trap;
+                    if (transform && Clox_Optimizer_Can_Replace_Operands(optimizer, 1, index) && Clox_Optimizer_Rewrite_To_Constant(optimizer, index, folded)) {
+                        Clox_Optimizer_Remove_Range(optimizer, operand.start, index - 1);
+                        result = (Clox_IR_Stack_Entry){.value = result.value, .start = index, .end = index};
+                    }
+                } else {
+                    bool is_new = true;
+                    Clox_IR_Value key = {.kind = CLOX_IR_VALUE_EXPRESSION, .opcode = instruction->opcode, .lhs = operand.value, .rhs = CLOX_OPTIMIZER_NONE};
+                    result.value = Clox_Optimizer_Number_Value(optimizer, key, &is_new);
+                    uint32_t slot = is_new ? CLOX_OPTIMIZER_NONE : Clox_Optimizer_Find_Slot(optimizer, result.value, optimizer->depth - 1);
+                    if (transform && slot != CLOX_OPTIMIZER_NONE && Clox_Optimizer_Can_Replace_Operands(optimizer, 1, index)) {
+                        Clox_Optimizer_Remove_Range(optimizer, operand.start, index - 1);
+                        instruction->opcode = OP_GET_LOCAL;
+                        instruction->operand = (uint8_t)slot;
+                        instruction->rewritten = true;
+                        result = (Clox_IR_Stack_Entry){.value = result.value, .start = index, .end = index};
+                    }
+                }
+                optimizer->stack[optimizer->depth - 1] = result;
+            } break;
+            case OP_ADD: /* fallthrough */
+            case OP_SUB: /* fallthrough */
+            case OP_MUL: /* fallthrough */
+            case OP_DIV: /* fallthrough */
+            case OP_EQUAL: /* fallthrough */
+            case OP_GREATER: /* fallthrough */
+            case OP_LESS: /* fallthrough */
+            case OP_NOT_EQUAL: /* fallthrough */
+            case OP_GREATER_EQUAL: /* fallthrough */
+            case OP_LESS_EQUAL: {
+                Clox_IR_Stack_Entry rhs = optimizer->stack[optimizer->depth - 1];
+                Clox_IR_Stack_Entry lhs = optimizer->stack[optimizer->depth - 2];
+                Clox_IR_Stack_Entry result = {.start = lhs.start, .end = index, .has_effects = lhs.has_effects || rhs.has_effects, .may_trap = true};
+                Clox_Value lhs_constant, rhs_constant, folded;
+                if (Clox_Optimizer_Is_Constant(optimizer, lhs.value, &lhs_constant) && Clox_Optimizer_Is_Constant(optimizer, rhs.value, &rhs_constant) &&
+                    Clox_Optimizer_Fold_Binary(instruction->opcode, lhs_constant, rhs_constant, &folded)) {
+                    result.value = Clox_Optimizer_Constant_Value(optimizer, folded);
+                    result.may_trap = lhs.may_trap || rhs.may_trap;
+                    if (transform && Clox_Optimizer_Can_Replace_Operands(optimizer, 2, index) && Clox_Optimizer_Rewrite_To_Constant(optimizer, index, folded)) {
+                        Clox_Optimizer_Remove_Range(optimizer, lhs.start, index - 1);
+                        result = (Clox_IR_Stack_Entry){.value = result.value, .start = index, .end = index};
+                    }
+                } else {
+                    bool is_new = true;
+                    Clox_IR_Value key = {.kind = CLOX_IR_VALUE_EXPRESSION, .opcode = instruction->opcode, .lhs = lhs.value, .rhs = rhs.value};
+                    result.value = Clox_Optimizer_Number_Value(optimizer, key, &is_new);
+                    // NOTE(Al-Andrew): computed before and still sitting in a slot below us, that earlier computation
+                    //                  succeeded on the same operands so loading it can't skip a runtime error.
+                    uint32_t slot = is_new ? CLOX_OPTIMIZER_NONE : Clox_Optimizer_Find_Slot(optimizer, result.value, optimizer->depth - 2);
+                    if (transform && slot != CLOX_OPTIMIZER_NONE && Clox_Optimizer_Can_Replace_Operands(optimizer, 2, index)) {
+                        Clox_Optimizer_Remove_Range(optimizer, lhs.start, index - 1);
+                        instruction->opcode = OP_GET_LOCAL;
+                        instruction->operand = (uint8_t)slot;
+                        instruction->rewritten = true;
+                        result = (Clox_IR_Stack_Entry){.value = result.value, .start = index, .end = index};
+                    }
+                }
+                optimizer->depth -= 1;
+                optimizer->stack[optimizer->depth - 1] = result;
+            } break;
+            case OP_CALL: /* fallthrough */
+            case OP_TAIL_CALL: {
+                optimizer->depth -= operands[0] + 1;
+                Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = Clox_Optimizer_Opaque_Value(optimizer), .start = CLOX_OPTIMIZER_NONE, .end = index, .has_effects = true, .may_trap = true});
+            } break;
+            case OP_CLOSURE: /* fallthrough */
+            case OP_CLOSURE_LONG: {
+                Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = Clox_Optimizer_Opaque_Value(optimizer), .start = index, .end = index, .has_effects = true});
+            } break;
+            case OP_JUMP: /* fallthrough */
+            case OP_LOOP: {
+                if (!transform) {
+                    Clox_Optimizer_Flow_To(optimizer, optimizer->instructions[instruction->target].block);
+                }
+                return;
+            } break;
+            case OP_JUMP_IF_FALSE: {
+                Clox_Value condition;
+                bool known = Clox_Optimizer_Is_Constant(optimizer, optimizer->stack[optimizer->depth - 1].value, &condition);
+                bool falsy = known && Clox_Value_Is_Falsy(condition);
+                if (transform && known) {
+                    // NOTE(Al-Andrew): the condition stays on the stack either way, both targets pop it
+                    if (falsy) {
+                        instruction->opcode = OP_JUMP;
+                    } else {
+                        instruction->removed = true;
+                    }
+                }
+                if (!transform && (!known || falsy)) {
+                    Clox_Optimizer_Flow_To(optimizer, optimizer->instructions[instruction->target].block);
+                }
+                if (known && falsy) {
+                    return;
+                }
+            } break;
+            case OP_JUMP_IF_NOT_EQUAL: /* fallthrough */
+            case OP_JUMP_IF_EQUAL: /* fallthrough */
+            case OP_JUMP_IF_NOT_GREATER: /* fallthrough */
+            case OP_JUMP_IF_NOT_GREATER_EQUAL: /* fallthrough */
+            case OP_JUMP_IF_NOT_LESS: /* fallthrough */
+            case OP_JUMP_IF_NOT_LESS_EQUAL: {
+                // NOTE(Al-Andrew): the dataflow always follows both edges. a branch on constants only turns into a
+                //                  jump (or nothing) when its operands can go with it, which the dataflow can't tell
+                //                  up front. the edge that is left dead gets cleaned up by the next round.
+                Clox_IR_Stack_Entry rhs = optimizer->stack[optimizer->depth - 1];
+                Clox_IR_Stack_Entry lhs = optimizer->stack[optimizer->depth - 2];
+                Clox_Value lhs_constant, rhs_constant, comparison;
+                if (transform && Clox_Optimizer_Is_Constant(optimizer, lhs.value, &lhs_constant) && Clox_Optimizer_Is_Constant(optimizer, rhs.value, &rhs_constant) &&
+                    Clox_Optimizer_Fold_Binary(Clox_Op_Code_Branch_Comparison(instruction->opcode), lhs_constant, rhs_constant, &comparison) &&
+                    !lhs.may_trap && !rhs.may_trap && Clox_Optimizer_Can_Replace_Operands(optimizer, 2, index)) {
+                    Clox_Optimizer_Remove_Range(optimizer, lhs.start, index - 1);
+                    if (Clox_Value_Is_Falsy(comparison)) {
+                        instruction->opcode = OP_JUMP;
+                    } else {
+                        instruction->removed = true;
+                    }
+                }
+                optimizer->depth -= 2;
+                if (!transform) {
+                    Clox_Optimizer_Flow_To(optimizer, optimizer->instructions[instruction->target].block);
+                }
+            } break;
+            case OP_RETURN: {
+                return;
+            } break;
+            default: {
+                CLOX_UNREACHABLE();
+            } break;
+        }
+    }
+
+    if (!transform && block_index + 1 < optimizer->block_count) {
+        Clox_Optimizer_Flow_To(optimizer, block_index + 1);
+    }
+}
+
+// --------------------------------------------------------------------------------------------------------------------
+// NOTE(Al-Andrew): lowering back into the chunk
+
+static uint32_t Clox_Optimizer_Lowered_Length(Clox_IR_Instruction const* instruction) {
+    if (!instruction->rewritten) {
+        return instruction->length;
+    }
+    return 1 + Clox_Op_Code_Operand_Length(instruction->opcode);
+}
+
+// NOTE(Al-Andrew): new offset of every instruction, removed ones get the offset of the next one that stays.
+//                  returns the size of the lowered code.
+static uint32_t Clox_Optimizer_Layout(Clox_Optimizer* optimizer, uint32_t* new_offset) {
+    uint32_t size = 0;
+    for (uint32_t i = 0; i < optimizer->instruction_count; ++i) {
+        new_offset[i] = size;
+        if (!optimizer->instructions[i].removed) {
+            size += Clox_Optimizer_Lowered_Length(&optimizer->instructions[i]);
+        }
+    }
+    new_offset[optimizer->instruction_count] = size;
+    return size;
+}
+
+static void Clox_Optimizer_Lower(Clox_Optimizer* optimizer) {
+    Clox_Chunk* chunk = optimizer->chunk;
+    uint32_t* new_offset = reallocate(NULL, 0, sizeof(uint32_t) * (optimizer->instruction_count + 1)); // TODO(Al-Andrew, AllocFailure): handle
+
+    // NOTE(Al-Andrew): a jump onto the instruction right after it does nothing once the code between is gone.
+    //                  dropping one can make another one fall into the same pattern, so repeat until none is left.
+    uint32_t size = Clox_Optimizer_Layout(optimizer, new_offset);
+    for (bool dropped = true; dropped;) {
+        dropped = false;
+        for (uint32_t i = 0; i < optimizer->instruction_count; ++i) {
+            Clox_IR_Instruction* instruction = &optimizer->instructions[i];
+            if (instruction->removed || (instruction->opcode != OP_JUMP && instruction->opcode != OP_JUMP_IF_FALSE)) continue;
+            if (new_offset[instruction->target] == new_offset[i] + 3) {
+                instruction->removed = true;
+                dropped = true;
+            }
+        }
+        if (dropped) {
+            size = Clox_Optimizer_Layout(optimizer, new_offset);
+        }
+    }
+
+    uint8_t* code = reallocate(NULL, 0, size + 1); // TODO(Al-Andrew, AllocFailure): handle
+    uint32_t* lines = reallocate(NULL, 0, sizeof(uint32_t) * (size + 1)); // TODO(Al-Andrew, AllocFailure): handle
+    for (uint32_t i = 0; i < optimizer->instruction_count; ++i) {
+        Clox_IR_Instruction const* instruction = &optimizer->instructions[i];
+        if (instruction->removed) continue;
+
+        uint32_t at = new_offset[i];
+        uint32_t length = Clox_Optimizer_Lowered_Length(instruction);
+        if (Clox_Optimizer_Is_Jump(instruction->opcode)) {
+            uint32_t next = at + 3;
+            uint32_t target = new_offset[instruction->target];
+            uint16_t jump = (uint16_t)(instruction->opcode == OP_LOOP ? next - target : target - next);
+            code[at] = instruction->opcode;
+            code[at + 1] = (jump >> 8) & 0xff;
+            code[at + 2] = jump & 0xff;
+        } else if (instruction->rewritten) {
+            code[at] = instruction->opcode;
+            if (length == 2) {
+                code[at + 1] = instruction->operand;
+            }
+        } else {
+            memcpy(&code[at], &chunk->code[instruction->offset], length);
+        }
+        for (uint32_t byte = 0; byte < length; ++byte) {
+            lines[at + byte] = instruction->line;
+        }
+    }
+
+    CLOX_DEV_ASSERT(size <= chunk->used);
+    memcpy(chunk->code, code, size);
+    memcpy(chunk->source_lines, lines, sizeof(uint32_t) * size);
+    if (chunk->inline_site_count > 0) {
+        uint32_t* moved_to = reallocate(NULL, 0, sizeof(uint32_t) * (chunk->used + 1)); // TODO(Al-Andrew, AllocFailure): handle
+        for (uint32_t i = 0; i < optimizer->instruction_count; ++i) {
+            uint32_t end = i + 1 < optimizer->instruction_count ? optimizer->instructions[i + 1].offset : chunk->used;
+            for (uint32_t offset = optimizer->instructions[i].offset; offset < end; ++offset) {
+                moved_to[offset] = offset == optimizer->instructions[i].offset ? new_offset[i] : new_offset[i + 1];
+            }
+        }
+        moved_to[chunk->used] = size;
+        Clox_Chunk_Move_Inline_Sites(chunk, moved_to);
+        deallocate(moved_to);
+    }
+    chunk->used = size;
+
+    deallocate(lines);
+    deallocate(code);
+    deallocate(new_offset);
+}
+
+static void Clox_Optimizer_Release_Round(Clox_Optimizer* optimizer) {
+    for (uint32_t i = 0; i < optimizer->block_count; ++i) {
+        if (optimizer->blocks[i].entry_state != NULL) {
+            deallocate(optimizer->blocks[i].entry_state);
+        }
+    }
+    deallocate(optimizer->blocks);
+    deallocate(optimizer->worklist);
+    deallocate(optimizer->instructions);
+    optimizer->blocks = NULL;
+    optimizer->worklist = NULL;
+    optimizer->instructions = NULL;
+}
+
+static void Clox_Optimizer_Round(Clox_Optimizer* optimizer) {
+    Clox_Optimizer_Lift(optimizer);
+
+    // NOTE(Al-Andrew): slot 0 and the parameters are unknown on entry
+    optimizer->depth = 0;
+    for (int32_t slot = 0; slot <= optimizer->function->arity; ++slot) {
+        Clox_Optimizer_Push(optimizer, (Clox_IR_Stack_Entry){.value = Clox_Optimizer_Opaque_Value(optimizer)});
+    }
+    Clox_Optimizer_Flow_To(optimizer, 0);
+    while (optimizer->worklist_used > 0) {
+        uint32_t block = optimizer->worklist[--optimizer->worklist_used];
+        optimizer->blocks[block].queued = false;
+        Clox_Optimizer_Run_Block(optimizer, block, false);
+    }
+
+    for (uint32_t block = 0; block < optimizer->block_count; ++block) {
+        if (optimizer->blocks[block].entry_depth < 0) {
+            // NOTE(Al-Andrew): unreachable
+            for (uint32_t i = optimizer->blocks[block].first; i < optimizer->blocks[block].end; ++i) {
+                optimizer->instructions[i].removed = true;
+            }
+            continue;
+        }
+        Clox_Optimizer_Run_Block(optimizer, block, true);
+    }
+
+    Clox_Optimizer_Lower(optimizer);
+    Clox_Optimizer_Release_Round(optimizer);
+}
+
+void Clox_Optimizer_Optimize_Function(Clox_Function* function) {
+    CLOX_DEV_ASSERT(function != NULL);
+    // NOTE(Al-Andrew): like the peephole pass this only knows byte slots and short jumps
+    if (Clox_Chunk_Has_Wide_Operands(&function->chunk)) {
+        return;
+    }
+
+    Clox_Optimizer optimizer = {
+        .function = function,
+        .chunk = &function->chunk,
+        .known_constants = Clox_Value_Array_New_Empty(),
+    };
+
+    // NOTE(Al-Andrew): a round can expose more work for the next one, e.g. a branch folded to a jump turns into
+    //                  straight-line code once its dead arm is gone.
+    for (uint32_t round = 0; round < CLOX_OPTIMIZER_MAX_ROUNDS && function->chunk.used > 0; ++round) {
+        uint32_t size_before = function->chunk.used;
+        Clox_Optimizer_Round(&optimizer);
+        if (function->chunk.used == size_before) {
+            break;
+        }
+    }
+
+    Clox_Value_Array_Delete(&optimizer.known_constants);
+    Clox_Value_Index_Map_Delete(&optimizer.known_constant_map);
+    Clox_Value_Index_Map_Delete(&optimizer.chunk_constant_map);
+    if (optimizer.values != NULL) deallocate(optimizer.values);
+    if (optimizer.value_table != NULL) deallocate(optimizer.value_table);
+    if (optimizer.stack != NULL) deallocate(optimizer.stack);
+}
@@ -0,0 +1,12 @@
+#ifndef CLOX_OPTIMIZER_H_INCLUDED
+#define CLOX_OPTIMIZER_H_INCLUDED
+
+#include "object.h"
+
+// NOTE(Al-Andrew): optional middle-end, the compiler runs it on every function it finishes when Clox_VM.optimize is
+//                  set (`clox -O`). Lifts the chunk into basic blocks, value numbers the stack and the locals, then
+//                  folds and propagates constants, drops dead code, reuses values that are already sitting in a
+//                  stack slot and removes redundant local loads and stores before lowering back into the same chunk.
+void Clox_Optimizer_Optimize_Function(Clox_Function* function);
+
+#endif // CLOX_OPTIMIZER_H_INCLUDED
@@ -0,0 +1,431 @@
+#include "peephole.h"
+#include "common.h"
+#include "memory.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CLOX_SUPERINSTRUCTION_MAX_LENGTH 5
+
+typedef struct {
+    Clox_Op_Code fused;
+    uint32_t sequence_length;
+    Clox_Op_Code sequence[CLOX_SUPERINSTRUCTION_MAX_LENGTH];
+} Clox_Superinstruction;
+
+// NOTE(Al-Andrew): longest sequences first, the first match wins.
+static const Clox_Superinstruction s_clox_superinstructions[] = {
+    {OP_GET_LOCAL_CONSTANT_JUMP_IF_NOT_LESS,       3, {OP_GET_LOCAL, OP_CONSTANT, OP_JUMP_IF_NOT_LESS}},
+    {OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS,      3, {OP_GET_LOCAL, OP_SMALL_INT, OP_JUMP_IF_NOT_LESS}},
+    {OP_GET_LOCAL_GET_LOCAL_ADD,                   3, {OP_GET_LOCAL, OP_GET_LOCAL, OP_ADD}},
+    {OP_GET_LOCAL_CONSTANT_ADD,                    3, {OP_GET_LOCAL, OP_CONSTANT, OP_ADD}},
+    {OP_GET_LOCAL_SMALL_INT_ADD,                   3, {OP_GET_LOCAL, OP_SMALL_INT, OP_ADD}},
+    {OP_GET_LOCAL_GET_LOCAL,                       2, {OP_GET_LOCAL, OP_GET_LOCAL}},
+    {OP_GET_LOCAL_CONSTANT,                        2, {OP_GET_LOCAL, OP_CONSTANT}},
+    {OP_GET_LOCAL_SMALL_INT,                       2, {OP_GET_LOCAL, OP_SMALL_INT}},
+    {OP_SET_LOCAL_POP,                             2, {OP_SET_LOCAL, OP_POP}},
+    {OP_SET_GLOBAL_POP,                            2, {OP_SET_GLOBAL, OP_POP}},
+    {OP_JUMP_IF_FALSE_POP,                         2, {OP_JUMP_IF_FALSE, OP_POP}},
+    {OP_POP_LOOP,                                  2, {OP_POP, OP_LOOP}},
+};
+
+#define static_array_count$(arr) sizeof(arr)/sizeof(arr[0])
+
+uint32_t Clox_Peephole_Superinstruction_Sequence(Clox_Op_Code const fused, Clox_Op_Code const** sequence) {
+    for (uint32_t i = 0; i < static_array_count$(s_clox_superinstructions); ++i) {
+        if (s_clox_superinstructions[i].fused == fused) {
+            *sequence = s_clox_superinstructions[i].sequence;
+            return s_clox_superinstructions[i].sequence_length;
+        }
+    }
+    return 0;
+}
+
+static bool Clox_Peephole_Is_Jump(Clox_Op_Code opcode) {
+    return opcode == OP_JUMP || opcode == OP_JUMP_IF_FALSE || opcode == OP_LOOP || Clox_Op_Code_Is_Compare_And_Branch(opcode);
+}
+
+static void Clox_Peephole_Mark_Jump_Targets(Clox_Chunk* const chunk, bool* is_jump_target) {
+    for (uint32_t offset = 0; offset < chunk->used; offset += Clox_Chunk_Instruction_Length(chunk, offset)) {
+        Clox_Op_Code opcode = chunk->code[offset];
+        if (opcode == OP_JUMP_LONG || opcode == OP_JUMP_IF_FALSE_LONG || opcode == OP_LOOP_LONG) {
+            uint32_t jump = Clox_Chunk_Read_Long_Operand(&chunk->code[offset + 1]);
+            uint32_t target = (opcode == OP_LOOP_LONG) ? (offset + 5 - jump) : (offset + 5 + jump);
+            if (target < chunk->used) {
+                is_jump_target[target] = true;
+            }
+            continue;
+        }
+        if (!Clox_Peephole_Is_Jump(opcode)) {
+            continue;
+        }
+
+        uint16_t jump = (uint16_t)((chunk->code[offset + 1] << 8) | chunk->code[offset + 2]);
+        uint32_t target = (opcode == OP_LOOP) ? (offset + 3 - jump) : (offset + 3 + jump);
+        if (target < chunk->used) {
+            is_jump_target[target] = true;
+        }
+    }
+}
+
+// NOTE(Al-Andrew): returns the length in bytes of the matched sequence or 0.
+//                  a sequence never matches across a jump target, so every jump still lands on the first byte of an instruction.
+static uint32_t Clox_Peephole_Match(Clox_Chunk* const chunk, bool const* is_jump_target, uint32_t offset, Clox_Superinstruction const* superinstruction) {
+    uint32_t start = offset;
+    for (uint32_t i = 0; i < superinstruction->sequence_length; ++i) {
+        if (offset >= chunk->used || chunk->code[offset] != superinstruction->sequence[i]) {
+            return 0;
+        }
+        if (offset != start && is_jump_target[offset]) {
+            return 0;
+        }
+        offset += Clox_Chunk_Instruction_Length(chunk, offset);
+    }
+    return offset - start;
+}
+
+void Clox_Peephole_Fuse_Superinstructions(Clox_Chunk* const chunk) {
+    CLOX_DEV_ASSERT(chunk != NULL);
+    if (chunk->used == 0) {
+        return;
+    }
+
+    bool* is_jump_target = reallocate(NULL, 0, sizeof(bool) * chunk->used);
+    memset(is_jump_target, 0, sizeof(bool) * chunk->used);
+    Clox_Peephole_Mark_Jump_Targets(chunk, is_jump_target);
+
+    uint32_t offset = 0;
+    while (offset < chunk->used) {
+        uint32_t matched_length = 0;
+        for (uint32_t i = 0; i < static_array_count$(s_clox_superinstructions); ++i) {
+            matched_length = Clox_Peephole_Match(chunk, is_jump_target, offset, &s_clox_superinstructions[i]);
+            if (matched_length != 0) {
+                chunk->code[offset] = s_clox_superinstructions[i].fused;
+                break;
+            }
+        }
+
+        offset += (matched_length != 0) ? matched_length : Clox_Chunk_Instruction_Length(chunk, offset);
+    }
+
+    deallocate(is_jump_target);
+}
+
+#define CLOX_PEEPHOLE_NONE UINT32_MAX
+#define CLOX_PEEPHOLE_MAX_ROUNDS 4
+
+typedef struct {
+    uint32_t offset;
+    uint32_t length;        // NOTE(Al-Andrew): length once lowered
+    uint32_t line;
+    uint32_t target;        // NOTE(Al-Andrew): instruction a jump lands on
+    Clox_Op_Code opcode;
+    bool returns_nil;       // NOTE(Al-Andrew): a jump replaced by the `OP_NIL, OP_RETURN` it used to land on
+    bool removed;
+} Clox_Peephole_Instruction;
+
+typedef struct {
+    Clox_Chunk* chunk;
+    Clox_Peephole_Instruction* instructions;
+    uint32_t count;
+    bool* is_jump_target;
+    uint32_t* worklist;
+} Clox_Peephole;
+
+static void Clox_Peephole_Decode(Clox_Peephole* peephole) {
+    Clox_Chunk* chunk = peephole->chunk;
+    uint32_t* instruction_at = reallocate(NULL, 0, sizeof(uint32_t) * (chunk->used + 1)); // TODO(Al-Andrew, AllocFailure): handle
+    peephole->instructions = reallocate(NULL, 0, sizeof(Clox_Peephole_Instruction) * chunk->used); // TODO(Al-Andrew, AllocFailure): handle
+    peephole->count = 0;
+    for (uint32_t offset = 0; offset < chunk->used;) {
+        uint32_t length = Clox_Chunk_Instruction_Length(chunk, offset);
+        instruction_at[offset] = peephole->count;
+        peephole->instructions[peephole->count++] = (Clox_Peephole_Instruction){
+            .offset = offset,
+            .length = length,
+            .line = chunk->source_lines[offset],
+            .target = CLOX_PEEPHOLE_NONE,
+            .opcode = (Clox_Op_Code)chunk->code[offset],
+        };
+        offset += length;
+    }
+    instruction_at[chunk->used] = peephole->count;
+
+    for (uint32_t i = 0; i < peephole->count; ++i) {
+        Clox_Peephole_Instruction* instruction = &peephole->instructions[i];
+        if (!Clox_Peephole_Is_Jump(instruction->opcode)) continue;
+        uint16_t jump = (uint16_t)((chunk->code[instruction->offset + 1] << 8) | chunk->code[instruction->offset + 2]);
+        uint32_t next = instruction->offset + 3;
+        instruction->target = instruction_at[instruction->opcode == OP_LOOP ? next - jump : next + jump];
+    }
+
+    peephole->is_jump_target = reallocate(NULL, 0, sizeof(bool) * (peephole->count + 1)); // TODO(Al-Andrew, AllocFailure): handle
+    peephole->worklist = reallocate(NULL, 0, sizeof(uint32_t) * (peephole->count + 1)); // TODO(Al-Andrew, AllocFailure): handle
+    deallocate(instruction_at);
+}
+
+// NOTE(Al-Andrew): `index` itself if it stays, else the next instruction that does. `count` past the end.
+static uint32_t Clox_Peephole_Live(Clox_Peephole const* peephole, uint32_t index) {
+    while (index < peephole->count && peephole->instructions[index].removed) {
+        index += 1;
+    }
+    return index;
+}
+
+static uint32_t Clox_Peephole_Next(Clox_Peephole const* peephole, uint32_t index) {
+    return Clox_Peephole_Live(peephole, index + 1);
+}
+
+static Clox_Op_Code Clox_Peephole_Opcode_At(Clox_Peephole const* peephole, uint32_t index) {
+    return index < peephole->count ? peephole->instructions[index].opcode : OP_RETURN;
+}
+
+// NOTE(Al-Andrew): where control really ends up after landing on `index`, following unconditional jumps. with
+//                  `through_conditional` also following OP_JUMP_IF_FALSE, for a jump that only happens on a false
+//                  condition that is still on the stack. bounded so `for (;;) {}` can't hang us.
+static uint32_t Clox_Peephole_Resolve(Clox_Peephole const* peephole, uint32_t index, bool through_conditional) {
+    index = Clox_Peephole_Live(peephole, index);
+    for (uint32_t hops = 0; hops < peephole->count && index < peephole->count; ++hops) {
+        Clox_Peephole_Instruction const* instruction = &peephole->instructions[index];
+        bool follows = instruction->opcode == OP_JUMP || instruction->opcode == OP_LOOP || (through_conditional && instruction->opcode == OP_JUMP_IF_FALSE);
+        if (!follows) break;
+        index = Clox_Peephole_Live(peephole, instruction->target);
+    }
+    return index;
+}
+
+static void Clox_Peephole_Thread_Jumps(Clox_Peephole* peephole) {
+    for (uint32_t i = 0; i < peephole->count; ++i) {
+        Clox_Peephole_Instruction* instruction = &peephole->instructions[i];
+        if (instruction->removed || !Clox_Peephole_Is_Jump(instruction->opcode)) continue;
+
+        if (instruction->opcode == OP_JUMP_IF_FALSE || Clox_Op_Code_Is_Compare_And_Branch(instruction->opcode)) {
+            // NOTE(Al-Andrew): only OP_JUMP_IF_FALSE leaves the condition behind for another one to test
+            uint32_t target = Clox_Peephole_Resolve(peephole, instruction->target, instruction->opcode == OP_JUMP_IF_FALSE);
+            if (target > i && target < peephole->count) { // NOTE(Al-Andrew): it can only jump forward
+                instruction->target = target;
+            }
+            continue;
+        }
+
+        uint32_t target = Clox_Peephole_Resolve(peephole, instruction->target, false);
+        if (target >= peephole->count) continue;
+        instruction->target = target;
+        instruction->opcode = target > i ? OP_JUMP : OP_LOOP;
+
+        // NOTE(Al-Andrew): a jump onto a return is the return, a jump onto the implicit `nil` return is those two bytes
+        if (peephole->instructions[target].opcode == OP_RETURN) {
+            *instruction = (Clox_Peephole_Instruction){.offset = instruction->offset, .length = 1 + peephole->instructions[target].returns_nil,
+                .line = instruction->line, .target = CLOX_PEEPHOLE_NONE, .opcode = OP_RETURN, .returns_nil = peephole->instructions[target].returns_nil};
+        } else if (peephole->instructions[target].opcode == OP_NIL && Clox_Peephole_Opcode_At(peephole, Clox_Peephole_Next(peephole, target)) == OP_RETURN &&
+                   !peephole->instructions[Clox_Peephole_Next(peephole, target)].returns_nil) {
+            *instruction = (Clox_Peephole_Instruction){.offset = instruction->offset, .length = 2,
+                .line = instruction->line, .target = CLOX_PEEPHOLE_NONE, .opcode = OP_RETURN, .returns_nil = true};
+        }
+    }
+}
+
+// NOTE(Al-Andrew): `if (c) {}` and friends: both arms pop the condition and meet again, so the branch does nothing
+static void Clox_Peephole_Drop_Empty_Branches(Clox_Peephole* peephole) {
+    for (uint32_t i = 0; i < peephole->count; ++i) {
+        Clox_Peephole_Instruction* instruction = &peephole->instructions[i];
+        if (instruction->removed || instruction->opcode != OP_JUMP_IF_FALSE) continue;
+
+        uint32_t taken = Clox_Peephole_Live(peephole, instruction->target);
+        uint32_t fallthrough = Clox_Peephole_Next(peephole, i);
+        if (Clox_Peephole_Opcode_At(peephole, taken) != OP_POP || Clox_Peephole_Opcode_At(peephole, fallthrough) != OP_POP) continue;
+        if (taken >= peephole->count || fallthrough >= peephole->count) continue;
+        if (Clox_Peephole_Resolve(peephole, Clox_Peephole_Next(peephole, taken), false) == Clox_Peephole_Resolve(peephole, Clox_Peephole_Next(peephole, fallthrough), false)) {
+            instruction->removed = true;
+        }
+    }
+}
+
+static void Clox_Peephole_Mark_Live_Jump_Targets(Clox_Peephole* peephole) {
+    memset(peephole->is_jump_target, 0, sizeof(bool) * (peephole->count + 1));
+    for (uint32_t i = 0; i < peephole->count; ++i) {
+        Clox_Peephole_Instruction const* instruction = &peephole->instructions[i];
+        if (instruction->removed || !Clox_Peephole_Is_Jump(instruction->opcode)) continue;
+        peephole->is_jump_target[Clox_Peephole_Live(peephole, instruction->target)] = true;
+    }
+}
+
+// NOTE(Al-Andrew): a value that is pushed without side effects and popped right away
+static void Clox_Peephole_Drop_Unused_Pushes(Clox_Peephole* peephole) {
+    Clox_Peephole_Mark_Live_Jump_Targets(peephole);
+    for (uint32_t i = 0; i < peephole->count; ++i) {
+        Clox_Peephole_Instruction* instruction = &peephole->instructions[i];
+        if (instruction->removed) continue;
+        switch (instruction->opcode) {
+            case OP_CONSTANT: /* fallthrough */
+            case OP_CONSTANT_LONG: /* fallthrough */
+            case OP_SMALL_INT: /* fallthrough */
+            case OP_NIL: /* fallthrough */
+            case OP_TRUE: /* fallthrough */
+            case OP_FALSE: /* fallthrough */
+            case OP_GET_LOCAL: /* fallthrough */
+            case OP_GET_UPVALUE: /* fallthrough */
+            case OP_GET_FLAT_UPVALUE: {
+                uint32_t next = Clox_Peephole_Next(peephole, i);
+                if (Clox_Peephole_Opcode_At(peephole, next) == OP_POP && next < peephole->count && !peephole->is_jump_target[next]) {
+                    instruction->removed = true;
+                    peephole->instructions[next].removed = true;
+                }
+            } break;
+            default: break;
+        }
+    }
+}
+
+static void Clox_Peephole_Drop_Unreachable(Clox_Peephole* peephole) {
+    bool* reached = peephole->is_jump_target; // NOTE(Al-Andrew): reused, the jump targets are recomputed when needed
+    memset(reached, 0, sizeof(bool) * (peephole->count + 1));
+    uint32_t worklist_used = 0;
+
+    uint32_t entry = Clox_Peephole_Live(peephole, 0);
+    if (entry < peephole->count) {
+        reached[entry] = true;
+        peephole->worklist[worklist_used++] = entry;
+    }
+    while (worklist_used > 0) {
+        uint32_t index = peephole->worklist[--worklist_used];
+        Clox_Peephole_Instruction const* instruction = &peephole->instructions[index];
+        uint32_t successors[2];
+        uint32_t successor_count = 0;
+        if (instruction->opcode != OP_JUMP && instruction->opcode != OP_LOOP && instruction->opcode != OP_RETURN) {
+            successors[successor_count++] = Clox_Peephole_Next(peephole, index);
+        }
+        if (Clox_Peephole_Is_Jump(instruction->opcode)) {
+            successors[successor_count++] = Clox_Peephole_Live(peephole, instruction->target);
+        }
+        for (uint32_t i = 0; i < successor_count; ++i) {
+            if (successors[i] >= peephole->count || reached[successors[i]]) continue;
+            reached[successors[i]] = true;
+            peephole->worklist[worklist_used++] = successors[i];
+        }
+    }
+
+    for (uint32_t i = 0; i < peephole->count; ++i) {
+        if (!reached[i]) {
+            peephole->instructions[i].removed = true;
+        }
+    }
+}
+
+// NOTE(Al-Andrew): new offset of every instruction, removed ones get the offset of the next one that stays.
+static uint32_t Clox_Peephole_Layout(Clox_Peephole const* peephole, uint32_t* new_offset) {
+    uint32_t size = 0;
+    for (uint32_t i = 0; i < peephole->count; ++i) {
+        new_offset[i] = size;
+        if (!peephole->instructions[i].removed) {
+            size += peephole->instructions[i].length;
+        }
+    }
+    new_offset[peephole->count] = size;
+    return size;
+}
+
+static void Clox_Peephole_Compact(Clox_Peephole* peephole) {
+    Clox_Chunk* chunk = peephole->chunk;
+    uint32_t* new_offset = reallocate(NULL, 0, sizeof(uint32_t) * (peephole->count + 1)); // TODO(Al-Andrew, AllocFailure): handle
+
+    // NOTE(Al-Andrew): a jump onto the instruction right after it does nothing, dropping one can make another one
+    //                  fall into the same pattern so repeat until none is left.
+    uint32_t size = Clox_Peephole_Layout(peephole, new_offset);
+    for (bool dropped = true; dropped;) {
+        dropped = false;
+        for (uint32_t i = 0; i < peephole->count; ++i) {
+            Clox_Peephole_Instruction* instruction = &peephole->instructions[i];
+            if (instruction->removed || (instruction->opcode != OP_JUMP && instruction->opcode != OP_JUMP_IF_FALSE)) continue;
+            if (new_offset[instruction->target] == new_offset[i] + 3) {
+                instruction->removed = true;
+                dropped = true;
+            }
+        }
+        if (dropped) {
+            size = Clox_Peephole_Layout(peephole, new_offset);
+        }
+    }
+
+    uint8_t* code = reallocate(NULL, 0, size + 1); // TODO(Al-Andrew, AllocFailure): handle
+    uint32_t* lines = reallocate(NULL, 0, sizeof(uint32_t) * (size + 1)); // TODO(Al-Andrew, AllocFailure): handle
+    for (uint32_t i = 0; i < peephole->count; ++i) {
+        Clox_Peephole_Instruction const* instruction = &peephole->instructions[i];
+        if (instruction->removed) continue;
+
+        uint32_t at = new_offset[i];
+        if (Clox_Peephole_Is_Jump(instruction->opcode)) {
+            uint32_t next = at + 3;
+            uint32_t target = new_offset[instruction->target];
+            uint16_t jump = (uint16_t)(instruction->opcode == OP_LOOP ? next - target : target - next);
+            code[at] = instruction->opcode;
+            code[at + 1] = (jump >> 8) & 0xff;
+            code[at + 2] = jump & 0xff;
+        } else if (instruction->opcode == OP_RETURN) {
+            if (instruction->returns_nil) {
+                code[at++] = OP_NIL;
+            }
+            code[at] = OP_RETURN;
+        } else {
+            memcpy(&code[at], &chunk->code[instruction->offset], instruction->length);
+        }
+        for (uint32_t byte = 0; byte < instruction->length; ++byte) {
+            lines[new_offset[i] + byte] = instruction->line;
+        }
+    }
+
+    CLOX_DEV_ASSERT(size <= chunk->used);
+    memcpy(chunk->code, code, size);
+    memcpy(chunk->source_lines, lines, sizeof(uint32_t) * size);
+    if (chunk->inline_site_count > 0) {
+        uint32_t* moved_to = reallocate(NULL, 0, sizeof(uint32_t) * (chunk->used + 1)); // TODO(Al-Andrew, AllocFailure): handle
+        for (uint32_t i = 0; i < peephole->count; ++i) {
+            uint32_t end = i + 1 < peephole->count ? peephole->instructions[i + 1].offset : chunk->used;
+            for (uint32_t offset = peephole->instructions[i].offset; offset < end; ++offset) {
+                moved_to[offset] = offset == peephole->instructions[i].offset ? new_offset[i] : new_offset[i + 1];
+            }
+        }
+        moved_to[chunk->used] = size;
+        Clox_Chunk_Move_Inline_Sites(chunk, moved_to);
+        deallocate(moved_to);
+    }
+    chunk->used = size;
+
+    deallocate(lines);
+    deallocate(code);
+    deallocate(new_offset);
+}
+
+void Clox_Peephole_Optimize(Clox_Chunk* const chunk, char const* const name) {
+    CLOX_DEV_ASSERT(chunk != NULL);
+    (void)name;
+    // NOTE(Al-Andrew): the pass only knows the short encodings, the huge functions that need wide ones go without
+    if (Clox_Chunk_Has_Wide_Operands(chunk)) {
+        return;
+    }
+
+    uint32_t size_before = chunk->used;
+    for (uint32_t round = 0; round < CLOX_PEEPHOLE_MAX_ROUNDS && chunk->used > 0; ++round) {
+        uint32_t round_size = chunk->used;
+        Clox_Peephole peephole = {.chunk = chunk};
+        Clox_Peephole_Decode(&peephole);
+
+        Clox_Peephole_Thread_Jumps(&peephole);
+        Clox_Peephole_Drop_Empty_Branches(&peephole);
+        Clox_Peephole_Drop_Unused_Pushes(&peephole);
+        Clox_Peephole_Drop_Unreachable(&peephole);
+        Clox_Peephole_Compact(&peephole);
+
+        deallocate(peephole.worklist);
+        deallocate(peephole.is_jump_target);
+        deallocate(peephole.instructions);
+        if (chunk->used == round_size) {
+            break;
+        }
+    }
+
+    #ifdef CLOX_DEBUG_PEEPHOLE_STATS
+    fprintf(stderr, "peephole %-24s %6u -> %6u bytes (-%u)\n", name, size_before, chunk->used, size_before - chunk->used);
+    #else
+    (void)size_before;
+    #endif // CLOX_DEBUG_PEEPHOLE_STATS
+}
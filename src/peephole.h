@@ -0,0 +1,17 @@
+#ifndef CLOX_PEEPHOLE_H_INCLUDED
+#define CLOX_PEEPHOLE_H_INCLUDED
+
+#include "chunk.h"
+
+// #define CLOX_DEBUG_PEEPHOLE_STATS
+
+void Clox_Peephole_Fuse_Superinstructions(Clox_Chunk* const chunk);
+// NOTE(Al-Andrew): the opcodes `fused` was made from, first one included. 0 if `fused` is not a superinstruction
+uint32_t Clox_Peephole_Superinstruction_Sequence(Clox_Op_Code const fused, Clox_Op_Code const** sequence);
+
+// NOTE(Al-Andrew): rewrites the obvious waste a single-pass compiler leaves behind (jumps to jumps, branches whose
+//                  arms do the same thing, pushes that are popped right away, code nothing can reach) and compacts
+//                  the chunk, fixing up every jump and source_lines. `name` is only used by the stats dump.
+void Clox_Peephole_Optimize(Clox_Chunk* const chunk, char const* const name);
+
+#endif // CLOX_PEEPHOLE_H_INCLUDED
\ No newline at end of file
@@ -1,12 +1,256 @@
 #include "scanner.h"
+#include "source.h"
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    #define CLOX_SCANNER_X86_SIMD
+    #include <immintrin.h>
+#endif // __GNUC__ && __x86_64__
+
+#define CLOX_CHAR_DIGIT 0x1
+#define CLOX_CHAR_ALPHA 0x2 // NOTE(Al-Andrew): letters and `_`
+#define CLOX_CHAR_SPACE 0x4 // NOTE(Al-Andrew): not `\n`, that one also counts a line
+
+// NOTE(Al-Andrew): one load per character instead of a chain of range checks, everything past ASCII is 0
+static const uint8_t s_clox_char_class[UINT8_MAX + 1] = {
+    [' '] = CLOX_CHAR_SPACE, ['\t'] = CLOX_CHAR_SPACE, ['\r'] = CLOX_CHAR_SPACE,
+    ['0'] = CLOX_CHAR_DIGIT, ['1'] = CLOX_CHAR_DIGIT, ['2'] = CLOX_CHAR_DIGIT, ['3'] = CLOX_CHAR_DIGIT, ['4'] = CLOX_CHAR_DIGIT,
+    ['5'] = CLOX_CHAR_DIGIT, ['6'] = CLOX_CHAR_DIGIT, ['7'] = CLOX_CHAR_DIGIT, ['8'] = CLOX_CHAR_DIGIT, ['9'] = CLOX_CHAR_DIGIT,
+    ['a'] = CLOX_CHAR_ALPHA, ['b'] = CLOX_CHAR_ALPHA, ['c'] = CLOX_CHAR_ALPHA, ['d'] = CLOX_CHAR_ALPHA, ['e'] = CLOX_CHAR_ALPHA, ['f'] = CLOX_CHAR_ALPHA, ['g'] = CLOX_CHAR_ALPHA, ['h'] = CLOX_CHAR_ALPHA,
+    ['i'] = CLOX_CHAR_ALPHA, ['j'] = CLOX_CHAR_ALPHA, ['k'] = CLOX_CHAR_ALPHA, ['l'] = CLOX_CHAR_ALPHA, ['m'] = CLOX_CHAR_ALPHA, ['n'] = CLOX_CHAR_ALPHA, ['o'] = CLOX_CHAR_ALPHA, ['p'] = CLOX_CHAR_ALPHA,
+    ['q'] = CLOX_CHAR_ALPHA, ['r'] = CLOX_CHAR_ALPHA, ['s'] = CLOX_CHAR_ALPHA, ['t'] = CLOX_CHAR_ALPHA, ['u'] = CLOX_CHAR_ALPHA, ['v'] = CLOX_CHAR_ALPHA, ['w'] = CLOX_CHAR_ALPHA, ['x'] = CLOX_CHAR_ALPHA,
+    ['y'] = CLOX_CHAR_ALPHA, ['z'] = CLOX_CHAR_ALPHA,
+    ['A'] = CLOX_CHAR_ALPHA, ['B'] = CLOX_CHAR_ALPHA, ['C'] = CLOX_CHAR_ALPHA, ['D'] = CLOX_CHAR_ALPHA, ['E'] = CLOX_CHAR_ALPHA, ['F'] = CLOX_CHAR_ALPHA, ['G'] = CLOX_CHAR_ALPHA, ['H'] = CLOX_CHAR_ALPHA,
+    ['I'] = CLOX_CHAR_ALPHA, ['J'] = CLOX_CHAR_ALPHA, ['K'] = CLOX_CHAR_ALPHA, ['L'] = CLOX_CHAR_ALPHA, ['M'] = CLOX_CHAR_ALPHA, ['N'] = CLOX_CHAR_ALPHA, ['O'] = CLOX_CHAR_ALPHA, ['P'] = CLOX_CHAR_ALPHA,
+    ['Q'] = CLOX_CHAR_ALPHA, ['R'] = CLOX_CHAR_ALPHA, ['S'] = CLOX_CHAR_ALPHA, ['T'] = CLOX_CHAR_ALPHA, ['U'] = CLOX_CHAR_ALPHA, ['V'] = CLOX_CHAR_ALPHA, ['W'] = CLOX_CHAR_ALPHA, ['X'] = CLOX_CHAR_ALPHA,
+    ['Y'] = CLOX_CHAR_ALPHA, ['Z'] = CLOX_CHAR_ALPHA, ['_'] = CLOX_CHAR_ALPHA,
+};
+
+#ifdef CLOX_SCANNER_X86_SIMD
+// NOTE(Al-Andrew): the bulk paths. each looks at 16 or 32 bytes at a time while a whole block fits before `end` and
+//                  returns how many bytes belong to the run, the byte by byte loops after them do the tail and
+//                  decide what the run ended on. `lines` gets the `\n`s inside the run.
+
+static inline __m128i Clox_Scanner_SSE2_Identifier_Mask(__m128i block) {
+    // NOTE(Al-Andrew): signed compares, so bytes past ASCII never match. `| 0x20` only lands in a-z for letters
+    __m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(block, _mm_set1_epi8('9' + 1)));
+    return _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmpeq_epi8(block, _mm_set1_epi8('_')));
+}
+
+static size_t Clox_Scanner_SSE2_Identifier_Run(char const* current, char const* end) {
+    char const* start = current;
+    while (end - current >= 16) {
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(Clox_Scanner_SSE2_Identifier_Mask(_mm_loadu_si128((__m128i const*)current)));
+        if (mask != 0xffff) {
+            return (size_t)(current - start) + (size_t)__builtin_ctz(~mask);
+        }
+        current += 16;
+    }
+    return (size_t)(current - start);
+}
+
+static size_t Clox_Scanner_SSE2_Whitespace_Run(char const* current, char const* end, int* lines) {
+    char const* start = current;
+    while (end - current >= 16) {
+        __m128i block = _mm_loadu_si128((__m128i const*)current);
+        __m128i newline = _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'));
+        __m128i space = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(block, _mm_set1_epi8('\t'))),
+                                     _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('\r')), newline));
+        uint32_t mask = (uint32_t)_mm_movemask_epi8(space);
+        uint32_t newlines = (uint32_t)_mm_movemask_epi8(newline);
+        if (mask != 0xffff) {
+            uint32_t length = (uint32_t)__builtin_ctz(~mask);
+            *lines += __builtin_popcount(newlines & ((1u << length) - 1));
+            return (size_t)(current - start) + length;
+        }
+        *lines += __builtin_popcount(newlines);
+        current += 16;
+    }
+    return (size_t)(current - start);
+}
+
+static size_t Clox_Scanner_SSE2_Find(char const* current, char const* end, char target, int* lines) {
+    char const* start = current;
+    while (end - current >= 16) {
+        __m128i block = _mm_loadu_si128((__m128i const*)current);
+        uint32_t found = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(target)));
+        uint32_t newlines = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+        if (found != 0) {
+            uint32_t length = (uint32_t)__builtin_ctz(found);
+            *lines += __builtin_popcount(newlines & ((1u << length) - 1));
+            return (size_t)(current - start) + length;
+        }
+        *lines += __builtin_popcount(newlines);
+        current += 16;
+    }
+    return (size_t)(current - start);
+}
+
+#define CLOX_SCANNER_AVX2 __attribute__((target("avx2")))
+
+CLOX_SCANNER_AVX2 static size_t Clox_Scanner_AVX2_Identifier_Run(char const* current, char const* end) {
+    char const* start = current;
+    while (end - current >= 32) {
+        __m256i block = _mm256_loadu_si256((__m256i const*)current);
+        __m256i lower = _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+        __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), block));
+        __m256i identifier = _mm256_or_si256(_mm256_or_si256(letter, digit), _mm256_cmpeq_epi8(block, _mm256_set1_epi8('_')));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(identifier);
+        if (mask != UINT32_MAX) {
+            return (size_t)(current - start) + (size_t)__builtin_ctz(~mask);
+        }
+        current += 32;
+    }
+    return (size_t)(current - start);
+}
+
+CLOX_SCANNER_AVX2 static size_t Clox_Scanner_AVX2_Whitespace_Run(char const* current, char const* end, int* lines) {
+    char const* start = current;
+    while (end - current >= 32) {
+        __m256i block = _mm256_loadu_si256((__m256i const*)current);
+        __m256i newline = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n'));
+        __m256i space = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\t'))),
+                                        _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\r')), newline));
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(space);
+        uint32_t newlines = (uint32_t)_mm256_movemask_epi8(newline);
+        if (mask != UINT32_MAX) {
+            uint32_t length = (uint32_t)__builtin_ctz(~mask);
+            *lines += __builtin_popcount(newlines & ((1u << length) - 1));
+            return (size_t)(current - start) + length;
+        }
+        *lines += __builtin_popcount(newlines);
+        current += 32;
+    }
+    return (size_t)(current - start);
+}
+
+CLOX_SCANNER_AVX2 static size_t Clox_Scanner_AVX2_Find(char const* current, char const* end, char target, int* lines) {
+    char const* start = current;
+    while (end - current >= 32) {
+        __m256i block = _mm256_loadu_si256((__m256i const*)current);
+        uint32_t found = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(target)));
+        uint32_t newlines = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n')));
+        if (found != 0) {
+            uint32_t length = (uint32_t)__builtin_ctz(found);
+            *lines += __builtin_popcount(newlines & ((1u << length) - 1));
+            return (size_t)(current - start) + length;
+        }
+        *lines += __builtin_popcount(newlines);
+        current += 32;
+    }
+    return (size_t)(current - start);
+}
 
+#undef CLOX_SCANNER_AVX2
+#endif // CLOX_SCANNER_X86_SIMD
+
+#ifdef CLOX_SCANNER_X86_SIMD
+static Clox_Scanner_SIMD s_clox_scanner_supported_simd = CLOX_SCANNER_SIMD_SSE2; // NOTE(Al-Andrew): every x86_64 has it
+
+// NOTE(Al-Andrew): runs once before main, so constructing a scanner never asks the CPU again and the scanner thread
+//                  only ever reads the result.
+__attribute__((constructor)) static void Clox_Scanner_Detect_SIMD(void) {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        s_clox_scanner_supported_simd = CLOX_SCANNER_SIMD_AVX2;
+    }
+}
+#endif // CLOX_SCANNER_X86_SIMD
+
+Clox_Scanner_SIMD Clox_Scanner_Supported_SIMD(void) {
+    #ifdef CLOX_SCANNER_X86_SIMD
+        return s_clox_scanner_supported_simd;
+    #else
+        return CLOX_SCANNER_SIMD_NONE;
+    #endif // CLOX_SCANNER_X86_SIMD
+}
+
+// NOTE(Al-Andrew): SSE2 only looks at 16 bytes a step and measured slower than the scalar loop (206 vs 214 MB/s on
+//                  scanner_bench), so it is never picked by default. it stays reachable for the bench and the tests.
+Clox_Scanner_SIMD Clox_Scanner_Best_SIMD(void) {
+    return Clox_Scanner_Supported_SIMD() == CLOX_SCANNER_SIMD_AVX2 ? CLOX_SCANNER_SIMD_AVX2 : CLOX_SCANNER_SIMD_NONE;
+}
 
 Clox_Scanner Clox_Scanner_New(const char* source) {
-    return (Clox_Scanner){.current = source, .start = source, .line = 1};
+    return (Clox_Scanner){.current = source, .start = source, .line = 1, .end = source + strlen(source), .simd = Clox_Scanner_Best_SIMD()};
+}
+
+static inline void Clox_Scanner_Bulk_Skip_Whitespace(Clox_Scanner* scanner) {
+    #ifdef CLOX_SCANNER_X86_SIMD
+        switch (scanner->simd) {
+            case CLOX_SCANNER_SIMD_AVX2: {
+                scanner->current += Clox_Scanner_AVX2_Whitespace_Run(scanner->current, scanner->end, &scanner->line);
+            } break;
+            case CLOX_SCANNER_SIMD_SSE2: {
+                scanner->current += Clox_Scanner_SSE2_Whitespace_Run(scanner->current, scanner->end, &scanner->line);
+            } break;
+            case CLOX_SCANNER_SIMD_NONE: {
+                /* no-op */
+            } break;
+        }
+    #else
+        (void)scanner;
+    #endif // CLOX_SCANNER_X86_SIMD
+}
+
+// NOTE(Al-Andrew): stops on `target` or on the byte where the bulk path gave up, whichever comes first
+static inline void Clox_Scanner_Bulk_Skip_Until(Clox_Scanner* scanner, char target) {
+    #ifdef CLOX_SCANNER_X86_SIMD
+        switch (scanner->simd) {
+            case CLOX_SCANNER_SIMD_AVX2: {
+                scanner->current += Clox_Scanner_AVX2_Find(scanner->current, scanner->end, target, &scanner->line);
+            } break;
+            case CLOX_SCANNER_SIMD_SSE2: {
+                scanner->current += Clox_Scanner_SSE2_Find(scanner->current, scanner->end, target, &scanner->line);
+            } break;
+            case CLOX_SCANNER_SIMD_NONE: {
+                /* no-op */
+            } break;
+        }
+    #else
+        (void)scanner;
+        (void)target;
+    #endif // CLOX_SCANNER_X86_SIMD
+}
+
+#define CLOX_SCANNER_BULK_IDENTIFIER_AFTER 8
+
+static inline void Clox_Scanner_Bulk_Skip_Identifier(Clox_Scanner* scanner) {
+    #ifdef CLOX_SCANNER_X86_SIMD
+        switch (scanner->simd) {
+            case CLOX_SCANNER_SIMD_AVX2: {
+                scanner->current += Clox_Scanner_AVX2_Identifier_Run(scanner->current, scanner->end);
+            } break;
+            case CLOX_SCANNER_SIMD_SSE2: {
+                scanner->current += Clox_Scanner_SSE2_Identifier_Run(scanner->current, scanner->end);
+            } break;
+            case CLOX_SCANNER_SIMD_NONE: {
+                /* no-op */
+            } break;
+        }
+    #else
+        (void)scanner;
+    #endif // CLOX_SCANNER_X86_SIMD
+}
+
+// NOTE(Al-Andrew): true if the `\0` under `current` was a stream's sentinel and more source came in behind it
+static bool Clox_Scanner_Refill(Clox_Scanner* scanner) {
+    Clox_Source_Stream* stream = scanner->stream;
+    if (stream == NULL || scanner->current != stream->buffer + stream->used) {
+        return false;
+    }
+    if (!Clox_Source_Stream_Refill(stream)) {
+        return false;
+    }
+    scanner->end = stream->buffer + stream->used;
+    return true;
 }
 
 static inline bool Clox_Scanner_Is_EOF(Clox_Scanner* scanner) {
-    return *scanner->current == '\0';
+    return *scanner->current == '\0' && !Clox_Scanner_Refill(scanner);
 }
 
 static inline Clox_Token Clox_Scanner_Make_Token(Clox_Scanner* scanner, Clox_Token_Type type) {
@@ -42,6 +286,9 @@ static inline char Clox_Scanner_Advance(Clox_Scanner* scanner) {
 
 static inline void Clox_Scanner_Skip_Whitespace(Clox_Scanner* scanner) {
     for (;;) {
+        while (s_clox_char_class[(uint8_t)Clox_Scanner_Peek(scanner)] & CLOX_CHAR_SPACE) {
+            Clox_Scanner_Advance(scanner);
+        }
         char c = Clox_Scanner_Peek(scanner);
         switch (c) {
             case ' ':  // falltrough
@@ -52,11 +299,18 @@ static inline void Clox_Scanner_Skip_Whitespace(Clox_Scanner* scanner) {
             case '\n': {
                 scanner->line++;
                 Clox_Scanner_Advance(scanner);
+                Clox_Scanner_Bulk_Skip_Whitespace(scanner); // NOTE(Al-Andrew): indentation and blank lines, the long runs
+            } break;
+            case '\0': {
+                if (!Clox_Scanner_Refill(scanner)) {
+                    return;
+                }
             } break;
             case '/': {
 
                 if (Clox_Scanner_Peek_Next(scanner) == '/') {
                     // A comment goes until the end of the line.
+                    Clox_Scanner_Bulk_Skip_Until(scanner, '\n');
                     while (Clox_Scanner_Peek(scanner) != '\n' && !Clox_Scanner_Is_EOF(scanner)) {
                         Clox_Scanner_Advance(scanner);   
                     }
@@ -82,6 +336,7 @@ static inline bool Clox_Scanner_Advance_If_Matches(Clox_Scanner* scanner, char t
 }
 
 static inline Clox_Token Clox_Scanner_Make_String(Clox_Scanner* scanner) {
+    Clox_Scanner_Bulk_Skip_Until(scanner, '"');
     while (Clox_Scanner_Peek(scanner) != '"' && !Clox_Scanner_Is_EOF(scanner)) {
     if (Clox_Scanner_Peek(scanner) == '\n') scanner->line++;
         Clox_Scanner_Advance(scanner);
@@ -96,7 +351,7 @@ static inline Clox_Token Clox_Scanner_Make_String(Clox_Scanner* scanner) {
 }
 
 static inline bool Is_Number_Char(char c) {
-    return c >= '0' && c <= '9'; 
+    return s_clox_char_class[(uint8_t)c] & CLOX_CHAR_DIGIT;
 }
 
 static inline Clox_Token Clox_Scanner_Make_Number(Clox_Scanner* scanner) {
@@ -118,52 +373,58 @@ static inline Clox_Token Clox_Scanner_Make_Number(Clox_Scanner* scanner) {
     return Clox_Scanner_Make_Token(scanner, CLOX_TOKEN_NUMBER);
 }
 
-static inline bool Is_Identifier_Char(char c) {
-    return (c >= 'a' && c <= 'z') ||
-           (c >= 'A' && c <= 'Z') ||
-            c == '_';
-}
-
-static const s8 s_clox_keywords[] = {
-    {ls8$("and")},
-    {ls8$("class")},
-    {ls8$("else")},
-    {ls8$("false")},
-    {ls8$("for")},
-    {ls8$("fun")},
-    {ls8$("if")},
-    {ls8$("nil")},
-    {ls8$("or")},
-    {ls8$("print")},
-    {ls8$("return")},
-    {ls8$("super")},
-    {ls8$("this")},
-    {ls8$("true")},
-    {ls8$("var")},
-    {ls8$("while")},
+typedef struct {
+    s8 name;
+    Clox_Token_Type type;
+} Clox_Keyword;
+
+// NOTE(Al-Andrew): perfect hash, every keyword gets its own slot so one compare decides. the slots have to be worked
+//                  out again if a keyword is ever added.
+#define CLOX_SCANNER_KEYWORD_SLOT(first, last, length) (((uint8_t)(first) + 5 * (uint8_t)(last) + (length)) & 31)
+#define CLOX_SCANNER_KEYWORD_MIN_LENGTH 2
+#define CLOX_SCANNER_KEYWORD_MAX_LENGTH 6
+
+static const Clox_Keyword s_clox_keywords[32] = {
+    [24] = {{ls8$("and")},    CLOX_TOKEN_AND},
+    [ 7] = {{ls8$("class")},  CLOX_TOKEN_CLASS},
+    [ 2] = {{ls8$("else")},   CLOX_TOKEN_ELSE},
+    [ 4] = {{ls8$("false")},  CLOX_TOKEN_FALSE},
+    [ 3] = {{ls8$("for")},    CLOX_TOKEN_FOR},
+    [15] = {{ls8$("fun")},    CLOX_TOKEN_FUN},
+    [ 9] = {{ls8$("if")},     CLOX_TOKEN_IF},
+    [13] = {{ls8$("nil")},    CLOX_TOKEN_NIL},
+    [11] = {{ls8$("or")},     CLOX_TOKEN_OR},
+    [25] = {{ls8$("print")},  CLOX_TOKEN_PRINT},
+    [30] = {{ls8$("return")}, CLOX_TOKEN_RETURN},
+    [18] = {{ls8$("super")},  CLOX_TOKEN_SUPER},
+    [23] = {{ls8$("this")},   CLOX_TOKEN_THIS},
+    [17] = {{ls8$("true")},   CLOX_TOKEN_TRUE},
+    [19] = {{ls8$("var")},    CLOX_TOKEN_VAR},
+    [21] = {{ls8$("while")},  CLOX_TOKEN_WHILE},
 };
 
-
-#define static_array_count$(arr) sizeof(arr)/sizeof(arr[0])
-
 static inline Clox_Token_Type Clox_Scanner_Get_Identifier_Type(Clox_Scanner* scanner) {
-        
-    const s8 ident = {.string = scanner->start, .len = (int)((unsigned long long)scanner->current - (unsigned long long)scanner->start)};
-
-    for(unsigned int i = 0; i < static_array_count$(s_clox_keywords); ++i) {
-        s8 potential = s_clox_keywords[i];
+    int length = (int)(scanner->current - scanner->start);
+    if (length < CLOX_SCANNER_KEYWORD_MIN_LENGTH || length > CLOX_SCANNER_KEYWORD_MAX_LENGTH) {
+        return CLOX_TOKEN_IDENTIFIER;
+    }
 
-        if(s8_compare(potential, ident) == 0) {
-            return CLOX_TOKEN_AND + i;
-        } 
+    Clox_Keyword const* keyword = &s_clox_keywords[CLOX_SCANNER_KEYWORD_SLOT(scanner->start[0], scanner->start[length - 1], length)];
+    if (keyword->name.len == length && memcmp(keyword->name.string, scanner->start, length) == 0) {
+        return keyword->type;
     }
-    
     return CLOX_TOKEN_IDENTIFIER;
 }
 
 static inline Clox_Token Clox_Scanner_Make_Identifier(Clox_Scanner* scanner) {
-    while (Is_Identifier_Char(Clox_Scanner_Peek(scanner)) || Is_Number_Char(Clox_Scanner_Peek(scanner))) {
+    // NOTE(Al-Andrew): most names are short enough that a block load costs more than it saves, only go wide once
+    //                  this one turned out to be long
+    char const* bulk_from = scanner->start + CLOX_SCANNER_BULK_IDENTIFIER_AFTER;
+    while (s_clox_char_class[(uint8_t)Clox_Scanner_Peek(scanner)] & (CLOX_CHAR_ALPHA | CLOX_CHAR_DIGIT)) {
         Clox_Scanner_Advance(scanner);
+        if (scanner->current == bulk_from) {
+            Clox_Scanner_Bulk_Skip_Identifier(scanner);
+        }
     }
     return Clox_Scanner_Make_Token(scanner, Clox_Scanner_Get_Identifier_Type(scanner));
 }
@@ -178,9 +439,10 @@ Clox_Token Clox_Scanner_Get_Token(Clox_Scanner* scanner) {
 
     char c = Clox_Scanner_Advance(scanner);
 
-    if(Is_Number_Char(c)) {
+    uint8_t char_class = s_clox_char_class[(uint8_t)c];
+    if (char_class & CLOX_CHAR_DIGIT) {
         return Clox_Scanner_Make_Number(scanner);
-    } else if (Is_Identifier_Char(c)) {
+    } else if (char_class & CLOX_CHAR_ALPHA) {
         return Clox_Scanner_Make_Identifier(scanner);
     }
 
@@ -3,10 +3,23 @@
 
 #include "common.h"
 
+// NOTE(Al-Andrew): which bulk scanning paths a scanner may use. Clox_Scanner_New picks the best one the CPU has,
+//                  a zeroed scanner scans byte by byte.
+typedef enum {
+    CLOX_SCANNER_SIMD_NONE = 0,
+    CLOX_SCANNER_SIMD_SSE2,
+    CLOX_SCANNER_SIMD_AVX2,
+} Clox_Scanner_SIMD;
+
+typedef struct Clox_Source_Stream Clox_Source_Stream;
+
 typedef struct  {
     const char* start;
     const char* current;
     int line;
+    const char* end; // NOTE(Al-Andrew): the terminating `\0`, the bulk paths only ever load bytes before it
+    Clox_Scanner_SIMD simd;
+    Clox_Source_Stream* stream; // NOTE(Al-Andrew): set when the source is still arriving, a `\0` may just be its sentinel
 } Clox_Scanner;
 
 typedef enum {
@@ -67,6 +80,8 @@ struct Clox_Token {
 };
 
 Clox_Scanner Clox_Scanner_New(const char* source);
+Clox_Scanner_SIMD Clox_Scanner_Supported_SIMD(void); // NOTE(Al-Andrew): every level the CPU can run
+Clox_Scanner_SIMD Clox_Scanner_Best_SIMD(void); // NOTE(Al-Andrew): the level new scanners use
 Clox_Token Clox_Scanner_Get_Token(Clox_Scanner* scanner);
 
 #endif // CLOX_SCNANER_H_INCLUDED
\ No newline at end of file
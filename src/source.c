@@ -0,0 +1,251 @@
+#define _DEFAULT_SOURCE // NOTE(Al-Andrew): mmap and friends are hidden under -std=c11 otherwise
+#include "source.h"
+#include "memory.h"
+#include <string.h>
+
+#ifdef CLOX_SOURCE_POSIX
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+
+    #if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+        #define MAP_ANONYMOUS MAP_ANON
+    #endif // !MAP_ANONYMOUS && MAP_ANON
+    #ifndef MAP_NORESERVE
+        #define MAP_NORESERVE 0
+    #endif // MAP_NORESERVE
+#endif // CLOX_SOURCE_POSIX
+
+// NOTE(Al-Andrew): the old way, for platforms without mmap and files we couldn't map
+static bool Clox_Source_Read_File(Clox_Source* source, FILE* file, char const* path) {
+    fseek(file, 0L, SEEK_END);
+    size_t size = ftell(file);
+    rewind(file);
+
+    char* buffer = (char*)reallocate(NULL, 0, size + 1); // TODO(Al-Andrew, AllocFailure): handle
+    size_t bytes_read = fread(buffer, sizeof(char), size, file);
+    if (bytes_read < size && ferror(file)) {
+        printf("[Error] Could not read file %s.\n", path);
+        deallocate(buffer);
+        return false;
+    }
+    buffer[bytes_read] = '\0';
+    source->text = buffer;
+    source->length = bytes_read;
+    return true;
+}
+
+bool Clox_Source_Load_File(Clox_Source* source, char const* path) {
+    CLOX_DEV_ASSERT(source != NULL);
+    *source = (Clox_Source){0};
+
+    #ifdef CLOX_SOURCE_POSIX
+        int fd = open(path, O_RDONLY);
+        struct stat info;
+        if (fd >= 0 && fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+            size_t size = (size_t)info.st_size;
+            size_t page = (size_t)sysconf(_SC_PAGESIZE);
+            void* mapping = MAP_FAILED;
+            size_t mapping_size = size;
+            if (size % page != 0) {
+                mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            } else {
+                // NOTE(Al-Andrew): no zero fill left in the last page, put a zero page behind the file first
+                mapping_size = size + page;
+                mapping = mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (mapping != MAP_FAILED && mmap(mapping, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+                    munmap(mapping, mapping_size);
+                    mapping = MAP_FAILED;
+                }
+            }
+            if (mapping != MAP_FAILED) {
+                close(fd);
+                posix_madvise(mapping, size, POSIX_MADV_SEQUENTIAL);
+                source->text = mapping;
+                source->length = size;
+                source->mapping = mapping;
+                source->mapping_size = mapping_size;
+                return true;
+            }
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    #endif // CLOX_SOURCE_POSIX
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        printf("[Error] Could not get descriptor for file %s.\n", path);
+        return false;
+    }
+    bool ok = Clox_Source_Read_File(source, file, path);
+    fclose(file);
+    return ok;
+}
+
+void Clox_Source_Delete(Clox_Source* source) {
+    CLOX_DEV_ASSERT(source != NULL);
+    #ifdef CLOX_SOURCE_POSIX
+        if (source->mapping != NULL) {
+            munmap(source->mapping, source->mapping_size);
+            *source = (Clox_Source){0};
+            return;
+        }
+    #endif // CLOX_SOURCE_POSIX
+    deallocate((void*)source->text);
+    *source = (Clox_Source){0};
+}
+
+bool Clox_Source_Is_Stream(char const* path) {
+    if (strcmp(path, "-") == 0) {
+        return true;
+    }
+    #ifdef CLOX_SOURCE_POSIX
+        struct stat info;
+        return stat(path, &info) == 0 && !S_ISREG(info.st_mode) && !S_ISDIR(info.st_mode);
+    #else
+        return false;
+    #endif // CLOX_SOURCE_POSIX
+}
+
+#ifdef CLOX_SOURCE_POSIX
+static size_t Clox_Source_Stream_Read_Some(Clox_Source_Stream* stream, char* into, size_t count) {
+    for (;;) {
+        ssize_t got = read(stream->fd, into, count);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        return got > 0 ? (size_t)got : 0;
+    }
+}
+#else
+static size_t Clox_Source_Stream_Read_Some(Clox_Source_Stream* stream, char* into, size_t count) {
+    (void)stream;
+    return fread(into, 1, count, stdin);
+}
+#endif // CLOX_SOURCE_POSIX
+
+// NOTE(Al-Andrew): the whole input onto the heap, for when it can't get a reserved range. the stream is `done` from
+//                  the start, so Clox_Source_Stream_Refill never has anything more to show.
+static void Clox_Source_Stream_Read_All(Clox_Source_Stream* stream) {
+    size_t capacity = CLOX_SOURCE_STREAM_CHUNK;
+    stream->buffer = reallocate(NULL, 0, capacity + 1); // TODO(Al-Andrew, AllocFailure): handle
+    size_t count = 0;
+    while ((count = Clox_Source_Stream_Read_Some(stream, stream->buffer + stream->read, capacity - stream->read)) > 0) {
+        stream->read += count;
+        if (stream->read == capacity) {
+            stream->buffer = reallocate(stream->buffer, capacity + 1, capacity * 2 + 1); // TODO(Al-Andrew, AllocFailure): handle
+            capacity *= 2;
+        }
+    }
+    stream->buffer[stream->read] = '\0';
+    stream->used = stream->read;
+    stream->reserved = 0;
+    stream->done = true;
+}
+
+#ifdef CLOX_SOURCE_POSIX
+
+bool Clox_Source_Stream_Open(Clox_Source_Stream* stream, char const* path) {
+    CLOX_DEV_ASSERT(stream != NULL);
+    *stream = (Clox_Source_Stream){0};
+    stream->fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY);
+    if (stream->fd < 0) {
+        printf("[Error] Could not get descriptor for file %s.\n", path);
+        return false;
+    }
+
+    // NOTE(Al-Andrew): fresh anonymous pages are zero, so whatever follows the bytes read so far is a `\0`
+    stream->buffer = mmap(NULL, CLOX_SOURCE_STREAM_RESERVE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (stream->buffer == MAP_FAILED) {
+        // NOTE(Al-Andrew): refused under strict overcommit or a tight RLIMIT_AS, the input still fits on the heap
+        stream->buffer = NULL;
+        Clox_Source_Stream_Read_All(stream);
+        return true;
+    }
+    stream->reserved = CLOX_SOURCE_STREAM_RESERVE;
+    Clox_Source_Stream_Refill(stream);
+    return true;
+}
+
+bool Clox_Source_Stream_Refill(Clox_Source_Stream* stream) {
+    CLOX_DEV_ASSERT(stream != NULL);
+    size_t before = stream->used;
+    stream->buffer[stream->used] = stream->covered;
+
+    size_t searched = stream->used;
+    for (;;) {
+        // NOTE(Al-Andrew): only whole lines go to the scanner, so no token but a string can run into the sentinel
+        for (size_t i = stream->read; i > searched; --i) {
+            if (stream->buffer[i - 1] == '\n') {
+                stream->used = i;
+                break;
+            }
+        }
+        if (stream->used != before || stream->done) {
+            break;
+        }
+        searched = stream->read;
+
+        if (stream->reserved - stream->read <= CLOX_SOURCE_STREAM_CHUNK) {
+            fprintf(stderr, "[Error] Source is larger than the %zu bytes reserved for it.\n", stream->reserved);
+            stream->done = true;
+            break;
+        }
+        ssize_t count = read(stream->fd, stream->buffer + stream->read, CLOX_SOURCE_STREAM_CHUNK);
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count <= 0) {
+            stream->done = true;
+        } else {
+            stream->read += (size_t)count;
+        }
+    }
+    if (stream->done) {
+        stream->used = stream->read; // NOTE(Al-Andrew): the last line may not end in a newline
+    }
+
+    stream->covered = stream->buffer[stream->used];
+    stream->buffer[stream->used] = '\0';
+    return stream->used != before;
+}
+
+void Clox_Source_Stream_Delete(Clox_Source_Stream* stream) {
+    CLOX_DEV_ASSERT(stream != NULL);
+    if (stream->reserved != 0) {
+        munmap(stream->buffer, stream->reserved);
+    } else {
+        deallocate(stream->buffer);
+    }
+    if (stream->fd != STDIN_FILENO) {
+        close(stream->fd);
+    }
+    *stream = (Clox_Source_Stream){0};
+}
+
+#else
+
+// NOTE(Al-Andrew): no way to reserve address space up front here, so the whole input is read before compiling
+bool Clox_Source_Stream_Open(Clox_Source_Stream* stream, char const* path) {
+    CLOX_DEV_ASSERT(stream != NULL);
+    *stream = (Clox_Source_Stream){0};
+    CLOX_DEV_ASSERT(strcmp(path, "-") == 0);
+    Clox_Source_Stream_Read_All(stream);
+    return true;
+}
+
+bool Clox_Source_Stream_Refill(Clox_Source_Stream* stream) {
+    (void)stream;
+    return false;
+}
+
+void Clox_Source_Stream_Delete(Clox_Source_Stream* stream) {
+    CLOX_DEV_ASSERT(stream != NULL);
+    deallocate(stream->buffer);
+    *stream = (Clox_Source_Stream){0};
+}
+
+#endif // CLOX_SOURCE_POSIX
\ No newline at end of file
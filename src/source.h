@@ -0,0 +1,62 @@
+#ifndef CLOX_SOURCE_H_INCLUDED
+#define CLOX_SOURCE_H_INCLUDED
+
+#include "common.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+    #define CLOX_SOURCE_POSIX
+#endif // __unix__ || __APPLE__
+
+// NOTE(Al-Andrew): address space set aside for a streamed source, only the pages the input fills get memory
+#ifndef CLOX_SOURCE_STREAM_RESERVE
+    #if SIZE_MAX > UINT32_MAX
+        #define CLOX_SOURCE_STREAM_RESERVE ((size_t)1 << 32)
+    #else
+        #define CLOX_SOURCE_STREAM_RESERVE ((size_t)1 << 28) // NOTE(Al-Andrew): a sixteenth of a 32 bit address space
+    #endif // SIZE_MAX > UINT32_MAX
+#endif // CLOX_SOURCE_STREAM_RESERVE
+
+#ifndef CLOX_SOURCE_STREAM_CHUNK
+#define CLOX_SOURCE_STREAM_CHUNK ((size_t)64 * 1024)
+#endif // CLOX_SOURCE_STREAM_CHUNK
+
+// NOTE(Al-Andrew): a whole source file, `\0` terminated. regular files are mapped read only instead of copied, the
+//                  terminator is the zero fill after the end of the file in its last page, or one extra zero page
+//                  mapped behind the file when it ends right on a page boundary.
+typedef struct {
+    char const* text;
+    size_t length;
+    void* mapping; // NOTE(Al-Andrew): NULL if `text` is on the heap
+    size_t mapping_size;
+} Clox_Source;
+
+// NOTE(Al-Andrew): false, with a message, if the file can't be read
+bool Clox_Source_Load_File(Clox_Source* source, char const* path);
+void Clox_Source_Delete(Clox_Source* source);
+
+// NOTE(Al-Andrew): source that is still arriving, from a pipe or a terminal. it lives in one reserved range so it never
+//                  moves and tokens, lazy functions and inline bodies can keep pointing into it. the scanner only
+//                  ever sees whole lines, `buffer[used]` is a `\0` sentinel standing in for the byte it covers, and
+//                  Clox_Source_Stream_Refill shows it more once it scans up to that sentinel.
+typedef struct Clox_Source_Stream Clox_Source_Stream;
+struct Clox_Source_Stream {
+    char* buffer;
+    size_t used; // NOTE(Al-Andrew): bytes the scanner may see
+    size_t read; // NOTE(Al-Andrew): bytes read from `fd` so far, the ones past `used` are the start of a line
+    size_t reserved; // NOTE(Al-Andrew): 0 if the whole input was read onto the heap up front
+    char covered; // NOTE(Al-Andrew): the byte under the sentinel
+    int fd;
+    bool done; // NOTE(Al-Andrew): `fd` hit the end of its input, failed, or outgrew `reserved`
+};
+
+// NOTE(Al-Andrew): `-` or anything stat doesn't call a regular file (pipes, fifos, terminals) is read as a stream
+bool Clox_Source_Is_Stream(char const* path);
+// NOTE(Al-Andrew): `path` is `-` for stdin. reads the first lines before returning. false, with a message, if it can't
+//                  be opened. without POSIX, or when the address space can't be reserved, this reads all of the
+//                  input up front instead.
+bool Clox_Source_Stream_Open(Clox_Source_Stream* stream, char const* path);
+// NOTE(Al-Andrew): blocks until at least one more line arrived. false at the end of the input
+bool Clox_Source_Stream_Refill(Clox_Source_Stream* stream);
+void Clox_Source_Stream_Delete(Clox_Source_Stream* stream);
+
+#endif // CLOX_SOURCE_H_INCLUDED
\ No newline at end of file
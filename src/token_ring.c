@@ -0,0 +1,104 @@
+#include "token_ring.h"
+#include "memory.h"
+
+#define CLOX_TOKEN_RING_MASK (CLOX_TOKEN_RING_CAPACITY - 1)
+_Static_assert((CLOX_TOKEN_RING_CAPACITY & CLOX_TOKEN_RING_MASK) == 0, "CLOX_TOKEN_RING_CAPACITY has to be a power of two");
+
+#ifdef CLOX_TOKEN_RING_AVAILABLE
+
+static int Clox_Token_Ring_Produce(void* argument) {
+    Clox_Token_Ring* ring = argument;
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    for (;;) {
+        Clox_Token token = Clox_Scanner_Get_Token(&ring->scanner);
+        while (head - cached_tail == CLOX_TOKEN_RING_CAPACITY) {
+            cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+            if (head - cached_tail != CLOX_TOKEN_RING_CAPACITY) {
+                break;
+            }
+            if (atomic_load_explicit(&ring->stop, memory_order_relaxed)) {
+                return 0;
+            }
+            thrd_yield();
+        }
+        ring->tokens[head & CLOX_TOKEN_RING_MASK] = token;
+        head += 1;
+        atomic_store_explicit(&ring->head, head, memory_order_release);
+        if (token.type == CLOX_TOKEN_EOF) {
+            return 0;
+        }
+    }
+}
+
+bool Clox_Token_Ring_Start(Clox_Token_Ring* ring, Clox_Scanner scanner) {
+    CLOX_DEV_ASSERT(ring != NULL);
+    ring->scanner = scanner;
+    ring->tokens = reallocate(NULL, 0, sizeof(Clox_Token) * CLOX_TOKEN_RING_CAPACITY); // TODO(Al-Andrew, AllocFailure): handle
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->stop, false);
+    ring->cached_head = 0;
+    ring->finished = false;
+    ring->eof = (Clox_Token){0};
+
+    if (thrd_create(&ring->producer, Clox_Token_Ring_Produce, ring) != thrd_success) {
+        deallocate(ring->tokens);
+        ring->tokens = NULL;
+        return false;
+    }
+    return true;
+}
+
+Clox_Token Clox_Token_Ring_Next(Clox_Token_Ring* ring) {
+    if (ring->finished) {
+        return ring->eof;
+    }
+
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (tail == ring->cached_head) {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail != ring->cached_head) {
+            break;
+        }
+        thrd_yield();
+    }
+
+    Clox_Token token = ring->tokens[tail & CLOX_TOKEN_RING_MASK];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    if (token.type == CLOX_TOKEN_EOF) {
+        ring->finished = true;
+        ring->eof = token;
+    }
+    return token;
+}
+
+void Clox_Token_Ring_Delete(Clox_Token_Ring* ring) {
+    CLOX_DEV_ASSERT(ring != NULL && ring->tokens != NULL);
+    atomic_store_explicit(&ring->stop, true, memory_order_relaxed);
+    thrd_join(ring->producer, NULL);
+    deallocate(ring->tokens);
+    ring->tokens = NULL;
+}
+
+#else
+
+bool Clox_Token_Ring_Start(Clox_Token_Ring* ring, Clox_Scanner scanner) {
+    (void)ring;
+    (void)scanner;
+    return false;
+}
+
+Clox_Token Clox_Token_Ring_Next(Clox_Token_Ring* ring) {
+    (void)ring;
+    CLOX_UNREACHABLE();
+    return (Clox_Token){.type = CLOX_TOKEN_EOF};
+}
+
+void Clox_Token_Ring_Delete(Clox_Token_Ring* ring) {
+    (void)ring;
+    CLOX_UNREACHABLE();
+}
+
+#endif // CLOX_TOKEN_RING_AVAILABLE
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef CLOX_TOKEN_RING_H_INCLUDED
+#define CLOX_TOKEN_RING_H_INCLUDED
+
+#include "scanner.h"
+
+#if !defined(__STDC_NO_THREADS__) && !defined(__STDC_NO_ATOMICS__)
+    #define CLOX_TOKEN_RING_AVAILABLE
+    #include <stdatomic.h>
+    #include <threads.h>
+#endif // !__STDC_NO_THREADS__ && !__STDC_NO_ATOMICS__
+
+#ifndef CLOX_TOKEN_RING_CAPACITY
+    #define CLOX_TOKEN_RING_CAPACITY 4096 // NOTE(Al-Andrew): in tokens, has to be a power of two
+#endif // CLOX_TOKEN_RING_CAPACITY
+
+// NOTE(Al-Andrew): a scanner running on its own thread, ahead of the parser. it pushes every token, error tokens
+//                  included, into a single producer single consumer ring until it has pushed EOF. the parser gets
+//                  exactly the tokens Clox_Scanner_Get_Token would have given it, in the same order.
+typedef struct {
+    Clox_Scanner scanner; // NOTE(Al-Andrew): owned by the producer thread while it runs
+    Clox_Token* tokens;
+    #ifdef CLOX_TOKEN_RING_AVAILABLE
+        thrd_t producer;
+        _Atomic size_t head; // NOTE(Al-Andrew): tokens pushed so far, only the producer writes it
+        _Atomic size_t tail; // NOTE(Al-Andrew): tokens taken so far, only the consumer writes it
+        atomic_bool stop;
+    #endif // CLOX_TOKEN_RING_AVAILABLE
+    size_t cached_head; // NOTE(Al-Andrew): the consumer's last look at `head`, saves touching the producer's line
+    bool finished; // NOTE(Al-Andrew): the consumer took EOF, every later call gets it again
+    Clox_Token eof;
+} Clox_Token_Ring;
+
+// NOTE(Al-Andrew): false if the scanner thread could not be started, the ring is unusable then and needs no Delete
+bool Clox_Token_Ring_Start(Clox_Token_Ring* ring, Clox_Scanner scanner);
+Clox_Token Clox_Token_Ring_Next(Clox_Token_Ring* ring);
+// NOTE(Al-Andrew): fine to call before the consumer got to EOF, the producer is stopped and joined
+void Clox_Token_Ring_Delete(Clox_Token_Ring* ring);
+
+#endif // CLOX_TOKEN_RING_H_INCLUDED
\ No newline at end of file
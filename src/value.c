@@ -1,6 +1,7 @@
 #include "value_array.h"
 #include "value.h"
 #include "memory.h"
+#include <string.h>
 
 Clox_Value_Array Clox_Value_Array_New_Empty() {
     return (Clox_Value_Array){0};
@@ -41,18 +42,25 @@ void Clox_Value_Array_Push_Back(Clox_Value_Array* const chunk, Clox_Value const
 void Clox_Object_Print(Clox_Object const* const);
 
 void Clox_Value_Print(Clox_Value value) {
-    switch(value.type) {
+    switch(CLOX_VALUE_TYPE_OF(value)) {
         case CLOX_VALUE_TYPE_NIL: {
             printf("(nil)");
         } break;
         case CLOX_VALUE_TYPE_BOOL: {
-            printf("%s", value.boolean == true? "true": "false");
+            printf("%s", CLOX_VALUE_AS_BOOL(value) == true? "true": "false");
         } break;
         case CLOX_VALUE_TYPE_NUMBER: {
-            printf("%g", value.number);
+            printf("%g", CLOX_VALUE_AS_NUMBER(value));
+        } break;
+        case CLOX_VALUE_TYPE_INTEGER: {
+            // NOTE(Al-Andrew): printed through double on purpose, integers must look exactly like the numbers they replace
+            printf("%g", (double)CLOX_VALUE_AS_INTEGER(value));
         } break;
         case CLOX_VALUE_TYPE_OBJECT: {
-            Clox_Object_Print(value.object);
+            Clox_Object_Print(CLOX_VALUE_AS_OBJECT(value));
+        } break;
+        case CLOX_VALUE_TYPE_UNDEFINED: {
+            printf("(undefined)");
         } break;
         default:
             CLOX_UNREACHABLE();
@@ -60,15 +68,99 @@ void Clox_Value_Print(Clox_Value value) {
 }
 
 bool Clox_Value_Is_Falsy(Clox_Value value) {
-    switch (value.type) {
+    switch (CLOX_VALUE_TYPE_OF(value)) {
 
         case CLOX_VALUE_TYPE_NIL: return true;
-        case CLOX_VALUE_TYPE_BOOL: return !value.boolean;
+        case CLOX_VALUE_TYPE_UNDEFINED: return true;
+        case CLOX_VALUE_TYPE_BOOL: return !CLOX_VALUE_AS_BOOL(value);
         case CLOX_VALUE_TYPE_NUMBER: /* fallthrough */ 
+        case CLOX_VALUE_TYPE_INTEGER: /* fallthrough */
         case CLOX_VALUE_TYPE_OBJECT: {
             return false;
         }
     }
     CLOX_UNREACHABLE();
     return false;
+}
+
+// NOTE(Al-Andrew): the same constant, not just equal ones. numbers compare bitwise since 0 and -0 print
+//                  differently, integers never match doubles and objects match by address (strings are interned).
+bool Clox_Value_Identical(Clox_Value lhs, Clox_Value rhs) {
+    if (CLOX_VALUE_TYPE_OF(lhs) != CLOX_VALUE_TYPE_OF(rhs)) {
+        return false;
+    }
+    switch (CLOX_VALUE_TYPE_OF(lhs)) {
+        case CLOX_VALUE_TYPE_NIL: /* fallthrough */
+        case CLOX_VALUE_TYPE_UNDEFINED: return true;
+        case CLOX_VALUE_TYPE_BOOL: return CLOX_VALUE_AS_BOOL(lhs) == CLOX_VALUE_AS_BOOL(rhs);
+        case CLOX_VALUE_TYPE_NUMBER: {
+            double lhs_number = CLOX_VALUE_AS_DOUBLE(lhs);
+            double rhs_number = CLOX_VALUE_AS_DOUBLE(rhs);
+            return memcmp(&lhs_number, &rhs_number, sizeof(double)) == 0;
+        }
+        case CLOX_VALUE_TYPE_INTEGER: return CLOX_VALUE_AS_INTEGER(lhs) == CLOX_VALUE_AS_INTEGER(rhs);
+        case CLOX_VALUE_TYPE_OBJECT: return CLOX_VALUE_AS_OBJECT(lhs) == CLOX_VALUE_AS_OBJECT(rhs);
+    }
+    CLOX_UNREACHABLE();
+    return false;
+}
+
+// NOTE(Al-Andrew): a hash that agrees with Clox_Value_Identical
+uint32_t Clox_Value_Identity_Hash(Clox_Value value) {
+    uint64_t bits = 0;
+    switch (CLOX_VALUE_TYPE_OF(value)) {
+        case CLOX_VALUE_TYPE_NIL: /* fallthrough */
+        case CLOX_VALUE_TYPE_UNDEFINED: break;
+        case CLOX_VALUE_TYPE_BOOL: bits = CLOX_VALUE_AS_BOOL(value); break;
+        case CLOX_VALUE_TYPE_NUMBER: {
+            double number = CLOX_VALUE_AS_DOUBLE(value);
+            memcpy(&bits, &number, sizeof(double));
+        } break;
+        case CLOX_VALUE_TYPE_INTEGER: bits = (uint64_t)CLOX_VALUE_AS_INTEGER(value); break;
+        case CLOX_VALUE_TYPE_OBJECT: bits = (uint64_t)(uintptr_t)CLOX_VALUE_AS_OBJECT(value); break;
+    }
+    bits ^= (uint64_t)CLOX_VALUE_TYPE_OF(value) << 56;
+    // NOTE(Al-Andrew): murmur3 finalizer, the low bits of doubles and pointers are mostly zeros
+    bits ^= bits >> 33;
+    bits *= 0xff51afd7ed558ccdull;
+    bits ^= bits >> 33;
+    bits *= 0xc4ceb9fe1a85ec53ull;
+    bits ^= bits >> 33;
+    return (uint32_t)bits;
+}
+
+static uint32_t* Clox_Value_Index_Map_Find(Clox_Value_Index_Map* const map, Clox_Value_Array const* const array, Clox_Value value) {
+    uint32_t mask = map->capacity - 1;
+    uint32_t slot = Clox_Value_Identity_Hash(value) & mask;
+    while (map->slots[slot] != 0 && !Clox_Value_Identical(array->values[map->slots[slot] - 1], value)) {
+        slot = (slot + 1) & mask;
+    }
+    return &map->slots[slot];
+}
+
+// NOTE(Al-Andrew): the slot for `value`, holding its index plus one if it is in `array` already. a zero slot is where
+//                  the caller stores array->used + 1 after pushing it. there is always room for that one push,
+//                  growing rehashes straight from the array, which may already be long the first time around.
+uint32_t* Clox_Value_Index_Map_Slot(Clox_Value_Index_Map* const map, Clox_Value_Array const* const array, Clox_Value value) {
+    CLOX_DEV_ASSERT(map != NULL && array != NULL);
+
+    if ((array->used + 1) * 4 > map->capacity * 3) {
+        uint32_t capacity = map->capacity == 0 ? 16 : map->capacity * 2;
+        while ((array->used + 1) * 4 > capacity * 3) {
+            capacity *= 2;
+        }
+        map->slots = reallocate(map->slots, 0, sizeof(uint32_t) * capacity); // TODO(Al-Andrew, AllocFailure): handle
+        map->capacity = capacity;
+        memset(map->slots, 0, sizeof(uint32_t) * capacity);
+        for (uint32_t i = 0; i < array->used; ++i) {
+            *Clox_Value_Index_Map_Find(map, array, array->values[i]) = i + 1;
+        }
+    }
+    return Clox_Value_Index_Map_Find(map, array, value);
+}
+
+void Clox_Value_Index_Map_Delete(Clox_Value_Index_Map* const map) {
+    if (map->slots)
+        deallocate(map->slots);
+    *map = (Clox_Value_Index_Map){0};
 }
\ No newline at end of file
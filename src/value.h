@@ -7,30 +7,211 @@ typedef enum {
   CLOX_VALUE_TYPE_NIL,
   CLOX_VALUE_TYPE_BOOL,
   CLOX_VALUE_TYPE_NUMBER,
+  CLOX_VALUE_TYPE_INTEGER, // NOTE(Al-Andrew): still a Lox number, just one that is known to be integral
   CLOX_VALUE_TYPE_OBJECT,
+  CLOX_VALUE_TYPE_UNDEFINED, // NOTE(Al-Andrew): internal, marks a global slot that was resolved but never defined
 } Clox_Value_Type;
 
 typedef struct Clox_Object Clox_Object;
 struct Clox_Object;
 
+typedef struct Clox_Value Clox_Value;
+
+#ifdef CLOX_VALUE_NAN_BOXING
+
+// NOTE(Al-Andrew): every value is one 64-bit word. Doubles are stored as-is; anything else
+// lives inside the quiet NaN space. Object pointers set the sign bit and keep the address
+// in the low 48 bits, the singletons (nil, false, true, undefined) use small tags.
+// Only go through the macros below, the layout is not part of the interface.
+struct Clox_Value {
+  uint64_t bits;
+};
+
+#define CLOX_VALUE_NAN_SIGN_BIT ((uint64_t)0x8000000000000000)
+#define CLOX_VALUE_NAN_QNAN     ((uint64_t)0x7ffc000000000000)
+
+#define CLOX_VALUE_NAN_TAG_NIL       1
+#define CLOX_VALUE_NAN_TAG_FALSE     2
+#define CLOX_VALUE_NAN_TAG_TRUE      3
+#define CLOX_VALUE_NAN_TAG_UNDEFINED 4
+
+#define CLOX_VALUE_NAN_FALSE_BITS (CLOX_VALUE_NAN_QNAN | CLOX_VALUE_NAN_TAG_FALSE)
+#define CLOX_VALUE_NAN_TRUE_BITS  (CLOX_VALUE_NAN_QNAN | CLOX_VALUE_NAN_TAG_TRUE)
+
+static inline double Clox_Value_Bits_To_Double(uint64_t bits) {
+  union { uint64_t bits; double number; } cast = {.bits = bits};
+  return cast.number;
+}
+
+static inline uint64_t Clox_Value_Double_To_Bits(double number) {
+  union { uint64_t bits; double number; } cast = {.number = number};
+  return cast.bits;
+}
+
+#define CLOX_VALUE_IS_BOOL(value)      (((value).bits | 1) == CLOX_VALUE_NAN_TRUE_BITS)
+#define CLOX_VALUE_IS_NIL(value)       ((value).bits == (CLOX_VALUE_NAN_QNAN | CLOX_VALUE_NAN_TAG_NIL))
+#define CLOX_VALUE_IS_NUMBER(value)    (((value).bits & CLOX_VALUE_NAN_QNAN) != CLOX_VALUE_NAN_QNAN)
+#define CLOX_VALUE_IS_OBJECT(value)    (((value).bits & (CLOX_VALUE_NAN_QNAN | CLOX_VALUE_NAN_SIGN_BIT)) == (CLOX_VALUE_NAN_QNAN | CLOX_VALUE_NAN_SIGN_BIT))
+#define CLOX_VALUE_IS_UNDEFINED(value) ((value).bits == (CLOX_VALUE_NAN_QNAN | CLOX_VALUE_NAN_TAG_UNDEFINED))
+
+#define CLOX_VALUE_AS_BOOL(value)   ((value).bits == CLOX_VALUE_NAN_TRUE_BITS)
+#define CLOX_VALUE_AS_NUMBER(value) (Clox_Value_Bits_To_Double((value).bits))
+#define CLOX_VALUE_AS_OBJECT(value) ((Clox_Object*)(uintptr_t)((value).bits & ~(CLOX_VALUE_NAN_SIGN_BIT | CLOX_VALUE_NAN_QNAN)))
+
+#define CLOX_VALUE_BOOL(value)   ((Clox_Value){(value) ? CLOX_VALUE_NAN_TRUE_BITS : CLOX_VALUE_NAN_FALSE_BITS})
+#define CLOX_VALUE_NIL           ((Clox_Value){CLOX_VALUE_NAN_QNAN | CLOX_VALUE_NAN_TAG_NIL})
+#define CLOX_VALUE_NUMBER(value) ((Clox_Value){Clox_Value_Double_To_Bits(value)})
+#define CLOX_VALUE_OBJECT(obj)   ((Clox_Value){CLOX_VALUE_NAN_SIGN_BIT | CLOX_VALUE_NAN_QNAN | (uint64_t)(uintptr_t)(obj)})
+#define CLOX_VALUE_UNDEFINED     ((Clox_Value){CLOX_VALUE_NAN_QNAN | CLOX_VALUE_NAN_TAG_UNDEFINED})
+
+static inline Clox_Value_Type Clox_Value_Type_Of(Clox_Value value) {
+  if (CLOX_VALUE_IS_NUMBER(value)) return CLOX_VALUE_TYPE_NUMBER;
+  if (CLOX_VALUE_IS_OBJECT(value)) return CLOX_VALUE_TYPE_OBJECT;
+  switch (value.bits & 7) {
+    case CLOX_VALUE_NAN_TAG_NIL:       return CLOX_VALUE_TYPE_NIL;
+    case CLOX_VALUE_NAN_TAG_UNDEFINED: return CLOX_VALUE_TYPE_UNDEFINED;
+    default:                           return CLOX_VALUE_TYPE_BOOL;
+  }
+}
+
+#define CLOX_VALUE_TYPE_OF(value) (Clox_Value_Type_Of(value))
+
+// NOTE(Al-Andrew): there are no spare bits for an int64 next to a double, so with NaN boxing every number
+// stays a double and the integer subtype collapses into it.
+#define CLOX_VALUE_IS_DOUBLE(value)  CLOX_VALUE_IS_NUMBER(value)
+#define CLOX_VALUE_IS_INTEGER(value) (false)
+#define CLOX_VALUE_AS_DOUBLE(value)  CLOX_VALUE_AS_NUMBER(value)
+#define CLOX_VALUE_AS_INTEGER(value) ((int64_t)CLOX_VALUE_AS_NUMBER(value))
+#define CLOX_VALUE_INTEGER(value)    CLOX_VALUE_NUMBER((double)(value))
+
+#else // CLOX_VALUE_NAN_BOXING
+
 struct Clox_Value {
   Clox_Value_Type type;
   union {
     bool boolean;
     double number;
+    int64_t integer;
     Clox_Object* object;
   }; 
 };
 
+// NOTE(Al-Andrew): integers and doubles are both Lox numbers. IS_NUMBER/AS_NUMBER look through the subtype,
+// IS_DOUBLE/IS_INTEGER and their AS_ counterparts are for the paths that specialize on it.
+static inline double Clox_Value_As_Number(Clox_Value value) {
+  return value.type == CLOX_VALUE_TYPE_INTEGER ? (double)value.integer : value.number;
+}
+
 
 #define CLOX_VALUE_IS_BOOL(value)    ((value).type == CLOX_VALUE_TYPE_BOOL)
 #define CLOX_VALUE_IS_NIL(value)     ((value).type == CLOX_VALUE_TYPE_NIL)
-#define CLOX_VALUE_IS_NUMBER(value)  ((value).type == CLOX_VALUE_TYPE_NUMBER)
+#define CLOX_VALUE_IS_NUMBER(value)  ((value).type == CLOX_VALUE_TYPE_NUMBER || (value).type == CLOX_VALUE_TYPE_INTEGER)
+#define CLOX_VALUE_IS_DOUBLE(value)  ((value).type == CLOX_VALUE_TYPE_NUMBER)
+#define CLOX_VALUE_IS_INTEGER(value) ((value).type == CLOX_VALUE_TYPE_INTEGER)
 #define CLOX_VALUE_IS_OBJECT(value)  ((value).type == CLOX_VALUE_TYPE_OBJECT)
+#define CLOX_VALUE_IS_UNDEFINED(value) ((value).type == CLOX_VALUE_TYPE_UNDEFINED)
+
+#define CLOX_VALUE_AS_BOOL(value)   ((value).boolean)
+#define CLOX_VALUE_AS_NUMBER(value) (Clox_Value_As_Number(value))
+#define CLOX_VALUE_AS_DOUBLE(value) ((value).number)
+#define CLOX_VALUE_AS_INTEGER(value) ((value).integer)
+#define CLOX_VALUE_AS_OBJECT(value) ((value).object)
 
 #define CLOX_VALUE_BOOL(value)   ((Clox_Value){CLOX_VALUE_TYPE_BOOL, {.boolean = value}})
 #define CLOX_VALUE_NIL           ((Clox_Value){CLOX_VALUE_TYPE_NIL, {.number = 0}})
 #define CLOX_VALUE_NUMBER(value) ((Clox_Value){CLOX_VALUE_TYPE_NUMBER, {.number = value}})
+#define CLOX_VALUE_INTEGER(value) ((Clox_Value){CLOX_VALUE_TYPE_INTEGER, {.integer = value}})
 #define CLOX_VALUE_OBJECT(obj)   ((Clox_Value){CLOX_VALUE_TYPE_OBJECT, {.object = (Clox_Object*)(obj)}})
+#define CLOX_VALUE_UNDEFINED     ((Clox_Value){CLOX_VALUE_TYPE_UNDEFINED, {.number = 0}})
+
+#define CLOX_VALUE_TYPE_OF(value) ((value).type)
+
+#endif // CLOX_VALUE_NAN_BOXING
+
+// NOTE(Al-Andrew): integers that fit the operand byte of OP_SMALL_INT. Under NaN boxing the integer subtype is
+//                  just a double, so the bits have to round-trip exactly (that keeps -0 and 2.5 out).
+static inline bool Clox_Value_Is_Small_Integer(Clox_Value value, int8_t* small) {
+#ifdef CLOX_VALUE_NAN_BOXING
+  if (!CLOX_VALUE_IS_NUMBER(value)) return false;
+  double number = CLOX_VALUE_AS_NUMBER(value);
+  if (!(number >= INT8_MIN && number <= INT8_MAX)) return false;
+  *small = (int8_t)number;
+  return value.bits == CLOX_VALUE_INTEGER(*small).bits;
+#else
+  if (!CLOX_VALUE_IS_INTEGER(value)) return false;
+  if (CLOX_VALUE_AS_INTEGER(value) < INT8_MIN || CLOX_VALUE_AS_INTEGER(value) > INT8_MAX) return false;
+  *small = (int8_t)CLOX_VALUE_AS_INTEGER(value);
+  return true;
+#endif // CLOX_VALUE_NAN_BOXING
+}
+
+// NOTE(Al-Andrew): integers never leave the range a double holds exactly, so mixing subtypes in a comparison is
+//                  exact and == stays transitive. Anything past it is produced as a double instead. this gives up
+//                  exact integers above 2^53. past it an integer would print differently from the double a NaN boxed
+//                  build computes for the same program, and comparing it with a double rounds, so two integers that
+//                  differ could both equal one double. what the subtype still buys is loop counters, compares and
+//                  constant keys that stay off the FPU, and the integer fast paths the quickened ops build on.
+#define CLOX_VALUE_INTEGER_LIMIT ((int64_t)1 << 53)
+
+static inline bool Clox_Value_Integer_Fits(int64_t value) {
+  return value >= -CLOX_VALUE_INTEGER_LIMIT && value <= CLOX_VALUE_INTEGER_LIMIT;
+}
+
+// NOTE(Al-Andrew): int64 arithmetic that reports overflow instead of wrapping. On overflow the caller redoes the
+//                  operation in double, that is the promotion rule for the integer subtype. Overflow also covers
+//                  leaving the exact range above and results the double path would give as -0.
+#if defined(__GNUC__)
+  #define Clox_Value_Int64_Add_Overflows(lhs, rhs, result) __builtin_add_overflow((lhs), (rhs), (result))
+  #define Clox_Value_Int64_Sub_Overflows(lhs, rhs, result) __builtin_sub_overflow((lhs), (rhs), (result))
+  #define Clox_Value_Int64_Mul_Overflows(lhs, rhs, result) __builtin_mul_overflow((lhs), (rhs), (result))
+#else
+static inline bool Clox_Value_Int64_Add_Overflows(int64_t lhs, int64_t rhs, int64_t* result) {
+  if ((rhs > 0 && lhs > INT64_MAX - rhs) || (rhs < 0 && lhs < INT64_MIN - rhs)) return true;
+  *result = lhs + rhs;
+  return false;
+}
+
+static inline bool Clox_Value_Int64_Sub_Overflows(int64_t lhs, int64_t rhs, int64_t* result) {
+  if ((rhs < 0 && lhs > INT64_MAX + rhs) || (rhs > 0 && lhs < INT64_MIN + rhs)) return true;
+  *result = lhs - rhs;
+  return false;
+}
+
+static inline bool Clox_Value_Int64_Mul_Overflows(int64_t lhs, int64_t rhs, int64_t* result) {
+  if (lhs != 0 && rhs != 0) {
+    if ((lhs == -1 && rhs == INT64_MIN) || (rhs == -1 && lhs == INT64_MIN)) return true;
+    if (lhs != -1 && rhs != -1 && (lhs > 0 ? (rhs > 0 ? lhs > INT64_MAX / rhs : rhs < INT64_MIN / lhs)
+                                           : (rhs > 0 ? lhs < INT64_MIN / rhs : lhs < INT64_MAX / rhs))) return true;
+  }
+  *result = lhs * rhs;
+  return false;
+}
+#endif // __GNUC__
+
+static inline bool Clox_Value_Add_Overflows(int64_t lhs, int64_t rhs, int64_t* result) {
+  return Clox_Value_Int64_Add_Overflows(lhs, rhs, result) || !Clox_Value_Integer_Fits(*result);
+}
+
+static inline bool Clox_Value_Sub_Overflows(int64_t lhs, int64_t rhs, int64_t* result) {
+  return Clox_Value_Int64_Sub_Overflows(lhs, rhs, result) || !Clox_Value_Integer_Fits(*result);
+}
+
+static inline bool Clox_Value_Mul_Overflows(int64_t lhs, int64_t rhs, int64_t* result) {
+  if (Clox_Value_Int64_Mul_Overflows(lhs, rhs, result) || !Clox_Value_Integer_Fits(*result)) return true;
+  return *result == 0 && (lhs < 0 || rhs < 0);
+}
+
+// NOTE(Al-Andrew): division stays integral only when it is exact, 7 / 2 has to give 3.5.
+static inline bool Clox_Value_Div_Overflows(int64_t dividend, int64_t divisor, int64_t* result) {
+  if (divisor == 0 || !Clox_Value_Integer_Fits(dividend) || dividend % divisor != 0) return true;
+  *result = dividend / divisor;
+  return *result == 0 && divisor < 0;
+}
+
+static inline bool Clox_Value_Negate_Overflows(int64_t operand, int64_t* result) {
+  if (operand == 0 || !Clox_Value_Integer_Fits(operand)) return true;
+  *result = -operand;
+  return false;
+}
 
 #endif // CLOX_VALUE_H_INCLUDED
\ No newline at end of file
@@ -16,6 +16,13 @@ typedef struct {
   Clox_Value* values;
 } Clox_Value_Array;
 
+// NOTE(Al-Andrew): finds values in a Clox_Value_Array by identity. holds indices into the array plus one, zero is an
+//                  empty slot, so it never owns any values.
+typedef struct {
+  uint32_t* slots;
+  uint32_t capacity;
+} Clox_Value_Index_Map;
+
 
 Clox_Value_Array Clox_Value_Array_New_Empty();
 
@@ -26,4 +33,12 @@ void Clox_Value_Print(Clox_Value value);
 
 bool Clox_Value_Is_Falsy(Clox_Value value);
 
+bool Clox_Value_Identical(Clox_Value lhs, Clox_Value rhs);
+
+uint32_t Clox_Value_Identity_Hash(Clox_Value value);
+
+uint32_t* Clox_Value_Index_Map_Slot(Clox_Value_Index_Map* const map, Clox_Value_Array const* const array, Clox_Value value);
+
+void Clox_Value_Index_Map_Delete(Clox_Value_Index_Map* const map);
+
 #endif // CLOX_VALUE_ARRAY_H_INCLUDED
\ No newline at end of file
@@ -0,0 +1,376 @@
+#include "verifier.h"
+#include "common.h"
+#include "chunk.h"
+#include "memory.h"
+#include "peephole.h"
+#include "vm.h"
+#include <string.h>
+
+#define CLOX_VERIFIER_UNVISITED -1
+
+typedef struct Clox_Verifier Clox_Verifier;
+struct Clox_Verifier {
+    Clox_VM* vm;
+    Clox_Verifier const* enclosing; // NOTE(Al-Andrew): the verifier of the function whose OP_CLOSURE got us here
+    Clox_Function* function;
+    Clox_Chunk* chunk;
+    int32_t* depth_at;
+    bool* is_instruction_start;
+    uint32_t* worklist;
+    uint32_t worklist_used;
+    int32_t max_depth;
+    uint8_t const* capture_flags; // NOTE(Al-Andrew): CLOX_CAPTURE_FLAG_* per upvalue, from the OP_CLOSURE that made us
+};
+
+static bool Clox_Verifier_Verify(Clox_VM* vm, Clox_Verifier const* enclosing, Clox_Function* function, uint8_t const* capture_flags);
+
+static bool Clox_Verifier_Error(Clox_Verifier* verifier, uint32_t offset, char const* const fmt, ...) {
+    fprintf(stderr, "[verifier] in %s at %04X: ", verifier->function->name != NULL ? verifier->function->name->characters : "<script>", offset);
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fputs("\n", stderr);
+    return false;
+}
+
+// NOTE(Al-Andrew): superinstructions and quickened opcodes are verified as the generic instructions they stand for,
+//                  their original bytes are still in the chunk and the VM can fall back onto any of them. the fast
+//                  paths of a superinstruction read those bytes without looking at the opcodes between them, so
+//                  Mark_Instruction_Starts also holds every superinstruction to the sequence it was fused from.
+static uint32_t Clox_Verifier_Instruction_Length(Clox_Verifier* verifier, uint32_t offset, Clox_Op_Code opcode) {
+    switch (opcode) {
+        case OP_CLOSURE: /* fallthrough */
+        case OP_CLOSURE_LONG: {
+            uint32_t captures = opcode == OP_CLOSURE ? 2 : 3;
+            if (offset + captures > verifier->chunk->used) return 0;
+            uint16_t constant = opcode == OP_CLOSURE ? verifier->chunk->code[offset + 1]
+                                                     : (uint16_t)((verifier->chunk->code[offset + 1] << 8) | verifier->chunk->code[offset + 2]);
+            if (constant >= verifier->chunk->constants.used) return 0;
+            Clox_Value value = verifier->chunk->constants.values[constant];
+            if (!CLOX_VALUE_IS_OBJECT(value) || CLOX_VALUE_AS_OBJECT(value)->type != CLOX_OBJECT_TYPE_FUNCTION) return 0;
+            int upvalue_count = ((Clox_Function*)CLOX_VALUE_AS_OBJECT(value))->upvalue_count;
+            for (int i = 0; i < upvalue_count; i++) {
+                if (offset + captures >= verifier->chunk->used) return 0;
+                captures += (verifier->chunk->code[offset + captures] & CLOX_CAPTURE_FLAG_WIDE) ? 3 : 2;
+            }
+            return captures;
+        } break;
+        default: {
+            return Clox_Op_Code_Operand_Length(opcode) + 1;
+        } break;
+    }
+}
+
+// NOTE(Al-Andrew): the rest of the sequence has to be there as plain or quickened opcodes, never fused again
+static bool Clox_Verifier_Check_Fused_Sequence(Clox_Verifier* verifier, uint32_t offset, uint32_t next) {
+    Clox_Op_Code const* sequence = NULL;
+    uint32_t sequence_length = Clox_Peephole_Superinstruction_Sequence(verifier->chunk->code[offset], &sequence);
+    for (uint32_t i = 1; i < sequence_length; ++i) {
+        Clox_Op_Code const* nested = NULL;
+        if (next >= verifier->chunk->used || Clox_Op_Code_Generic(verifier->chunk->code[next]) != sequence[i]
+            || Clox_Peephole_Superinstruction_Sequence(verifier->chunk->code[next], &nested) != 0) {
+            return Clox_Verifier_Error(verifier, offset, "%s is not followed by the sequence it was fused from.", Clox_Op_Code_Name(verifier->chunk->code[offset]));
+        }
+        next += Clox_Verifier_Instruction_Length(verifier, next, sequence[i]);
+    }
+    return true;
+}
+
+static bool Clox_Verifier_Mark_Instruction_Starts(Clox_Verifier* verifier) {
+    uint32_t offset = 0;
+    while (offset < verifier->chunk->used) {
+        Clox_Op_Code opcode = Clox_Op_Code_Generic(verifier->chunk->code[offset]);
+        uint32_t length = Clox_Verifier_Instruction_Length(verifier, offset, opcode);
+        if (length == 0 || offset + length > verifier->chunk->used) {
+            return Clox_Verifier_Error(verifier, offset, "Malformed instruction %s.", Clox_Op_Code_Name(verifier->chunk->code[offset]));
+        }
+        verifier->is_instruction_start[offset] = true;
+        if (!Clox_Verifier_Check_Fused_Sequence(verifier, offset, offset + length)) {
+            return false;
+        }
+        offset += length;
+    }
+    return true;
+}
+
+static bool Clox_Verifier_Flow_To(Clox_Verifier* verifier, uint32_t from, int64_t target, int32_t depth) {
+    if (target < 0 || target >= verifier->chunk->used || !verifier->is_instruction_start[target]) {
+        return Clox_Verifier_Error(verifier, from, "Control flow leaves the chunk or lands inside an instruction.");
+    }
+
+    int32_t known_depth = verifier->depth_at[target];
+    if (known_depth == CLOX_VERIFIER_UNVISITED) {
+        verifier->depth_at[target] = depth;
+        verifier->worklist[verifier->worklist_used++] = (uint32_t)target;
+        return true;
+    }
+    if (known_depth != depth) {
+        return Clox_Verifier_Error(verifier, from, "Stack depth %d does not match depth %d already seen at %04X.", depth, known_depth, (uint32_t)target);
+    }
+    return true;
+}
+
+#define CLOX_VERIFIER_NEED(N) { if (depth < (N)) { return Clox_Verifier_Error(verifier, offset, "%s needs %d stack values, only %d there.", Clox_Op_Code_Name(opcode), (N), depth); } }
+#define CLOX_VERIFIER_CHECK(cond, message) { if (!(cond)) { return Clox_Verifier_Error(verifier, offset, message); } }
+
+// NOTE(Al-Andrew): checks the capture list of the closure instruction at `offset` and collects its flags for `nested`.
+//                  Instruction_Length already made sure every capture is inside the chunk.
+static bool Clox_Verifier_Read_Captures(Clox_Verifier* verifier, uint32_t offset, uint8_t const* captures, int32_t depth, Clox_Function* nested, uint8_t* nested_flags) {
+    for (int i = 0; i < nested->upvalue_count; i++) {
+        uint8_t flags = *captures++;
+        uint16_t index = *captures++;
+        if (flags & CLOX_CAPTURE_FLAG_WIDE) {
+            index = (uint16_t)((index << 8) | *captures++);
+        }
+        CLOX_VERIFIER_CHECK((flags & ~(CLOX_CAPTURE_FLAG_LOCAL | CLOX_CAPTURE_FLAG_BY_VALUE | CLOX_CAPTURE_FLAG_WIDE)) == 0, "Unknown capture flags.");
+        if (flags & CLOX_CAPTURE_FLAG_LOCAL) {
+            // NOTE(Al-Andrew): `<=` since the new closure is already pushed, a local function can capture itself
+            CLOX_VERIFIER_CHECK(index <= depth, "Captured local slot out of range.");
+        } else {
+            CLOX_VERIFIER_CHECK(index < verifier->function->upvalue_count, "Captured upvalue index out of range.");
+            CLOX_VERIFIER_CHECK((flags & CLOX_CAPTURE_FLAG_BY_VALUE) == (verifier->capture_flags[index] & CLOX_CAPTURE_FLAG_BY_VALUE), "Captured upvalue changes capture kind.");
+        }
+        nested_flags[i] = flags & ~CLOX_CAPTURE_FLAG_WIDE;
+    }
+    return true;
+}
+
+static bool Clox_Verifier_Step(Clox_Verifier* verifier, uint32_t offset) {
+    Clox_Chunk* chunk = verifier->chunk;
+    int32_t depth = verifier->depth_at[offset];
+    Clox_Op_Code opcode = Clox_Op_Code_Generic(chunk->code[offset]);
+    uint8_t const* operands = &chunk->code[offset + 1];
+    uint32_t next = offset + Clox_Verifier_Instruction_Length(verifier, offset, opcode);
+
+    // NOTE(Al-Andrew): a wide local or upvalue op is checked as the op it prefixes, with the short as its slot
+    uint16_t slot = next > offset + 1 ? operands[0] : 0;
+    if (opcode == OP_WIDE) {
+        opcode = operands[0];
+        slot = (uint16_t)((operands[1] << 8) | operands[2]);
+        CLOX_VERIFIER_CHECK(opcode == OP_GET_LOCAL || opcode == OP_SET_LOCAL || opcode == OP_GET_UPVALUE || opcode == OP_GET_FLAT_UPVALUE || opcode == OP_SET_UPVALUE,
+                            "OP_WIDE prefixes an op without a slot.");
+    }
+
+    switch (opcode) {
+        case OP_RETURN: {
+            CLOX_VERIFIER_NEED(2); // NOTE(Al-Andrew): the result and the callee under it, the script's return pops both
+            return true;
+        } break;
+        case OP_CONSTANT: {
+            CLOX_VERIFIER_CHECK(operands[0] < chunk->constants.used, "Constant index out of range.");
+            depth += 1;
+        } break;
+        case OP_CONSTANT_LONG: {
+            CLOX_VERIFIER_CHECK(((operands[0] << 8) | operands[1]) < (int)chunk->constants.used, "Constant index out of range.");
+            depth += 1;
+        } break;
+        case OP_SMALL_INT: /* fallthrough */
+        case OP_NIL: /* fallthrough */
+        case OP_TRUE: /* fallthrough */
+        case OP_FALSE: {
+            depth += 1;
+        } break;
+        case OP_ARITHMETIC_NEGATION: /* fallthrough */
+        case OP_BOOLEAN_NEGATION: {
+            CLOX_VERIFIER_NEED(1);
+        } break;
+        case OP_ADD: /* fallthrough */
+        case OP_SUB: /* fallthrough */
+        case OP_MUL: /* fallthrough */
+        case OP_DIV: /* fallthrough */
+        case OP_EQUAL: /* fallthrough */
+        case OP_GREATER: /* fallthrough */
+        case OP_LESS: /* fallthrough */
+        case OP_NOT_EQUAL: /* fallthrough */
+        case OP_GREATER_EQUAL: /* fallthrough */
+        case OP_LESS_EQUAL: {
+            CLOX_VERIFIER_NEED(2);
+            depth -= 1;
+        } break;
+        case OP_PRINT: /* fallthrough */
+        case OP_POP: /* fallthrough */
+        case OP_CLOSE_UPVALUE: {
+            CLOX_VERIFIER_NEED(1);
+            depth -= 1;
+        } break;
+        case OP_DEFINE_GLOBAL: /* fallthrough */
+        case OP_GET_GLOBAL: /* fallthrough */
+        case OP_SET_GLOBAL: {
+            uint16_t slot = (uint16_t)((operands[0] << 8) | operands[1]);
+            CLOX_VERIFIER_CHECK(slot < verifier->vm->global_values.used, "Global slot out of range.");
+            if (opcode == OP_DEFINE_GLOBAL) {
+                CLOX_VERIFIER_NEED(1);
+                depth -= 1;
+            } else if (opcode == OP_SET_GLOBAL) {
+                CLOX_VERIFIER_NEED(1);
+            } else {
+                depth += 1;
+            }
+        } break;
+        case OP_GET_LOCAL: {
+            CLOX_VERIFIER_CHECK(slot < depth, "Local slot out of range.");
+            depth += 1;
+        } break;
+        case OP_SET_LOCAL: {
+            CLOX_VERIFIER_NEED(1);
+            CLOX_VERIFIER_CHECK(slot < depth, "Local slot out of range.");
+        } break;
+        case OP_GET_UPVALUE: {
+            CLOX_VERIFIER_CHECK(slot < verifier->function->upvalue_count, "Upvalue index out of range.");
+            CLOX_VERIFIER_CHECK(!(verifier->capture_flags[slot] & CLOX_CAPTURE_FLAG_BY_VALUE), "Upvalue was captured by value.");
+            depth += 1;
+        } break;
+        case OP_GET_FLAT_UPVALUE: {
+            CLOX_VERIFIER_CHECK(slot < verifier->function->upvalue_count, "Upvalue index out of range.");
+            CLOX_VERIFIER_CHECK(verifier->capture_flags[slot] & CLOX_CAPTURE_FLAG_BY_VALUE, "Upvalue was not captured by value.");
+            depth += 1;
+        } break;
+        case OP_SET_UPVALUE: {
+            CLOX_VERIFIER_NEED(1);
+            CLOX_VERIFIER_CHECK(slot < verifier->function->upvalue_count, "Upvalue index out of range.");
+            CLOX_VERIFIER_CHECK(!(verifier->capture_flags[slot] & CLOX_CAPTURE_FLAG_BY_VALUE), "Upvalue was captured by value.");
+        } break;
+        case OP_JUMP: {
+            uint16_t jump = (uint16_t)((operands[0] << 8) | operands[1]);
+            return Clox_Verifier_Flow_To(verifier, offset, (int64_t)next + jump, depth);
+        } break;
+        case OP_JUMP_IF_FALSE: {
+            CLOX_VERIFIER_NEED(1);
+            uint16_t jump = (uint16_t)((operands[0] << 8) | operands[1]);
+            if (!Clox_Verifier_Flow_To(verifier, offset, (int64_t)next + jump, depth)) {
+                return false;
+            }
+        } break;
+        case OP_JUMP_LONG: {
+            return Clox_Verifier_Flow_To(verifier, offset, (int64_t)next + Clox_Chunk_Read_Long_Operand(operands), depth);
+        } break;
+        case OP_JUMP_IF_FALSE_LONG: {
+            CLOX_VERIFIER_NEED(1);
+            if (!Clox_Verifier_Flow_To(verifier, offset, (int64_t)next + Clox_Chunk_Read_Long_Operand(operands), depth)) {
+                return false;
+            }
+        } break;
+        case OP_JUMP_IF_NOT_EQUAL: /* fallthrough */
+        case OP_JUMP_IF_EQUAL: /* fallthrough */
+        case OP_JUMP_IF_NOT_GREATER: /* fallthrough */
+        case OP_JUMP_IF_NOT_GREATER_EQUAL: /* fallthrough */
+        case OP_JUMP_IF_NOT_LESS: /* fallthrough */
+        case OP_JUMP_IF_NOT_LESS_EQUAL: {
+            CLOX_VERIFIER_NEED(2);
+            depth -= 2;
+            uint16_t jump = (uint16_t)((operands[0] << 8) | operands[1]);
+            if (!Clox_Verifier_Flow_To(verifier, offset, (int64_t)next + jump, depth)) {
+                return false;
+            }
+        } break;
+        case OP_LOOP: {
+            uint16_t jump = (uint16_t)((operands[0] << 8) | operands[1]);
+            return Clox_Verifier_Flow_To(verifier, offset, (int64_t)next - jump, depth);
+        } break;
+        case OP_LOOP_LONG: {
+            return Clox_Verifier_Flow_To(verifier, offset, (int64_t)next - Clox_Chunk_Read_Long_Operand(operands), depth);
+        } break;
+        case OP_CALL: /* fallthrough */
+        case OP_TAIL_CALL: {
+            uint16_t cache = (uint16_t)((operands[1] << 8) | operands[2]);
+            CLOX_VERIFIER_CHECK(cache < verifier->function->call_cache_count, "Call cache index out of range.");
+            CLOX_VERIFIER_NEED(operands[0] + 1);
+            depth -= operands[0];
+        } break;
+        case OP_CLOSURE: /* fallthrough */
+        case OP_CLOSURE_LONG: {
+            uint16_t constant = opcode == OP_CLOSURE ? operands[0] : (uint16_t)((operands[0] << 8) | operands[1]);
+            uint8_t const* captures = opcode == OP_CLOSURE ? &operands[1] : &operands[2];
+            Clox_Function* nested = (Clox_Function*)CLOX_VALUE_AS_OBJECT(chunk->constants.values[constant]);
+            if (nested->lazy_source != NULL) {
+                // NOTE(Al-Andrew): not compiled yet, the VM verifies it right after it is
+                CLOX_VERIFIER_CHECK(nested->upvalue_count == 0, "Lazy function has upvalues.");
+                depth += 1;
+                break;
+            }
+            // NOTE(Al-Andrew): the capture flags only live in this instruction, so a function may only ever be closed
+            //                  over from one place or its upvalue reads could not be checked against them.
+            CLOX_VERIFIER_CHECK(!nested->verified, "Function is closed over more than once.");
+            // NOTE(Al-Andrew): only a loaded image can get here, a function whose constants lead back to itself
+            for (Clox_Verifier const* outer = verifier; outer != NULL; outer = outer->enclosing) {
+                CLOX_VERIFIER_CHECK(outer->function != nested, "Function closes over itself or an enclosing function.");
+            }
+            uint8_t* nested_flags = reallocate(NULL, 0, (size_t)nested->upvalue_count + 1);
+            // TODO(Al-Andrew, AllocFailure): handle
+            bool ok = Clox_Verifier_Read_Captures(verifier, offset, captures, depth, nested, nested_flags)
+                && Clox_Verifier_Verify(verifier->vm, verifier, nested, nested_flags);
+            deallocate(nested_flags);
+            if (!ok) {
+                return false;
+            }
+            depth += 1;
+        } break;
+        default: {
+            return Clox_Verifier_Error(verifier, offset, "Unknown opcode %d.", (int)chunk->code[offset]);
+        } break;
+    }
+
+    if (depth > verifier->max_depth) {
+        verifier->max_depth = depth;
+    }
+    return Clox_Verifier_Flow_To(verifier, offset, next, depth);
+}
+
+#undef CLOX_VERIFIER_NEED
+#undef CLOX_VERIFIER_CHECK
+
+bool Clox_Verify_Function(Clox_VM* vm, Clox_Function* function) {
+    CLOX_DEV_ASSERT(function != NULL);
+    if (function->verified) {
+        return true;
+    }
+    if (function->upvalue_count != 0) {
+        fprintf(stderr, "[verifier] top level function can't have upvalues\n");
+        return false;
+    }
+    return Clox_Verifier_Verify(vm, NULL, function, NULL);
+}
+
+static bool Clox_Verifier_Verify(Clox_VM* vm, Clox_Verifier const* enclosing, Clox_Function* function, uint8_t const* capture_flags) {
+    CLOX_DEV_ASSERT(function != NULL);
+
+    Clox_Chunk* chunk = &function->chunk;
+    if (chunk->used == 0) {
+        fprintf(stderr, "[verifier] empty chunk\n");
+        return false;
+    }
+
+    Clox_Verifier verifier = {
+        .vm = vm,
+        .enclosing = enclosing,
+        .function = function,
+        .chunk = chunk,
+        .depth_at = reallocate(NULL, 0, sizeof(int32_t) * chunk->used),
+        .is_instruction_start = reallocate(NULL, 0, sizeof(bool) * chunk->used),
+        .worklist = reallocate(NULL, 0, sizeof(uint32_t) * chunk->used),
+        .worklist_used = 0,
+        .max_depth = function->arity + 1, // NOTE(Al-Andrew): the callee itself sits in slot 0
+        .capture_flags = capture_flags,
+    };
+    for (uint32_t i = 0; i < chunk->used; ++i) {
+        verifier.depth_at[i] = CLOX_VERIFIER_UNVISITED;
+    }
+    memset(verifier.is_instruction_start, 0, sizeof(bool) * chunk->used);
+
+    bool ok = Clox_Verifier_Mark_Instruction_Starts(&verifier)
+        && Clox_Verifier_Flow_To(&verifier, 0, 0, verifier.max_depth);
+    while (ok && verifier.worklist_used > 0) {
+        ok = Clox_Verifier_Step(&verifier, verifier.worklist[--verifier.worklist_used]);
+    }
+
+    deallocate(verifier.depth_at);
+    deallocate(verifier.is_instruction_start);
+    deallocate(verifier.worklist);
+
+    if (ok) {
+        function->max_stack_height = (uint32_t)verifier.max_depth;
+        function->verified = true;
+    }
+    return ok;
+}
\ No newline at end of file
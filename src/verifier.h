@@ -0,0 +1,10 @@
+#ifndef CLOX_VERIFIER_H_INCLUDED
+#define CLOX_VERIFIER_H_INCLUDED
+
+#include "object.h"
+
+// NOTE(Al-Andrew): checks stack balance, jump targets and operand bounds of `function` and every function nested in
+//                  its constants, and fills in `max_stack_height`. The VM only runs functions that passed.
+bool Clox_Verify_Function(Clox_VM* vm, Clox_Function* function);
+
+#endif // CLOX_VERIFIER_H_INCLUDED
\ No newline at end of file
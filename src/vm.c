@@ -6,12 +6,20 @@
 #include <string.h>
 #include <time.h>
 #include "memory.h"
+#include "verifier.h"
 
+#if defined(CLOX_VM_COMPUTED_GOTO) && !defined(__GNUC__)
+    // NOTE(Al-Andrew): labels-as-values is a GCC/Clang extension, fall back to the switch everywhere else.
+    #undef CLOX_VM_COMPUTED_GOTO
+#endif // CLOX_VM_COMPUTED_GOTO && !__GNUC__
 
 void Clox_VM_Reset_Stack(Clox_VM* vm) {
     vm->stack_top = vm->stack;
     vm->call_frame_count = 0;
-    vm->open_upvalues = NULL;
+    if (vm->open_upvalue_count != 0) {
+        memset(vm->open_upvalues, 0, sizeof(Clox_UpvalueObj*) * vm->stack_capacity);
+        vm->open_upvalue_count = 0;
+    }
 }
 
 
@@ -21,17 +29,63 @@ Clox_Value clock_native(int argc, Clox_Value* argv) {
 
 Clox_VM Clox_VM_New_Empty() {
     Clox_VM vm = {0};
+    vm.call_frame_capacity = CLOX_VM_INITIAL_CALL_FRAMES;
+    vm.frames = reallocate(NULL, 0, sizeof(Clox_Call_Frame) * vm.call_frame_capacity); // TODO(Al-Andrew, AllocFailure): handle
+    vm.stack_capacity = CLOX_VM_INITIAL_STACK;
+    vm.stack = reallocate(NULL, 0, sizeof(Clox_Value) * vm.stack_capacity); // TODO(Al-Andrew, AllocFailure): handle
+    vm.open_upvalues = reallocate(NULL, 0, sizeof(Clox_UpvalueObj*) * vm.stack_capacity); // TODO(Al-Andrew, AllocFailure): handle
+    memset(vm.open_upvalues, 0, sizeof(Clox_UpvalueObj*) * vm.stack_capacity);
+    Clox_VM_Set_Limits(&vm, CLOX_MAX_CALL_FRAMES, CLOX_MAX_STACK);
     Clox_VM_Reset_Stack(&vm);
 
     Clox_VM_Define_Native(&vm, "GetSystemTimeInSeconds", clock_native);
 
     return vm;
 }
+#ifdef CLOX_DEBUG_PROFILE_OPCODES
+static void Clox_VM_Print_Opcode_Profile();
+#endif // CLOX_DEBUG_PROFILE_OPCODES
+
+#ifdef CLOX_DEBUG_CALL_CACHE_STATS
+static void Clox_VM_Print_Call_Cache_Stats(Clox_VM* const vm) {
+    uint64_t total_hits = 0;
+    uint64_t total_misses = 0;
+    for (Clox_Object* it = vm->objects; it != NULL; it = it->next_object) {
+        if (it->type != CLOX_OBJECT_TYPE_FUNCTION) continue;
+        Clox_Function* function = (Clox_Function*)it;
+        for (uint32_t i = 0; i < function->call_cache_count; ++i) {
+            Clox_Call_Cache* cache = &function->call_caches[i];
+            if (cache->hits == 0 && cache->misses == 0) continue;
+            fprintf(stderr, "call-cache %s site %u hits %llu misses %llu\n",
+                function->name != NULL ? function->name->characters : "<script>", i,
+                (unsigned long long)cache->hits, (unsigned long long)cache->misses);
+            total_hits += cache->hits;
+            total_misses += cache->misses;
+        }
+    }
+    fprintf(stderr, "call-cache total hits %llu misses %llu\n", (unsigned long long)total_hits, (unsigned long long)total_misses);
+}
+#endif // CLOX_DEBUG_CALL_CACHE_STATS
+
 void Clox_VM_Delete(Clox_VM* const vm) {
     // NOTE(Al-Andrew, Leak): do we own the chunk?
+    #ifdef CLOX_DEBUG_PROFILE_OPCODES
+    Clox_VM_Print_Opcode_Profile();
+    #endif // CLOX_DEBUG_PROFILE_OPCODES
+    #ifdef CLOX_DEBUG_CALL_CACHE_STATS
+    Clox_VM_Print_Call_Cache_Stats(vm);
+    #endif // CLOX_DEBUG_CALL_CACHE_STATS
 
+    deallocate(vm->frames);
+    vm->frames = NULL;
+    deallocate(vm->stack);
+    vm->stack = vm->stack_top = NULL;
+    deallocate(vm->open_upvalues);
+    vm->open_upvalues = NULL;
     Clox_Hash_Table_Destory(&vm->strings);
-    Clox_Hash_Table_Destory(&vm->globals);
+    Clox_Hash_Table_Destory(&vm->global_slots);
+    Clox_Value_Array_Delete(&vm->global_values);
+    Clox_Value_Array_Delete(&vm->global_names);
     Clox_Object* it = vm->objects;
     while(it != NULL) {
         Clox_Object* next = it->next_object;
@@ -52,22 +106,58 @@ static inline Clox_Value Clox_VM_Stack_Peek(Clox_VM* const vm, uint32_t depth) {
     return *(vm->stack_top - 1 - depth);
 }
 
+// NOTE(Al-Andrew): open upvalues only ever point at live slots of the current frame or below, so everything from
+//                  `last` up to stack_top covers all the ones that have to be closed.
 static void Clox_VM_Close_Upvalues(Clox_VM* vm, Clox_Value* last) {
-    
-    while (vm->open_upvalues != NULL && vm->open_upvalues->location >= last) {
-        Clox_UpvalueObj* upvalue = vm->open_upvalues;
+    for (Clox_Value* slot = last; slot < vm->stack_top && vm->open_upvalue_count != 0; ++slot) {
+        Clox_UpvalueObj** open_upvalue = &vm->open_upvalues[slot - vm->stack];
+        if (*open_upvalue == NULL) continue;
+
+        Clox_UpvalueObj* upvalue = *open_upvalue;
         upvalue->closed = *upvalue->location;
         upvalue->location = &upvalue->closed;
-        vm->open_upvalues = upvalue->next;
+        *open_upvalue = NULL;
+        vm->open_upvalue_count--;
     }
 }
 
+// NOTE(Al-Andrew): shared by OP_CLOSURE and OP_CLOSURE_LONG, the instruction pointer is on the capture pairs
+static void Clox_VM_Push_Closure(Clox_VM* vm, Clox_Call_Frame* frame, Clox_Function* function) {
+    if (function->canonical_closure != NULL) {
+        Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(function->canonical_closure));
+        return;
+    }
+    Clox_Closure* closure = Clox_Closure_Create(vm, function);
+    Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(closure));
+
+    for (int i = 0; i < closure->upvalue_count; i++) {
+        uint8_t flags = *frame->instruction_pointer++;
+        uint16_t index = *frame->instruction_pointer++;
+        if (flags & CLOX_CAPTURE_FLAG_WIDE) {
+            index = (uint16_t)((index << 8) | *frame->instruction_pointer++);
+        }
+        if (flags & CLOX_CAPTURE_FLAG_BY_VALUE) {
+            closure->upvalues[i].value = (flags & CLOX_CAPTURE_FLAG_LOCAL) ? frame->slots[index] : frame->closure->upvalues[index].value;
+        } else if (flags & CLOX_CAPTURE_FLAG_LOCAL) {
+            closure->upvalues[i].upvalue = Clox_Closure_Capture_Upvalue(vm, frame->slots + index);
+        } else {
+            closure->upvalues[i].upvalue = frame->closure->upvalues[index].upvalue;
+        }
+    }
+}
+
+
+// NOTE(Al-Andrew): no stack depth checks in the handlers, Clox_Verify_Function proved them for every function we run.
 
 // NOTE(Al-Andrew): assumes `Clox_VM* const vm` is in scope and we're returning Clox_Interpret_Result
-#define CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(N) { if((vm->stack_top - vm->stack) < N) { return (Clox_Interpret_Result){.status = INTERPRET_COMPILE_ERROR}; } }
 // TODO(Al-Andrew, Diagnostics): better diagnostics 
-#define CLOX_VM_ASSURE_STACK_TYPE_0(T) { if(Clox_VM_Stack_Peek(vm, 0).type != T) { return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR}; } }
-#define CLOX_VM_ASSURE_STACK_TYPE_1(T) { if(Clox_VM_Stack_Peek(vm, 1).type != T) { return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR}; } }
+#define CLOX_VM_ASSURE_STACK_TYPE_0(T) { if(CLOX_VALUE_TYPE_OF(Clox_VM_Stack_Peek(vm, 0)) != T) { return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR}; } }
+#define CLOX_VM_ASSURE_STACK_TYPE_1(T) { if(CLOX_VALUE_TYPE_OF(Clox_VM_Stack_Peek(vm, 1)) != T) { return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR}; } }
+#define CLOX_VM_ASSURE_STACK_NUMBER_0() { if(!CLOX_VALUE_IS_NUMBER(Clox_VM_Stack_Peek(vm, 0))) { return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR}; } }
+#define CLOX_VM_ASSURE_STACK_NUMBER_1() { if(!CLOX_VALUE_IS_NUMBER(Clox_VM_Stack_Peek(vm, 1))) { return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR}; } }
+
+
+#define CLOX_VM_TRACEBACK_FRAMES 16
 
 static Clox_Interpret_Result Clox_VM_Runtime_Error(Clox_VM* vm, char const* const fmt, ...) {
     va_list args;
@@ -76,11 +166,27 @@ static Clox_Interpret_Result Clox_VM_Runtime_Error(Clox_VM* vm, char const* cons
     va_end(args);
     fputs("\n", stderr);
 
+    // NOTE(Al-Andrew): with a growable frame stack a runaway recursion can be tens of thousands of frames deep,
+    //                  only print both ends of it.
     for (int i = vm->call_frame_count - 1; i >= 0; i--) {
+        if (i == vm->call_frame_count - 1 - CLOX_VM_TRACEBACK_FRAMES && i >= CLOX_VM_TRACEBACK_FRAMES) {
+            fprintf(stderr, "[... %d more frames]\n", i + 1 - CLOX_VM_TRACEBACK_FRAMES);
+            i = CLOX_VM_TRACEBACK_FRAMES;
+            continue;
+        }
         Clox_Call_Frame* frame = &vm->frames[i];
         Clox_Function* function = frame->closure->function;
         size_t instruction = frame->instruction_pointer - function->chunk.code - 1;
-        fprintf(stderr, "[line %d] in ", function->chunk.source_lines[instruction]);
+        uint32_t line = function->chunk.source_lines[instruction];
+        // NOTE(Al-Andrew): inlined calls get the frames they would have had, innermost first
+        for (uint32_t site = 0; site < function->chunk.inline_site_count; ++site) {
+            Clox_Inline_Site const* inline_site = &function->chunk.inline_sites[site];
+            if (instruction >= inline_site->start && instruction < inline_site->end) {
+                fprintf(stderr, "[line %d] in %s()\n", line, inline_site->callee->characters);
+                line = inline_site->call_line;
+            }
+        }
+        fprintf(stderr, "[line %d] in ", line);
         if (function->name == NULL) {
             fprintf(stderr, "script\n");
         } else {
@@ -92,31 +198,141 @@ static Clox_Interpret_Result Clox_VM_Runtime_Error(Clox_VM* vm, char const* cons
     return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR};
 }
 
+void Clox_VM_Set_Limits(Clox_VM* vm, int max_call_frames, uint32_t max_stack) {
+    // NOTE(Al-Andrew): never below what is already allocated, we only grow
+    vm->max_call_frames = max_call_frames > vm->call_frame_capacity ? max_call_frames : vm->call_frame_capacity;
+    vm->max_stack = max_stack > vm->stack_capacity ? max_stack : vm->stack_capacity;
+}
+
+// NOTE(Al-Andrew): makes sure the stack holds at least `required` values. moving the stack leaves every pointer into
+//                  it dangling, so stack_top, each frame's slots and the open upvalues get re-based onto the new block.
+//                  callers must not hold on to any other stack pointer across this.
+static bool Clox_VM_Ensure_Stack(Clox_VM* vm, size_t required) {
+    if (required <= vm->stack_capacity) {
+        return true;
+    }
+    if (required > vm->max_stack) {
+        return false;
+    }
+
+    size_t capacity = vm->stack_capacity;
+    while (capacity < required) {
+        capacity *= 2;
+    }
+    if (capacity > vm->max_stack) {
+        capacity = vm->max_stack;
+    }
+
+    Clox_Value* old_stack = vm->stack;
+    Clox_Value* new_stack = reallocate(NULL, 0, sizeof(Clox_Value) * capacity); // TODO(Al-Andrew, AllocFailure): handle
+    memcpy(new_stack, old_stack, sizeof(Clox_Value) * (vm->stack_top - old_stack));
+
+    vm->stack_top = new_stack + (vm->stack_top - old_stack);
+    for (int i = 0; i < vm->call_frame_count; i++) {
+        vm->frames[i].slots = new_stack + (vm->frames[i].slots - old_stack);
+    }
+    vm->open_upvalues = reallocate(vm->open_upvalues, 0, sizeof(Clox_UpvalueObj*) * capacity); // TODO(Al-Andrew, AllocFailure): handle
+    memset(vm->open_upvalues + vm->stack_capacity, 0, sizeof(Clox_UpvalueObj*) * (capacity - vm->stack_capacity));
+    if (vm->open_upvalue_count != 0) {
+        for (uint32_t i = 0; i < vm->stack_capacity; i++) {
+            if (vm->open_upvalues[i] != NULL) {
+                vm->open_upvalues[i]->location = new_stack + i;
+            }
+        }
+    }
+
+    deallocate(old_stack);
+    vm->stack = new_stack;
+    vm->stack_capacity = (uint32_t)capacity;
+    return true;
+}
+
+static bool Clox_VM_Ensure_Frame(Clox_VM* vm) {
+    if (vm->call_frame_count < vm->call_frame_capacity) {
+        return true;
+    }
+    if (vm->call_frame_count >= vm->max_call_frames) {
+        return false;
+    }
+
+    int capacity = vm->call_frame_capacity * 2;
+    if (capacity > vm->max_call_frames) {
+        capacity = vm->max_call_frames;
+    }
+    vm->frames = reallocate(vm->frames, 0, sizeof(Clox_Call_Frame) * capacity); // TODO(Al-Andrew, AllocFailure): handle
+    vm->call_frame_capacity = capacity;
+    return true;
+}
+
+// NOTE(Al-Andrew): a lazy function (`clox -L`) is compiled and verified on its first call. one that fails to compile
+//                  stays unverified without a source, so every later call fails the same way.
+static bool Clox_VM_Ensure_Compiled(Clox_VM* vm, Clox_Function* function) {
+    if (function->verified) {
+        return true;
+    }
+    if (function->lazy_source == NULL || !Clox_Compile_Lazy_Function(vm, function) || !Clox_Verify_Function(vm, function)) {
+        Clox_VM_Runtime_Error(vm, "Could not compile %s().", function->name->characters);
+        return false;
+    }
+    return true;
+}
+
 static bool Clox_VM_Call(Clox_VM* vm, Clox_Closure* callee, int argCount) {
 
     if (argCount != callee->function->arity) {
         Clox_VM_Runtime_Error(vm, "Expected %d arguments but got %d.", callee->function->arity, argCount);
         return false;
     }
-    if (vm->call_frame_count == CLOX_MAX_CALL_FRAMES) {
+    if (!Clox_VM_Ensure_Compiled(vm, callee->function)) {
+        return false;
+    }
+    size_t slots_offset = (size_t)(vm->stack_top - vm->stack) - argCount - 1;
+    if (!Clox_VM_Ensure_Frame(vm) || !Clox_VM_Ensure_Stack(vm, slots_offset + callee->function->max_stack_height)) {
         Clox_VM_Runtime_Error(vm, "Stack overflow.");
         return false;
     }
+    Clox_Value* slots = vm->stack + slots_offset;
     Clox_Call_Frame* frame = &vm->frames[vm->call_frame_count++];
     frame->closure = callee;
     frame->instruction_pointer = callee->function->chunk.code;
-    frame->slots = vm->stack_top - argCount - 1;
+    frame->slots = slots;
+    return true;
+}
+
+// NOTE(Al-Andrew): reuses `frame` for the callee. the callee and its arguments get slid down over the caller's slots,
+//                  so a chain of tail calls never grows the frame stack or the value stack.
+static bool Clox_VM_Tail_Call(Clox_VM* vm, Clox_Call_Frame* frame, Clox_Closure* callee, int argCount) {
+
+    if (argCount != callee->function->arity) {
+        Clox_VM_Runtime_Error(vm, "Expected %d arguments but got %d.", callee->function->arity, argCount);
+        return false;
+    }
+    if (!Clox_VM_Ensure_Compiled(vm, callee->function)) {
+        return false;
+    }
+    if (!Clox_VM_Ensure_Stack(vm, (size_t)(frame->slots - vm->stack) + callee->function->max_stack_height)) {
+        Clox_VM_Runtime_Error(vm, "Stack overflow.");
+        return false;
+    }
+    if (frame->closure->function->has_captured_locals) {
+        Clox_VM_Close_Upvalues(vm, frame->slots);
+    }
+    Clox_Value* arguments = vm->stack_top - argCount - 1;
+    memmove(frame->slots, arguments, sizeof(Clox_Value) * (argCount + 1));
+    vm->stack_top = frame->slots + argCount + 1;
+    frame->closure = callee;
+    frame->instruction_pointer = callee->function->chunk.code;
     return true;
 }
 
 static bool Clox_VM_Call_Value(Clox_VM* vm, Clox_Value callee, int argCount) {
   if (CLOX_VALUE_IS_OBJECT(callee)) {
-    switch (callee.object->type) {
+    switch (CLOX_VALUE_AS_OBJECT(callee)->type) {
         case CLOX_OBJECT_TYPE_CLOSURE: {
-            return Clox_VM_Call(vm, (Clox_Closure*)callee.object, argCount);
+            return Clox_VM_Call(vm, (Clox_Closure*)CLOX_VALUE_AS_OBJECT(callee), argCount);
         } break;
         case CLOX_OBJECT_TYPE_NATIVE: {
-            Clox_Native* native = (Clox_Native*)callee.object;
+            Clox_Native* native = (Clox_Native*)CLOX_VALUE_AS_OBJECT(callee);
             Clox_Value result = native->function(argCount, vm->stack_top - argCount); // TODO(Al-Andrew): native functons can error out right?
             vm->stack_top -= argCount + 1;
             Clox_VM_Stack_Push(vm, result);
@@ -133,11 +349,150 @@ static bool Clox_VM_Call_Value(Clox_VM* vm, Clox_Value callee, int argCount) {
 void Clox_VM_Define_Native(Clox_VM* vm, const char* name, Clox_Native_Fn function) {
     Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(Clox_String_Create(vm, name, (int)strlen(name))));
     Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(Clox_Native_Create(vm, function)));
-    Clox_Hash_Table_Set(&vm->globals, (Clox_String*)vm->stack[0].object, vm->stack[1]);
+    uint32_t slot = Clox_VM_Resolve_Global_Slot(vm, (Clox_String*)CLOX_VALUE_AS_OBJECT(vm->stack[0]));
+    vm->global_values.values[slot] = vm->stack[1];
     Clox_VM_Stack_Pop(vm);
     Clox_VM_Stack_Pop(vm);
 }
 
+uint32_t Clox_VM_Resolve_Global_Slot(Clox_VM* vm, Clox_String* name) {
+    Clox_Value slot = {0};
+    if (Clox_Hash_Table_Get(&vm->global_slots, name, &slot)) {
+        return (uint32_t)CLOX_VALUE_AS_NUMBER(slot);
+    }
+
+    // NOTE(Al-Andrew): slots are never reused, the REPL keeps resolving against the same table across compilations.
+    uint32_t new_slot = vm->global_values.used;
+    Clox_Value_Array_Push_Back(&vm->global_values, CLOX_VALUE_UNDEFINED);
+    Clox_Value_Array_Push_Back(&vm->global_names, CLOX_VALUE_OBJECT(name));
+    Clox_Hash_Table_Set(&vm->global_slots, name, CLOX_VALUE_NUMBER((double)new_slot));
+    return new_slot;
+}
+
+static inline Clox_String* Clox_VM_Global_Name(Clox_VM* vm, uint16_t slot) {
+    return (Clox_String*)CLOX_VALUE_AS_OBJECT(vm->global_names.values[slot]);
+}
+
+#ifdef CLOX_DEBUG_PROFILE_OPCODES
+// NOTE(Al-Andrew): dynamic opcode pair counts, used to pick the superinstructions in chunk.h.
+static uint64_t s_clox_opcode_pair_counts[UINT8_MAX + 1][UINT8_MAX + 1];
+static int s_clox_previous_opcode = -1;
+
+typedef struct {
+    uint64_t count;
+    uint8_t first;
+    uint8_t second;
+} Clox_Opcode_Pair;
+
+static int Clox_Opcode_Pair_Compare(void const* lhs, void const* rhs) {
+    uint64_t lhs_count = ((Clox_Opcode_Pair const*)lhs)->count;
+    uint64_t rhs_count = ((Clox_Opcode_Pair const*)rhs)->count;
+    return (lhs_count < rhs_count) - (lhs_count > rhs_count);
+}
+
+// NOTE(Al-Andrew): one `pair <count> <first> <second>` line per pair seen, most frequent first.
+//                  the format is meant to be summed over a whole corpus with sort/awk.
+static void Clox_VM_Print_Opcode_Profile() {
+    static Clox_Opcode_Pair pairs[(UINT8_MAX + 1) * (UINT8_MAX + 1)];
+    uint32_t pair_count = 0;
+    for (uint32_t first = 0; first <= UINT8_MAX; ++first) {
+        for (uint32_t second = 0; second <= UINT8_MAX; ++second) {
+            if (s_clox_opcode_pair_counts[first][second] == 0) continue;
+            pairs[pair_count++] = (Clox_Opcode_Pair){.count = s_clox_opcode_pair_counts[first][second], .first = first, .second = second};
+        }
+    }
+    qsort(pairs, pair_count, sizeof(pairs[0]), Clox_Opcode_Pair_Compare);
+
+    for (uint32_t i = 0; i < pair_count; ++i) {
+        fprintf(stderr, "pair %llu %s %s\n", (unsigned long long)pairs[i].count, Clox_Op_Code_Name(pairs[i].first), Clox_Op_Code_Name(pairs[i].second));
+    }
+}
+#endif // CLOX_DEBUG_PROFILE_OPCODES
+
+static Clox_String* Clox_VM_Concatenate(Clox_VM* vm, Clox_String* lhs_string, Clox_String* rhs_string) {
+    // FIXME(Al-Andrwe): this is stupid
+    char* concat = reallocate(NULL, 0, lhs_string->length + rhs_string->length + 1);
+    unsigned int concat_length = lhs_string->length + rhs_string->length;
+    memcpy(concat, lhs_string->characters, lhs_string->length);
+    memcpy(concat + lhs_string->length, rhs_string->characters, rhs_string->length);
+    concat[rhs_string->length + lhs_string->length] = '\0';
+    Clox_String* concat_string = Clox_String_Create(vm, concat, concat_length);
+    deallocate(concat);
+    return concat_string;
+}
+
+static inline bool Clox_VM_Value_Is_String(Clox_Value value) {
+    return CLOX_VALUE_IS_OBJECT(value) && CLOX_VALUE_AS_OBJECT(value)->type == CLOX_OBJECT_TYPE_STRING;
+}
+
+static CLOX_NOINLINE bool Clox_VM_Values_Equal_Slow(Clox_Value lhs, Clox_Value rhs) {
+    if (CLOX_VALUE_TYPE_OF(lhs) != CLOX_VALUE_TYPE_OF(rhs)) {
+        return false;
+    }
+
+    switch (CLOX_VALUE_TYPE_OF(lhs)) {
+        case CLOX_VALUE_TYPE_NIL: /* fallthrough */
+        case CLOX_VALUE_TYPE_UNDEFINED: {
+            return true;
+        } break;
+        case CLOX_VALUE_TYPE_BOOL: {
+            return CLOX_VALUE_AS_BOOL(lhs) == CLOX_VALUE_AS_BOOL(rhs);
+        } break;
+        case CLOX_VALUE_TYPE_NUMBER: /* fallthrough */
+        case CLOX_VALUE_TYPE_INTEGER: {
+            CLOX_UNREACHABLE(); // NOTE(Al-Andrew): numbers were handled above
+        } break;
+        case CLOX_VALUE_TYPE_OBJECT: {
+            // NOTE(Al-Andrew): functions, closures and natives are only ever equal to themselves
+            if (CLOX_VALUE_AS_OBJECT(lhs)->type != CLOX_OBJECT_TYPE_STRING || CLOX_VALUE_AS_OBJECT(rhs)->type != CLOX_OBJECT_TYPE_STRING) {
+                return CLOX_VALUE_AS_OBJECT(lhs) == CLOX_VALUE_AS_OBJECT(rhs);
+            }
+            Clox_String* lhs_string = (Clox_String*)CLOX_VALUE_AS_OBJECT(lhs);
+            Clox_String* rhs_string = (Clox_String*)CLOX_VALUE_AS_OBJECT(rhs);
+            return s8_compare((s8){.len = lhs_string->length, .string = lhs_string->characters}, (s8){.len = rhs_string->length, .string = rhs_string->characters}) == 0;
+        } break;
+    }
+    return false;
+}
+
+static inline bool Clox_VM_Values_Equal(Clox_Value lhs, Clox_Value rhs) {
+    // NOTE(Al-Andrew): numbers compare by value whatever their subtype, 1 == 1.0 has to stay true.
+    if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) {
+        return CLOX_VALUE_AS_INTEGER(lhs) == CLOX_VALUE_AS_INTEGER(rhs);
+    }
+    if (CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs)) {
+        return CLOX_VALUE_AS_NUMBER(lhs) == CLOX_VALUE_AS_NUMBER(rhs);
+    }
+    return Clox_VM_Values_Equal_Slow(lhs, rhs);
+}
+
+static inline void Clox_VM_Trace_Instruction(Clox_VM* const vm, Clox_Call_Frame* const frame) {
+    #ifdef CLOX_DEBUG_PROFILE_OPCODES
+    uint8_t opcode = *frame->instruction_pointer;
+    if (s_clox_previous_opcode >= 0) {
+        s_clox_opcode_pair_counts[s_clox_previous_opcode][opcode]++;
+    }
+    s_clox_previous_opcode = opcode;
+    #endif // CLOX_DEBUG_PROFILE_OPCODES
+
+    #ifdef CLOX_DEBUG_TRACE_STACK
+    printf("[");
+    for(Clox_Value* stack_ptr = vm->stack; stack_ptr < vm->stack_top; ++stack_ptr)
+    {
+        Clox_Value_Print(*stack_ptr);
+        printf(" ");
+    }
+    printf("]\n");
+    #endif // CLOX_DEBUG_TRACE_STACK
+
+    #ifdef CLOX_DEBUG_TRACE_EXECUTION
+    Clox_Chunk_Print_Op_Code(&frame->closure->function->chunk, (uint32_t)(frame->instruction_pointer - frame->closure->function->chunk.code));
+    #endif // CLOX_DEBUG_TRACE_EXECUTION
+
+    (void)vm;
+    (void)frame;
+}
+
 Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Function* function) {
     // vm->chunk = chunk;
 
@@ -151,32 +506,138 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
     #define READ_CONSTANT() \
         (frame->closure->function->chunk.constants.values[READ_BYTE()])
 
-    #define READ_STRING() ((Clox_String*)READ_CONSTANT().object)
+    #define READ_CONSTANT_LONG() \
+        (frame->closure->function->chunk.constants.values[READ_SHORT()])
 
-    for (;;) {
-        
-        #ifdef CLOX_DEBUG_TRACE_STACK
-        printf("[");
-        for(Clox_Value* stack_ptr = vm->stack; stack_ptr < vm->stack_top; ++stack_ptr)
-        {
-            Clox_Value_Print(*stack_ptr);
-            printf(" ");
+    #if defined(CLOX_VM_COMPUTED_GOTO)
+        // NOTE(Al-Andrew): one indirect jump at the end of every handler instead of one shared jump at the top of the loop.
+        //                  gives the branch predictor a separate history per opcode.
+        static void* const dispatch_table[UINT8_MAX + 1] = {
+            [OP_RETURN]             = &&CLOX_VM_LABEL_OP_RETURN,
+            [OP_CONSTANT]           = &&CLOX_VM_LABEL_OP_CONSTANT,
+            [OP_NIL]                = &&CLOX_VM_LABEL_OP_NIL,
+            [OP_TRUE]               = &&CLOX_VM_LABEL_OP_TRUE,
+            [OP_FALSE]              = &&CLOX_VM_LABEL_OP_FALSE,
+            [OP_ARITHMETIC_NEGATION]= &&CLOX_VM_LABEL_OP_ARITHMETIC_NEGATION,
+            [OP_ADD]                = &&CLOX_VM_LABEL_OP_ADD,
+            [OP_SUB]                = &&CLOX_VM_LABEL_OP_SUB,
+            [OP_MUL]                = &&CLOX_VM_LABEL_OP_MUL,
+            [OP_DIV]                = &&CLOX_VM_LABEL_OP_DIV,
+            [OP_BOOLEAN_NEGATION]   = &&CLOX_VM_LABEL_OP_BOOLEAN_NEGATION,
+            [OP_EQUAL]              = &&CLOX_VM_LABEL_OP_EQUAL,
+            [OP_GREATER]            = &&CLOX_VM_LABEL_OP_GREATER,
+            [OP_LESS]               = &&CLOX_VM_LABEL_OP_LESS,
+            [OP_PRINT]              = &&CLOX_VM_LABEL_OP_PRINT,
+            [OP_POP]                = &&CLOX_VM_LABEL_OP_POP,
+            [OP_DEFINE_GLOBAL]      = &&CLOX_VM_LABEL_OP_DEFINE_GLOBAL,
+            [OP_GET_GLOBAL]         = &&CLOX_VM_LABEL_OP_GET_GLOBAL,
+            [OP_SET_GLOBAL]         = &&CLOX_VM_LABEL_OP_SET_GLOBAL,
+            [OP_GET_LOCAL]          = &&CLOX_VM_LABEL_OP_GET_LOCAL,
+            [OP_SET_LOCAL]          = &&CLOX_VM_LABEL_OP_SET_LOCAL,
+            [OP_GET_UPVALUE]        = &&CLOX_VM_LABEL_OP_GET_UPVALUE,
+            [OP_SET_UPVALUE]        = &&CLOX_VM_LABEL_OP_SET_UPVALUE,
+            [OP_GET_FLAT_UPVALUE]   = &&CLOX_VM_LABEL_OP_GET_FLAT_UPVALUE,
+            [OP_JUMP]               = &&CLOX_VM_LABEL_OP_JUMP,
+            [OP_JUMP_IF_FALSE]      = &&CLOX_VM_LABEL_OP_JUMP_IF_FALSE,
+            [OP_LOOP]               = &&CLOX_VM_LABEL_OP_LOOP,
+            [OP_CALL]               = &&CLOX_VM_LABEL_OP_CALL,
+            [OP_TAIL_CALL]          = &&CLOX_VM_LABEL_OP_TAIL_CALL,
+            [OP_CLOSURE]            = &&CLOX_VM_LABEL_OP_CLOSURE,
+            [OP_CLOSE_UPVALUE]      = &&CLOX_VM_LABEL_OP_CLOSE_UPVALUE,
+            [OP_NOT_EQUAL]          = &&CLOX_VM_LABEL_OP_NOT_EQUAL,
+            [OP_GREATER_EQUAL]      = &&CLOX_VM_LABEL_OP_GREATER_EQUAL,
+            [OP_LESS_EQUAL]         = &&CLOX_VM_LABEL_OP_LESS_EQUAL,
+            [OP_CONSTANT_LONG]      = &&CLOX_VM_LABEL_OP_CONSTANT_LONG,
+            [OP_CLOSURE_LONG]       = &&CLOX_VM_LABEL_OP_CLOSURE_LONG,
+            [OP_SMALL_INT]          = &&CLOX_VM_LABEL_OP_SMALL_INT,
+            [OP_WIDE]               = &&CLOX_VM_LABEL_OP_WIDE,
+            [OP_JUMP_LONG]          = &&CLOX_VM_LABEL_OP_JUMP_LONG,
+            [OP_JUMP_IF_FALSE_LONG] = &&CLOX_VM_LABEL_OP_JUMP_IF_FALSE_LONG,
+            [OP_LOOP_LONG]          = &&CLOX_VM_LABEL_OP_LOOP_LONG,
+            [OP_JUMP_IF_NOT_EQUAL]          = &&CLOX_VM_LABEL_OP_JUMP_IF_NOT_EQUAL,
+            [OP_JUMP_IF_EQUAL]              = &&CLOX_VM_LABEL_OP_JUMP_IF_EQUAL,
+            [OP_JUMP_IF_NOT_GREATER]        = &&CLOX_VM_LABEL_OP_JUMP_IF_NOT_GREATER,
+            [OP_JUMP_IF_NOT_GREATER_EQUAL]  = &&CLOX_VM_LABEL_OP_JUMP_IF_NOT_GREATER_EQUAL,
+            [OP_JUMP_IF_NOT_LESS]           = &&CLOX_VM_LABEL_OP_JUMP_IF_NOT_LESS,
+            [OP_JUMP_IF_NOT_LESS_EQUAL]     = &&CLOX_VM_LABEL_OP_JUMP_IF_NOT_LESS_EQUAL,
+            [OP_ADD_NUM]                    = &&CLOX_VM_LABEL_OP_ADD_NUM,
+            [OP_ADD_STR]                    = &&CLOX_VM_LABEL_OP_ADD_STR,
+            [OP_SUB_NUM]                    = &&CLOX_VM_LABEL_OP_SUB_NUM,
+            [OP_MUL_NUM]                    = &&CLOX_VM_LABEL_OP_MUL_NUM,
+            [OP_DIV_NUM]                    = &&CLOX_VM_LABEL_OP_DIV_NUM,
+            [OP_EQUAL_NUM]                  = &&CLOX_VM_LABEL_OP_EQUAL_NUM,
+            [OP_GREATER_NUM]                = &&CLOX_VM_LABEL_OP_GREATER_NUM,
+            [OP_LESS_NUM]                   = &&CLOX_VM_LABEL_OP_LESS_NUM,
+            [OP_ADD_INT]                    = &&CLOX_VM_LABEL_OP_ADD_INT,
+            [OP_SUB_INT]                    = &&CLOX_VM_LABEL_OP_SUB_INT,
+            [OP_MUL_INT]                    = &&CLOX_VM_LABEL_OP_MUL_INT,
+            [OP_EQUAL_INT]                  = &&CLOX_VM_LABEL_OP_EQUAL_INT,
+            [OP_GREATER_INT]                = &&CLOX_VM_LABEL_OP_GREATER_INT,
+            [OP_LESS_INT]                   = &&CLOX_VM_LABEL_OP_LESS_INT,
+            [OP_GET_LOCAL_GET_LOCAL]        = &&CLOX_VM_LABEL_OP_GET_LOCAL_GET_LOCAL,
+            [OP_GET_LOCAL_CONSTANT]         = &&CLOX_VM_LABEL_OP_GET_LOCAL_CONSTANT,
+            [OP_GET_LOCAL_GET_LOCAL_ADD]    = &&CLOX_VM_LABEL_OP_GET_LOCAL_GET_LOCAL_ADD,
+            [OP_GET_LOCAL_CONSTANT_ADD]     = &&CLOX_VM_LABEL_OP_GET_LOCAL_CONSTANT_ADD,
+            [OP_GET_LOCAL_CONSTANT_JUMP_IF_NOT_LESS] = &&CLOX_VM_LABEL_OP_GET_LOCAL_CONSTANT_JUMP_IF_NOT_LESS,
+            [OP_SET_LOCAL_POP]              = &&CLOX_VM_LABEL_OP_SET_LOCAL_POP,
+            [OP_SET_GLOBAL_POP]             = &&CLOX_VM_LABEL_OP_SET_GLOBAL_POP,
+            [OP_JUMP_IF_FALSE_POP]          = &&CLOX_VM_LABEL_OP_JUMP_IF_FALSE_POP,
+            [OP_POP_LOOP]                   = &&CLOX_VM_LABEL_OP_POP_LOOP,
+            [OP_GET_LOCAL_SMALL_INT]        = &&CLOX_VM_LABEL_OP_GET_LOCAL_SMALL_INT,
+            [OP_GET_LOCAL_SMALL_INT_ADD]    = &&CLOX_VM_LABEL_OP_GET_LOCAL_SMALL_INT_ADD,
+            [OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS] = &&CLOX_VM_LABEL_OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS,
+        };
+
+        #define CLOX_VM_SWITCH(opcode) CLOX_DEV_ASSERT(dispatch_table[(opcode)] != NULL); goto *dispatch_table[(opcode)];
+        #define CLOX_VM_CASE(opcode) CLOX_VM_LABEL_##opcode
+        #define CLOX_VM_DISPATCH() { \
+                Clox_VM_Trace_Instruction(vm, frame); \
+                uint8_t next_opcode = READ_BYTE(); \
+                CLOX_VM_SWITCH(next_opcode); \
+            }
+    #else
+        #define CLOX_VM_SWITCH(opcode) switch (opcode)
+        #define CLOX_VM_CASE(opcode) case opcode
+        #define CLOX_VM_DISPATCH() break
+    #endif // CLOX_VM_COMPUTED_GOTO
+
+    #if defined(CLOX_VM_QUICKENING)
+        // NOTE(Al-Andrew): rewrites the opcode that is currently executing, `instruction_pointer` is already past it.
+        #define CLOX_VM_QUICKEN(opcode) { frame->instruction_pointer[-1] = (opcode); }
+    #else
+        #define CLOX_VM_QUICKEN(opcode) { /* do nothing */ }
+    #endif // CLOX_VM_QUICKENING
+    #define CLOX_VM_DEQUICKEN(opcode) { \
+            frame->instruction_pointer -= 1; \
+            *frame->instruction_pointer = (opcode); \
+            CLOX_VM_DISPATCH(); \
         }
-        printf("]\n");
-        #endif // CLOX_DEBUG_TRACE_STACK
 
-        #ifdef CLOX_DEBUG_TRACE_EXECUTION
-        Clox_Chunk_Print_Op_Code(&frame->closure->function->chunk, (uint32_t)(frame->instruction_pointer - frame->closure->function->chunk.code));
-        #endif // CLOX_DEBUG_TRACE_EXECUTION
+    // NOTE(Al-Andrew): pops the two operands of a relational operator and stores the comparison in `result`.
+    //                  two integers compare exactly, any other mix of numbers as doubles.
+    #define CLOX_VM_POP_COMPARE(operator, result) { \
+            Clox_Value rhs = Clox_VM_Stack_Pop(vm); \
+            Clox_Value lhs = Clox_VM_Stack_Pop(vm); \
+            if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) { \
+                (result) = CLOX_VALUE_AS_INTEGER(lhs) operator CLOX_VALUE_AS_INTEGER(rhs); \
+            } else if (CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs)) { \
+                (result) = CLOX_VALUE_AS_NUMBER(lhs) operator CLOX_VALUE_AS_NUMBER(rhs); \
+            } else { \
+                return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR}; \
+            } \
+        }
+
+    for (;;) {
+        Clox_VM_Trace_Instruction(vm, frame);
 
         Clox_Op_Code opcode = (Clox_Op_Code)READ_BYTE();
 
-        switch (opcode) {
-            case OP_RETURN: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(1);
-                
+        CLOX_VM_SWITCH(opcode) {
+            CLOX_VM_CASE(OP_RETURN): {
                 Clox_Value result = Clox_VM_Stack_Pop(vm);
-                Clox_VM_Close_Upvalues(vm, frame->slots);
+                if (frame->closure->function->has_captured_locals) {
+                    Clox_VM_Close_Upvalues(vm, frame->slots);
+                }
                 vm->call_frame_count--;
                 if (vm->call_frame_count == 0) {
                     Clox_VM_Stack_Pop(vm); //this pops the <script> function off the stack
@@ -186,269 +647,725 @@ Clox_Interpret_Result Clox_VM_Interpret_Function(Clox_VM* const vm, Clox_Functio
                 vm->stack_top = frame->slots;
                 Clox_VM_Stack_Push(vm, result);
                 frame = &vm->frames[vm->call_frame_count - 1];
-            }break;
-            case OP_CONSTANT: {
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_CONSTANT): {
                 Clox_Value constant_value = READ_CONSTANT();
                 Clox_VM_Stack_Push(vm, constant_value);
-            }break;
-            case OP_NIL: {
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_NIL): {
                 Clox_VM_Stack_Push(vm, CLOX_VALUE_NIL);
-            } break;
-            case OP_TRUE: {
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_TRUE): {
                 Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(true));
-            } break;
-            case OP_FALSE: {
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_FALSE): {
                 Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(false));
-            } break;
-            case OP_ARITHMETIC_NEGATION: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(1);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_ARITHMETIC_NEGATION): {
+                CLOX_VM_ASSURE_STACK_NUMBER_0();
 
-                double value = Clox_VM_Stack_Pop(vm).number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(-value));
-            }break;
-            case OP_BOOLEAN_NEGATION: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(1);
-                Clox_Value_Type top_type = Clox_VM_Stack_Peek(vm, 0).type; 
+                Clox_Value value = Clox_VM_Stack_Pop(vm);
+                int64_t result;
+                if (CLOX_VALUE_IS_INTEGER(value) && !Clox_Value_Negate_Overflows(CLOX_VALUE_AS_INTEGER(value), &result)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_INTEGER(result));
+                } else {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(-CLOX_VALUE_AS_NUMBER(value)));
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_BOOLEAN_NEGATION): {
+                Clox_Value_Type top_type = CLOX_VALUE_TYPE_OF(Clox_VM_Stack_Peek(vm, 0)); 
 
                 if(top_type == CLOX_VALUE_TYPE_NIL) {
                     Clox_VM_Stack_Pop(vm); // pop the nil of the stack
                     Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(true));
                 } else if (top_type == CLOX_VALUE_TYPE_BOOL) {
-                    bool value = Clox_VM_Stack_Pop(vm).boolean;
+                    bool value = CLOX_VALUE_AS_BOOL(Clox_VM_Stack_Pop(vm));
                     Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(!value));
                 } else {
                     // TODO(Al-Andrew, Diagnostic): diagnostic
                     return (Clox_Interpret_Result){.return_value = Clox_VM_Stack_Pop(vm), .status = INTERPRET_RUNTIME_ERROR};
                 }
-            }break;
-            case OP_ADD: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_ADD): {
                 Clox_Value rhs = Clox_VM_Stack_Pop(vm);
                 Clox_Value lhs = Clox_VM_Stack_Pop(vm);
 
-                if(lhs.type != rhs.type) {
+                if(CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) {
+                    int64_t result;
+                    if (!Clox_Value_Add_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &result)) {
+                        CLOX_VM_QUICKEN(OP_ADD_INT);
+                        Clox_VM_Stack_Push(vm, CLOX_VALUE_INTEGER(result));
+                    } else {
+                        Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER((double)CLOX_VALUE_AS_INTEGER(lhs) + (double)CLOX_VALUE_AS_INTEGER(rhs)));
+                    }
+                }
+                else if(CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs)) {
+                    if (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(rhs)) {
+                        CLOX_VM_QUICKEN(OP_ADD_NUM);
+                    }
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(CLOX_VALUE_AS_NUMBER(lhs) + CLOX_VALUE_AS_NUMBER(rhs)));
+                }
+                else if(Clox_VM_Value_Is_String(lhs) && Clox_VM_Value_Is_String(rhs)) {
+                    CLOX_VM_QUICKEN(OP_ADD_STR);
+                    Clox_String* concat_string = Clox_VM_Concatenate(vm, (Clox_String*)CLOX_VALUE_AS_OBJECT(lhs), (Clox_String*)CLOX_VALUE_AS_OBJECT(rhs));
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(concat_string));
+                } else {
                     return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR};
                 }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_SUB): {
+                CLOX_VM_ASSURE_STACK_NUMBER_0();
+                CLOX_VM_ASSURE_STACK_NUMBER_1();
 
-                if(CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs)) {
-                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(lhs.number + rhs.number));
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                int64_t result;
+                if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs) &&
+                    !Clox_Value_Sub_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &result)) {
+                    CLOX_VM_QUICKEN(OP_SUB_INT);
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_INTEGER(result));
+                    CLOX_VM_DISPATCH();
                 }
-                else if((lhs.type == CLOX_VALUE_TYPE_OBJECT && lhs.object->type == CLOX_OBJECT_TYPE_STRING) && (rhs.type == CLOX_VALUE_TYPE_OBJECT && rhs.object->type == CLOX_OBJECT_TYPE_STRING)) {
-                    Clox_String* lhs_string = (Clox_String*)lhs.object;
-                    Clox_String* rhs_string = (Clox_String*)rhs.object;
 
-                    // FIXME(Al-Andrwe): this is stupid
-                    char* concat = reallocate(NULL, 0, lhs_string->length + rhs_string->length + 1);
-                    unsigned int concat_length = lhs_string->length + rhs_string->length;
-                    memcpy(concat, lhs_string->characters, lhs_string->length);
-                    memcpy(concat + lhs_string->length, rhs_string->characters, rhs_string->length);
-                    concat[rhs_string->length + lhs_string->length] = '\0';
-                    Clox_String* concat_string = Clox_String_Create(vm, concat, concat_length);
-                    deallocate(concat);
+                if (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_QUICKEN(OP_SUB_NUM);
+                }
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(CLOX_VALUE_AS_NUMBER(lhs) - CLOX_VALUE_AS_NUMBER(rhs)));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_MUL): {
+                CLOX_VM_ASSURE_STACK_NUMBER_0();
+                CLOX_VM_ASSURE_STACK_NUMBER_1();
 
-                    Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(concat_string));
-                } else {
-                    return (Clox_Interpret_Result){.status = INTERPRET_RUNTIME_ERROR};
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                int64_t result;
+                if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs) &&
+                    !Clox_Value_Mul_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &result)) {
+                    CLOX_VM_QUICKEN(OP_MUL_INT);
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_INTEGER(result));
+                    CLOX_VM_DISPATCH();
+                }
+
+                if (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_QUICKEN(OP_MUL_NUM);
+                }
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(CLOX_VALUE_AS_NUMBER(lhs) * CLOX_VALUE_AS_NUMBER(rhs)));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_DIV): {
+                CLOX_VM_ASSURE_STACK_NUMBER_0();
+                CLOX_VM_ASSURE_STACK_NUMBER_1();
+
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                // NOTE(Al-Andrew): integer division only when it is exact, otherwise the quotient a double would give
+                //                  is the one we have to produce. No quickened int form, exact division is rare in loops.
+                int64_t result;
+                if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs) &&
+                    !Clox_Value_Div_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &result)) {
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_INTEGER(result));
+                    CLOX_VM_DISPATCH();
+                }
+
+                if (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_QUICKEN(OP_DIV_NUM);
                 }
-            }break;
-            case OP_SUB: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
-                CLOX_VM_ASSURE_STACK_TYPE_1(CLOX_VALUE_TYPE_NUMBER);
-
-
-                double rhs = Clox_VM_Stack_Pop(vm).number;
-                double lhs = Clox_VM_Stack_Pop(vm).number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(lhs - rhs));
-            }break;
-            case OP_MUL: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
-                CLOX_VM_ASSURE_STACK_TYPE_1(CLOX_VALUE_TYPE_NUMBER);
-
-
-                double lhs = Clox_VM_Stack_Pop(vm).number;
-                double rhs = Clox_VM_Stack_Pop(vm).number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(lhs * rhs));
-            }break;
-            case OP_DIV: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
-                CLOX_VM_ASSURE_STACK_TYPE_1(CLOX_VALUE_TYPE_NUMBER);
-
-
-                double rhs = Clox_VM_Stack_Pop(vm).number;
-                double lhs = Clox_VM_Stack_Pop(vm).number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(lhs / rhs));
-            }break;
-            case OP_EQUAL: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(CLOX_VALUE_AS_NUMBER(lhs) / CLOX_VALUE_AS_NUMBER(rhs)));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_EQUAL): {
                 Clox_Value lhs = Clox_VM_Stack_Pop(vm);
                 Clox_Value rhs = Clox_VM_Stack_Pop(vm);
 
-                if(lhs.type != rhs.type) {
-                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(false));
-                    break;
+                // NOTE(Al-Andrew): numbers compare by value whatever their subtype, 1 == 1.0 has to stay true.
+                if(CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) {
+                    CLOX_VM_QUICKEN(OP_EQUAL_INT);
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(CLOX_VALUE_AS_INTEGER(lhs) == CLOX_VALUE_AS_INTEGER(rhs)));
+                    CLOX_VM_DISPATCH();
+                }
+                if(CLOX_VALUE_IS_NUMBER(lhs) && CLOX_VALUE_IS_NUMBER(rhs)) {
+                    if (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(rhs)) {
+                        CLOX_VM_QUICKEN(OP_EQUAL_NUM);
+                    }
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(CLOX_VALUE_AS_NUMBER(lhs) == CLOX_VALUE_AS_NUMBER(rhs)));
+                    CLOX_VM_DISPATCH();
                 }
 
-                switch(lhs.type) {
-                    case CLOX_VALUE_TYPE_NIL: {
-                        Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(true));
-                    } break;
-                    case CLOX_VALUE_TYPE_BOOL: {
-                        Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs.boolean == rhs.boolean));
-                    } break;
-                    case CLOX_VALUE_TYPE_NUMBER: {
-                        Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs.number == rhs.number));
-                    } break;
-                    case CLOX_VALUE_TYPE_OBJECT: {
-                        
-                        switch (lhs.object->type) {
-                            case CLOX_OBJECT_TYPE_STRING: {
-                                Clox_String* lhs_string = (Clox_String*)lhs.object;
-                                Clox_String* rhs_string = (Clox_String*)rhs.object;
-
-                                bool result = s8_compare((s8){.len = lhs_string->length, .string = lhs_string->characters}, (s8){.len = rhs_string->length, .string = rhs_string->characters}) == 0;
-                                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(result));
-                            }break;
-                            default: {
-                                CLOX_UNREACHABLE(); // TODO(Al-Andrew): 
-                            } break;
-                        }
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(Clox_VM_Values_Equal_Slow(lhs, rhs)));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GREATER): {
+                CLOX_VM_ASSURE_STACK_NUMBER_0();
+                CLOX_VM_ASSURE_STACK_NUMBER_1();
+
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) {
+                    CLOX_VM_QUICKEN(OP_GREATER_INT);
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(CLOX_VALUE_AS_INTEGER(lhs) > CLOX_VALUE_AS_INTEGER(rhs)));
+                    CLOX_VM_DISPATCH();
+                }
 
+                if (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_QUICKEN(OP_GREATER_NUM);
+                }
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(CLOX_VALUE_AS_NUMBER(lhs) > CLOX_VALUE_AS_NUMBER(rhs)));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_LESS): {
+                CLOX_VM_ASSURE_STACK_NUMBER_0();
+                CLOX_VM_ASSURE_STACK_NUMBER_1();
 
-                    } break;
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs)) {
+                    CLOX_VM_QUICKEN(OP_LESS_INT);
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(CLOX_VALUE_AS_INTEGER(lhs) < CLOX_VALUE_AS_INTEGER(rhs)));
+                    CLOX_VM_DISPATCH();
                 }
-            }break;
-            case OP_GREATER: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
-                CLOX_VM_ASSURE_STACK_TYPE_1(CLOX_VALUE_TYPE_NUMBER);
-
-
-                double rhs = Clox_VM_Stack_Pop(vm).number;
-                double lhs = Clox_VM_Stack_Pop(vm).number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs > rhs));
-            }break;
-            case OP_LESS: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(2);
-                CLOX_VM_ASSURE_STACK_TYPE_0(CLOX_VALUE_TYPE_NUMBER);
-                CLOX_VM_ASSURE_STACK_TYPE_1(CLOX_VALUE_TYPE_NUMBER);
-
-
-                double rhs = Clox_VM_Stack_Pop(vm).number;
-                double lhs = Clox_VM_Stack_Pop(vm).number;
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(lhs < rhs));
-            }break;
-            case OP_PRINT: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(1);
+
+                if (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_QUICKEN(OP_LESS_NUM);
+                }
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(CLOX_VALUE_AS_NUMBER(lhs) < CLOX_VALUE_AS_NUMBER(rhs)));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_PRINT): {
                 Clox_Value value = Clox_VM_Stack_Pop(vm);
                 Clox_Value_Print(value);
                 printf("\n");
-            } break;
-            case OP_POP: {
-                CLOX_VM_ASSURE_STACK_CONTAINS_AT_LEAST(1);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_POP): {
                 Clox_Value value = Clox_VM_Stack_Pop(vm);
                 (void)value;
-            } break;
-            case OP_DEFINE_GLOBAL: {
-                Clox_String* name = READ_STRING();
-                Clox_Value value = Clox_VM_Stack_Pop(vm);
-                Clox_Hash_Table_Set(&vm->globals, name, value);
-            } break;
-            case OP_GET_GLOBAL: {
-                Clox_String* name = READ_STRING();
-                Clox_Value value = {0};
-                if(!Clox_Hash_Table_Get(&vm->globals, name, &value)) {
-                    return Clox_VM_Runtime_Error(vm, "Undefined variable '%s'.", name->characters);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_DEFINE_GLOBAL): {
+                uint16_t slot = READ_SHORT();
+                vm->global_values.values[slot] = Clox_VM_Stack_Pop(vm);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GET_GLOBAL): {
+                uint16_t slot = READ_SHORT();
+                Clox_Value value = vm->global_values.values[slot];
+                if (CLOX_VALUE_IS_UNDEFINED(value)) {
+                    return Clox_VM_Runtime_Error(vm, "Undefined variable '%s'.", Clox_VM_Global_Name(vm, slot)->characters);
                 }
                 Clox_VM_Stack_Push(vm, value);
-            } break;
-            case OP_SET_GLOBAL: {
-                Clox_String* name = READ_STRING();
-                if (Clox_Hash_Table_Set(&vm->globals, name, Clox_VM_Stack_Peek(vm, 0))) { // NOTE(Al-Andrew): we generate a pop instruction for the expression. thats why we only peek here
-                    Clox_Hash_Table_Remove(&vm->globals, name); 
-                    return Clox_VM_Runtime_Error(vm, "Undefined variable '%s'.", name->characters);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_SET_GLOBAL): {
+                uint16_t slot = READ_SHORT();
+                if (CLOX_VALUE_IS_UNDEFINED(vm->global_values.values[slot])) {
+                    return Clox_VM_Runtime_Error(vm, "Undefined variable '%s'.", Clox_VM_Global_Name(vm, slot)->characters);
                 }
-            } break;
-            case OP_GET_LOCAL: {
+                vm->global_values.values[slot] = Clox_VM_Stack_Peek(vm, 0); // NOTE(Al-Andrew): we generate a pop instruction for the expression. thats why we only peek here
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GET_LOCAL): {
                 uint8_t variable_index = READ_BYTE();
 
                 Clox_VM_Stack_Push(vm, frame->slots[variable_index] ); 
-            } break;
-            case OP_SET_LOCAL: {
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_SET_LOCAL): {
                 uint8_t variable_index = READ_BYTE();
                 Clox_Value value = Clox_VM_Stack_Peek(vm, 0);
                 frame->slots[variable_index] = value;
-            } break;
-            case OP_GET_UPVALUE: {
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GET_UPVALUE): {
                 uint8_t slot = READ_BYTE();
-                Clox_VM_Stack_Push(vm, *frame->closure->upvalues[slot]->location);
-            } break;
-            case OP_SET_UPVALUE: {
+                Clox_VM_Stack_Push(vm, *frame->closure->upvalues[slot].upvalue->location);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GET_FLAT_UPVALUE): {
                 uint8_t slot = READ_BYTE();
-                *frame->closure->upvalues[slot]->location = Clox_VM_Stack_Peek(vm, 0);
-            } break;
-            case OP_JUMP: {
+                Clox_VM_Stack_Push(vm, frame->closure->upvalues[slot].value);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_SET_UPVALUE): {
+                uint8_t slot = READ_BYTE();
+                *frame->closure->upvalues[slot].upvalue->location = Clox_VM_Stack_Peek(vm, 0);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_JUMP): {
                 uint16_t offset = READ_SHORT();
                 frame->instruction_pointer += offset;
-            } break;
-            case OP_JUMP_IF_FALSE: {
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_JUMP_IF_FALSE): {
                 uint16_t offset = READ_SHORT();
                 Clox_Value condition = Clox_VM_Stack_Peek(vm, 0);
                 if (Clox_Value_Is_Falsy(condition)) {
                     frame->instruction_pointer += offset;
                 }
-            } break;
-            case OP_LOOP: {
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_LOOP): {
                 uint16_t offset = READ_SHORT();
                 frame->instruction_pointer -= offset;
-            } break;
-            case OP_CALL: {
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_CALL): {
                 int argCount = READ_BYTE();
-                if (!Clox_VM_Call_Value(vm, Clox_VM_Stack_Peek(vm, argCount), argCount)) {
+                Clox_Call_Cache* cache = &frame->closure->function->call_caches[READ_SHORT()];
+                Clox_Value callee = Clox_VM_Stack_Peek(vm, argCount);
+                bool is_closure = CLOX_VALUE_IS_OBJECT(callee) && CLOX_VALUE_AS_OBJECT(callee)->type == CLOX_OBJECT_TYPE_CLOSURE;
+
+                // NOTE(Al-Andrew): same function as last time from this site. arity already matched back then and
+                //                  only the room checks of Clox_VM_Call are left, without any growth.
+                if (is_closure && ((Clox_Closure*)CLOX_VALUE_AS_OBJECT(callee))->function == cache->function) {
+                    Clox_Value* slots = vm->stack_top - argCount - 1;
+                    if (vm->call_frame_count < vm->call_frame_capacity && slots + cache->max_stack_height <= vm->stack + vm->stack_capacity) {
+                        CLOX_DEV_ASSERT(cache->arity == argCount);
+                        #ifdef CLOX_DEBUG_CALL_CACHE_STATS
+                        cache->hits++;
+                        #endif // CLOX_DEBUG_CALL_CACHE_STATS
+                        frame = &vm->frames[vm->call_frame_count++];
+                        frame->closure = (Clox_Closure*)CLOX_VALUE_AS_OBJECT(callee);
+                        frame->instruction_pointer = cache->entry;
+                        frame->slots = slots;
+                        CLOX_VM_DISPATCH();
+                    }
+                }
+
+                #ifdef CLOX_DEBUG_CALL_CACHE_STATS
+                cache->misses++;
+                #endif // CLOX_DEBUG_CALL_CACHE_STATS
+                if (!Clox_VM_Call_Value(vm, callee, argCount)) {
                     return Clox_VM_Runtime_Error(vm, "Error while trying to call.");
                 }
                 frame = &vm->frames[vm->call_frame_count - 1];
-            } break;
-            case OP_CLOSURE: {
-                Clox_Function* function = (Clox_Function*)(READ_CONSTANT().object);
-                Clox_Closure* closure = Clox_Closure_Create(vm, function);
-                Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(closure));
-
-                for (int i = 0; i < closure->upvalue_count; i++) {
-                    uint8_t isLocal = READ_BYTE();
-                    uint8_t index = READ_BYTE();
-                    if (isLocal) {
-                        closure->upvalues[i] = Clox_Closure_Capture_Upvalue(vm, frame->slots + index);
-                    } else {
-                        closure->upvalues[i] = frame->closure->upvalues[index];
+                if (is_closure) {
+                    Clox_Function* function = frame->closure->function;
+                    cache->function = function;
+                    cache->entry = function->chunk.code;
+                    cache->arity = function->arity;
+                    cache->max_stack_height = function->max_stack_height;
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_TAIL_CALL): {
+                int argCount = READ_BYTE();
+                (void)READ_SHORT(); // NOTE(Al-Andrew): call cache, unused here since the frame gets reused anyway
+                Clox_Value callee = Clox_VM_Stack_Peek(vm, argCount);
+                if (CLOX_VALUE_IS_OBJECT(callee) && CLOX_VALUE_AS_OBJECT(callee)->type == CLOX_OBJECT_TYPE_CLOSURE) {
+                    if (!Clox_VM_Tail_Call(vm, frame, (Clox_Closure*)CLOX_VALUE_AS_OBJECT(callee), argCount)) {
+                        return Clox_VM_Runtime_Error(vm, "Error while trying to call.");
                     }
+                    CLOX_VM_DISPATCH();
                 }
-
-            } break;
-            case OP_CLOSE_UPVALUE: {
+                // NOTE(Al-Andrew): natives (and the error path) take a regular call, the OP_RETURN right after us
+                //                  finishes this frame.
+                if (!Clox_VM_Call_Value(vm, callee, argCount)) {
+                    return Clox_VM_Runtime_Error(vm, "Error while trying to call.");
+                }
+                frame = &vm->frames[vm->call_frame_count - 1];
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_CLOSURE): {
+                Clox_Function* function = (Clox_Function*)(CLOX_VALUE_AS_OBJECT(READ_CONSTANT()));
+                Clox_VM_Push_Closure(vm, frame, function);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_CLOSE_UPVALUE): {
                 Clox_VM_Close_Upvalues(vm, vm->stack_top - 1);
                 Clox_VM_Stack_Pop(vm);
-            } break;
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_NOT_EQUAL): {
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(!Clox_VM_Values_Equal(lhs, rhs)));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GREATER_EQUAL): {
+                bool result;
+                CLOX_VM_POP_COMPARE(>=, result);
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(result));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_LESS_EQUAL): {
+                bool result;
+                CLOX_VM_POP_COMPARE(<=, result);
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_BOOL(result));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_CONSTANT_LONG): {
+                Clox_Value constant_value = READ_CONSTANT_LONG();
+                Clox_VM_Stack_Push(vm, constant_value);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_CLOSURE_LONG): {
+                Clox_Function* function = (Clox_Function*)(CLOX_VALUE_AS_OBJECT(READ_CONSTANT_LONG()));
+                Clox_VM_Push_Closure(vm, frame, function);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_SMALL_INT): {
+                int8_t immediate = (int8_t)READ_BYTE();
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_INTEGER(immediate));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_WIDE): {
+                // NOTE(Al-Andrew): the op after the prefix is never dispatched on its own. only functions with more
+                //                  than 256 locals or upvalues get here, so the extra switch costs nothing elsewhere
+                uint8_t op = READ_BYTE();
+                uint16_t slot = READ_SHORT();
+                switch (op) {
+                    case OP_GET_LOCAL: {
+                        Clox_VM_Stack_Push(vm, frame->slots[slot]);
+                    } break;
+                    case OP_SET_LOCAL: {
+                        frame->slots[slot] = Clox_VM_Stack_Peek(vm, 0);
+                    } break;
+                    case OP_GET_UPVALUE: {
+                        Clox_VM_Stack_Push(vm, *frame->closure->upvalues[slot].upvalue->location);
+                    } break;
+                    case OP_GET_FLAT_UPVALUE: {
+                        Clox_VM_Stack_Push(vm, frame->closure->upvalues[slot].value);
+                    } break;
+                    case OP_SET_UPVALUE: {
+                        *frame->closure->upvalues[slot].upvalue->location = Clox_VM_Stack_Peek(vm, 0);
+                    } break;
+                    default: {
+                        CLOX_UNREACHABLE(); // NOTE(Al-Andrew): the verifier only lets the ops above through
+                    } break;
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_JUMP_LONG): {
+                uint32_t offset = Clox_Chunk_Read_Long_Operand(frame->instruction_pointer);
+                frame->instruction_pointer += 4 + offset;
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_JUMP_IF_FALSE_LONG): {
+                uint32_t offset = Clox_Chunk_Read_Long_Operand(frame->instruction_pointer);
+                frame->instruction_pointer += 4;
+                if (Clox_Value_Is_Falsy(Clox_VM_Stack_Peek(vm, 0))) {
+                    frame->instruction_pointer += offset;
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_LOOP_LONG): {
+                uint32_t offset = Clox_Chunk_Read_Long_Operand(frame->instruction_pointer);
+                frame->instruction_pointer += 4;
+                frame->instruction_pointer -= offset;
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_JUMP_IF_NOT_EQUAL): {
+                uint16_t offset = READ_SHORT();
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                if (!Clox_VM_Values_Equal(lhs, rhs)) {
+                    frame->instruction_pointer += offset;
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_JUMP_IF_EQUAL): {
+                uint16_t offset = READ_SHORT();
+                Clox_Value rhs = Clox_VM_Stack_Pop(vm);
+                Clox_Value lhs = Clox_VM_Stack_Pop(vm);
+                if (Clox_VM_Values_Equal(lhs, rhs)) {
+                    frame->instruction_pointer += offset;
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_JUMP_IF_NOT_GREATER): {
+                uint16_t offset = READ_SHORT();
+                bool result;
+                CLOX_VM_POP_COMPARE(>, result);
+                if (!result) {
+                    frame->instruction_pointer += offset;
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_JUMP_IF_NOT_GREATER_EQUAL): {
+                uint16_t offset = READ_SHORT();
+                bool result;
+                CLOX_VM_POP_COMPARE(>=, result);
+                if (!result) {
+                    frame->instruction_pointer += offset;
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_JUMP_IF_NOT_LESS): {
+                uint16_t offset = READ_SHORT();
+                bool result;
+                CLOX_VM_POP_COMPARE(<, result);
+                if (!result) {
+                    frame->instruction_pointer += offset;
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_JUMP_IF_NOT_LESS_EQUAL): {
+                uint16_t offset = READ_SHORT();
+                bool result;
+                CLOX_VM_POP_COMPARE(<=, result);
+                if (!result) {
+                    frame->instruction_pointer += offset;
+                }
+            } CLOX_VM_DISPATCH();
+            // NOTE(Al-Andrew): quickened opcodes. the generic handlers above rewrite themselves into these once they
+            //                  see operand types they can specialize on. each one only guards its operand types and
+            //                  rewrites itself back to the generic opcode on a mismatch.
+            CLOX_VM_CASE(OP_ADD_NUM): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                if (!CLOX_VALUE_IS_DOUBLE(lhs) || !CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_DEQUICKEN(OP_ADD);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_NUMBER(CLOX_VALUE_AS_DOUBLE(lhs) + CLOX_VALUE_AS_DOUBLE(rhs));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_ADD_STR): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                if (!Clox_VM_Value_Is_String(lhs) || !Clox_VM_Value_Is_String(rhs)) {
+                    CLOX_VM_DEQUICKEN(OP_ADD);
+                }
+                Clox_String* concat_string = Clox_VM_Concatenate(vm, (Clox_String*)CLOX_VALUE_AS_OBJECT(lhs), (Clox_String*)CLOX_VALUE_AS_OBJECT(rhs));
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_OBJECT(concat_string);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_SUB_NUM): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                if (!CLOX_VALUE_IS_DOUBLE(lhs) || !CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_DEQUICKEN(OP_SUB);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_NUMBER(CLOX_VALUE_AS_DOUBLE(lhs) - CLOX_VALUE_AS_DOUBLE(rhs));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_MUL_NUM): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                if (!CLOX_VALUE_IS_DOUBLE(lhs) || !CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_DEQUICKEN(OP_MUL);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_NUMBER(CLOX_VALUE_AS_DOUBLE(lhs) * CLOX_VALUE_AS_DOUBLE(rhs));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_DIV_NUM): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                if (!CLOX_VALUE_IS_DOUBLE(lhs) || !CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_DEQUICKEN(OP_DIV);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_NUMBER(CLOX_VALUE_AS_DOUBLE(lhs) / CLOX_VALUE_AS_DOUBLE(rhs));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_EQUAL_NUM): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                if (!CLOX_VALUE_IS_DOUBLE(lhs) || !CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_DEQUICKEN(OP_EQUAL);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_BOOL(CLOX_VALUE_AS_DOUBLE(lhs) == CLOX_VALUE_AS_DOUBLE(rhs));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GREATER_NUM): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                if (!CLOX_VALUE_IS_DOUBLE(lhs) || !CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_DEQUICKEN(OP_GREATER);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_BOOL(CLOX_VALUE_AS_DOUBLE(lhs) > CLOX_VALUE_AS_DOUBLE(rhs));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_LESS_NUM): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                if (!CLOX_VALUE_IS_DOUBLE(lhs) || !CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    CLOX_VM_DEQUICKEN(OP_LESS);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_BOOL(CLOX_VALUE_AS_DOUBLE(lhs) < CLOX_VALUE_AS_DOUBLE(rhs));
+            } CLOX_VM_DISPATCH();
+            // NOTE(Al-Andrew): integer forms. an overflow dequickens too, the generic handler does the promotion to double.
+            CLOX_VM_CASE(OP_ADD_INT): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                int64_t result;
+                if (!CLOX_VALUE_IS_INTEGER(lhs) || !CLOX_VALUE_IS_INTEGER(rhs) ||
+                    Clox_Value_Add_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &result)) {
+                    CLOX_VM_DEQUICKEN(OP_ADD);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_INTEGER(result);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_SUB_INT): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                int64_t result;
+                if (!CLOX_VALUE_IS_INTEGER(lhs) || !CLOX_VALUE_IS_INTEGER(rhs) ||
+                    Clox_Value_Sub_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &result)) {
+                    CLOX_VM_DEQUICKEN(OP_SUB);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_INTEGER(result);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_MUL_INT): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                int64_t result;
+                if (!CLOX_VALUE_IS_INTEGER(lhs) || !CLOX_VALUE_IS_INTEGER(rhs) ||
+                    Clox_Value_Mul_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &result)) {
+                    CLOX_VM_DEQUICKEN(OP_MUL);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_INTEGER(result);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_EQUAL_INT): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                if (!CLOX_VALUE_IS_INTEGER(lhs) || !CLOX_VALUE_IS_INTEGER(rhs)) {
+                    CLOX_VM_DEQUICKEN(OP_EQUAL);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_BOOL(CLOX_VALUE_AS_INTEGER(lhs) == CLOX_VALUE_AS_INTEGER(rhs));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GREATER_INT): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                if (!CLOX_VALUE_IS_INTEGER(lhs) || !CLOX_VALUE_IS_INTEGER(rhs)) {
+                    CLOX_VM_DEQUICKEN(OP_GREATER);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_BOOL(CLOX_VALUE_AS_INTEGER(lhs) > CLOX_VALUE_AS_INTEGER(rhs));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_LESS_INT): {
+                Clox_Value rhs = Clox_VM_Stack_Peek(vm, 0);
+                Clox_Value lhs = Clox_VM_Stack_Peek(vm, 1);
+                if (!CLOX_VALUE_IS_INTEGER(lhs) || !CLOX_VALUE_IS_INTEGER(rhs)) {
+                    CLOX_VM_DEQUICKEN(OP_LESS);
+                }
+                vm->stack_top -= 1;
+                vm->stack_top[-1] = CLOX_VALUE_BOOL(CLOX_VALUE_AS_INTEGER(lhs) < CLOX_VALUE_AS_INTEGER(rhs));
+            } CLOX_VM_DISPATCH();
+            // NOTE(Al-Andrew): superinstructions. the original bytes of the fused sequence follow the fused opcode untouched,
+            //                  so a handler that can't take its fast path executes the first instruction and dispatches
+            //                  the rest of the sequence as is. mixed integer/double operands and integer overflow take
+            //                  that path too.
+            CLOX_VM_CASE(OP_GET_LOCAL_GET_LOCAL): {
+                uint8_t lhs_index = frame->instruction_pointer[0];
+                uint8_t rhs_index = frame->instruction_pointer[2];
+                frame->instruction_pointer += 3;
+                Clox_VM_Stack_Push(vm, frame->slots[lhs_index]);
+                Clox_VM_Stack_Push(vm, frame->slots[rhs_index]);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GET_LOCAL_CONSTANT): {
+                uint8_t local_index = frame->instruction_pointer[0];
+                uint8_t constant_index = frame->instruction_pointer[2];
+                frame->instruction_pointer += 3;
+                Clox_VM_Stack_Push(vm, frame->slots[local_index]);
+                Clox_VM_Stack_Push(vm, frame->closure->function->chunk.constants.values[constant_index]);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GET_LOCAL_GET_LOCAL_ADD): {
+                Clox_Value lhs = frame->slots[frame->instruction_pointer[0]];
+                Clox_Value rhs = frame->slots[frame->instruction_pointer[2]];
+                int64_t result;
+                if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs) &&
+                    !Clox_Value_Add_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &result)) {
+                    frame->instruction_pointer += 4;
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_INTEGER(result));
+                } else if (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    frame->instruction_pointer += 4;
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(CLOX_VALUE_AS_DOUBLE(lhs) + CLOX_VALUE_AS_DOUBLE(rhs)));
+                } else {
+                    frame->instruction_pointer += 1;
+                    Clox_VM_Stack_Push(vm, lhs);
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GET_LOCAL_CONSTANT_ADD): {
+                Clox_Value lhs = frame->slots[frame->instruction_pointer[0]];
+                Clox_Value rhs = frame->closure->function->chunk.constants.values[frame->instruction_pointer[2]];
+                int64_t result;
+                if (CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs) &&
+                    !Clox_Value_Add_Overflows(CLOX_VALUE_AS_INTEGER(lhs), CLOX_VALUE_AS_INTEGER(rhs), &result)) {
+                    frame->instruction_pointer += 4;
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_INTEGER(result));
+                } else if (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(rhs)) {
+                    frame->instruction_pointer += 4;
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(CLOX_VALUE_AS_DOUBLE(lhs) + CLOX_VALUE_AS_DOUBLE(rhs)));
+                } else {
+                    frame->instruction_pointer += 1;
+                    Clox_VM_Stack_Push(vm, lhs);
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GET_LOCAL_CONSTANT_JUMP_IF_NOT_LESS): {
+                Clox_Value lhs = frame->slots[frame->instruction_pointer[0]];
+                Clox_Value rhs = frame->closure->function->chunk.constants.values[frame->instruction_pointer[2]];
+                bool both_integers = CLOX_VALUE_IS_INTEGER(lhs) && CLOX_VALUE_IS_INTEGER(rhs);
+                if (both_integers || (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(rhs))) {
+                    frame->instruction_pointer += 4; // NOTE(Al-Andrew): onto the jump offset of OP_JUMP_IF_NOT_LESS
+                    uint16_t offset = READ_SHORT();
+                    bool less = both_integers ? CLOX_VALUE_AS_INTEGER(lhs) < CLOX_VALUE_AS_INTEGER(rhs)
+                                              : CLOX_VALUE_AS_DOUBLE(lhs) < CLOX_VALUE_AS_DOUBLE(rhs);
+                    if (!less) {
+                        frame->instruction_pointer += offset;
+                    }
+                } else {
+                    frame->instruction_pointer += 1;
+                    Clox_VM_Stack_Push(vm, lhs);
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_SET_LOCAL_POP): {
+                uint8_t variable_index = READ_BYTE();
+                frame->instruction_pointer += 1;
+                frame->slots[variable_index] = Clox_VM_Stack_Pop(vm);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_SET_GLOBAL_POP): {
+                uint16_t slot = READ_SHORT();
+                frame->instruction_pointer += 1;
+                if (CLOX_VALUE_IS_UNDEFINED(vm->global_values.values[slot])) {
+                    return Clox_VM_Runtime_Error(vm, "Undefined variable '%s'.", Clox_VM_Global_Name(vm, slot)->characters);
+                }
+                vm->global_values.values[slot] = Clox_VM_Stack_Pop(vm);
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_JUMP_IF_FALSE_POP): {
+                uint16_t offset = READ_SHORT();
+                if (Clox_Value_Is_Falsy(Clox_VM_Stack_Peek(vm, 0))) {
+                    frame->instruction_pointer += offset; // NOTE(Al-Andrew): the jump target pops the condition
+                } else {
+                    frame->instruction_pointer += 1;
+                    Clox_VM_Stack_Pop(vm);
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_POP_LOOP): {
+                Clox_VM_Stack_Pop(vm);
+                frame->instruction_pointer += 1;
+                uint16_t offset = READ_SHORT();
+                frame->instruction_pointer -= offset;
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GET_LOCAL_SMALL_INT): {
+                uint8_t local_index = frame->instruction_pointer[0];
+                int8_t immediate = (int8_t)frame->instruction_pointer[2];
+                frame->instruction_pointer += 3;
+                Clox_VM_Stack_Push(vm, frame->slots[local_index]);
+                Clox_VM_Stack_Push(vm, CLOX_VALUE_INTEGER(immediate));
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GET_LOCAL_SMALL_INT_ADD): {
+                Clox_Value lhs = frame->slots[frame->instruction_pointer[0]];
+                int8_t immediate = (int8_t)frame->instruction_pointer[2];
+                int64_t result;
+                if (CLOX_VALUE_IS_INTEGER(lhs) && !Clox_Value_Add_Overflows(CLOX_VALUE_AS_INTEGER(lhs), (int64_t)immediate, &result)) {
+                    frame->instruction_pointer += 4;
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_INTEGER(result));
+                } else if (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(CLOX_VALUE_INTEGER(immediate))) {
+                    // NOTE(Al-Andrew): only taken under NaN boxing, where the immediate is a double too
+                    frame->instruction_pointer += 4;
+                    Clox_VM_Stack_Push(vm, CLOX_VALUE_NUMBER(CLOX_VALUE_AS_DOUBLE(lhs) + (double)immediate));
+                } else {
+                    frame->instruction_pointer += 1;
+                    Clox_VM_Stack_Push(vm, lhs);
+                }
+            } CLOX_VM_DISPATCH();
+            CLOX_VM_CASE(OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS): {
+                Clox_Value lhs = frame->slots[frame->instruction_pointer[0]];
+                int8_t immediate = (int8_t)frame->instruction_pointer[2];
+                bool integer = CLOX_VALUE_IS_INTEGER(lhs);
+                if (integer || (CLOX_VALUE_IS_DOUBLE(lhs) && CLOX_VALUE_IS_DOUBLE(CLOX_VALUE_INTEGER(immediate)))) {
+                    frame->instruction_pointer += 4; // NOTE(Al-Andrew): onto the jump offset of OP_JUMP_IF_NOT_LESS
+                    uint16_t offset = READ_SHORT();
+                    bool less = integer ? CLOX_VALUE_AS_INTEGER(lhs) < immediate
+                                        : CLOX_VALUE_AS_DOUBLE(lhs) < (double)immediate;
+                    if (!less) {
+                        frame->instruction_pointer += offset;
+                    }
+                } else {
+                    frame->instruction_pointer += 1;
+                    Clox_VM_Stack_Push(vm, lhs);
+                }
+            } CLOX_VM_DISPATCH();
+#if !defined(CLOX_VM_COMPUTED_GOTO)
             default: {
 
                 return (Clox_Interpret_Result){.return_value = Clox_VM_Stack_Pop(vm), .status = INTERPRET_COMPILE_ERROR, .message = "Unknown instruction."};
-            }break;
+            } break;
+#endif // CLOX_VM_COMPUTED_GOTO
         } // end switch
     } // end for
 
+    #undef CLOX_VM_SWITCH
+    #undef CLOX_VM_CASE
+    #undef CLOX_VM_DISPATCH
+    #undef CLOX_VM_QUICKEN
+    #undef CLOX_VM_DEQUICKEN
+    #undef CLOX_VM_POP_COMPARE
+
     CLOX_UNREACHABLE();
 }
 
-Clox_Interpret_Result Clox_VM_Interpret_Source(Clox_VM* vm, const char* source) {
+static Clox_Interpret_Result Clox_VM_Interpret_Script(Clox_VM* vm, Clox_Function* top_level_function) {
     Clox_Interpret_Result result = {0};
-    Clox_VM_Reset_Stack(vm);
 
     do {
-        Clox_Function* top_level_function = Clox_Compile_Source_To_Function(vm, source); 
-        if (top_level_function == NULL) {
+        if (top_level_function == NULL || !Clox_Verify_Function(vm, top_level_function)) {
             result.return_value = CLOX_VALUE_NIL;
             result.status = INTERPRET_COMPILE_ERROR;            
             break;
@@ -456,10 +1373,38 @@ Clox_Interpret_Result Clox_VM_Interpret_Source(Clox_VM* vm, const char* source)
 
         Clox_Closure* top_level_closure = Clox_Closure_Create(vm, top_level_function);
         Clox_VM_Stack_Push(vm, CLOX_VALUE_OBJECT(top_level_closure));
-        Clox_VM_Call(vm, top_level_closure, 0);
+        if (!Clox_VM_Call(vm, top_level_closure, 0)) {
+            result.status = INTERPRET_RUNTIME_ERROR;
+            break;
+        }
 
         result = Clox_VM_Interpret_Function(vm, top_level_function);
     } while(false);
 
     return result;
+}
+
+Clox_Interpret_Result Clox_VM_Interpret_Source(Clox_VM* vm, const char* source) {
+    Clox_VM_Reset_Stack(vm);
+    return Clox_VM_Interpret_Script(vm, Clox_Compile_Source_To_Function(vm, source));
+}
+
+Clox_Interpret_Result Clox_VM_Interpret_Stream(Clox_VM* vm, Clox_Source_Stream* stream) {
+    Clox_VM_Reset_Stack(vm);
+    return Clox_VM_Interpret_Script(vm, Clox_Compile_Stream_To_Function(vm, stream));
+}
+
+Clox_Interpret_Result Clox_VM_Interpret_Cached(Clox_VM* vm, Clox_Source const* source, Clox_Bytecode_Cache* cache) {
+    Clox_VM_Reset_Stack(vm);
+    Clox_Function* top_level_function = Clox_Bytecode_Cache_Load(cache, vm, source);
+    if (top_level_function != NULL && !Clox_Verify_Function(vm, top_level_function)) {
+        top_level_function = NULL; // NOTE(Al-Andrew): a damaged image, compiling again overwrites it
+    }
+    if (top_level_function == NULL) {
+        top_level_function = Clox_Compile_Source_To_Function(vm, source->text);
+        if (top_level_function != NULL && Clox_Verify_Function(vm, top_level_function)) {
+            Clox_Bytecode_Cache_Store(cache, vm, top_level_function, source);
+        }
+    }
+    return Clox_VM_Interpret_Script(vm, top_level_function);
 }
\ No newline at end of file
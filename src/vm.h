@@ -4,14 +4,28 @@
 // NOTE(Al-Andrew): uncomment for debugging 
 // #define CLOX_DEBUG_TRACE_EXECUTION
 // #define CLOX_DEBUG_TRACE_STACK
+// #define CLOX_DEBUG_PROFILE_OPCODES
+// #define CLOX_DEBUG_CALL_CACHE_STATS
 
 #include "chunk.h"
 #include "value.h"
 #include "object.h"
 #include "hash_table.h"
+#include "source.h"
+#include "bytecode_cache.h"
 
-#define CLOX_MAX_CALL_FRAMES 64
-#define CLOX_MAX_STACK (CLOX_MAX_CALL_FRAMES * (UINT8_MAX + 1))
+// NOTE(Al-Andrew): the call frames and the value stack live outside the VM and grow on demand. a fresh VM only
+//                  allocates the initial sizes, the hard limits can be changed per VM with Clox_VM_Set_Limits.
+#define CLOX_VM_INITIAL_CALL_FRAMES 8
+#define CLOX_VM_INITIAL_STACK (UINT8_MAX + 1)
+
+#ifndef CLOX_MAX_CALL_FRAMES
+#define CLOX_MAX_CALL_FRAMES (1 << 16)
+#endif // CLOX_MAX_CALL_FRAMES
+
+#ifndef CLOX_MAX_STACK
+#define CLOX_MAX_STACK (1 << 22)
+#endif // CLOX_MAX_STACK
 
 typedef struct {
   Clox_Closure* closure;
@@ -22,14 +36,26 @@ typedef struct {
 struct Clox_VM{
   Clox_Chunk* chunk;
   uint8_t* instruction_pointer;
-  Clox_Call_Frame frames[CLOX_MAX_CALL_FRAMES];
+  Clox_Call_Frame* frames;
   int call_frame_count;
-  Clox_Value stack[CLOX_MAX_STACK];
+  int call_frame_capacity;
+  int max_call_frames;
+  Clox_Value* stack;
   Clox_Value* stack_top;
+  uint32_t stack_capacity;
+  uint32_t max_stack;
   Clox_Object* objects;
   Clox_Hash_Table strings;
-  Clox_Hash_Table globals;
-  Clox_UpvalueObj* open_upvalues;
+  Clox_Hash_Table global_slots; // NOTE(Al-Andrew): name -> slot index (as a number) into global_values, filled in by the compiler
+  Clox_Value_Array global_values;
+  Clox_Value_Array global_names;
+  Clox_UpvalueObj** open_upvalues; // NOTE(Al-Andrew): parallel to the stack, the open upvalue for each slot or NULL
+  uint32_t open_upvalue_count;
+  bool optimize; // NOTE(Al-Andrew): run the optimizer over everything this VM compiles, `clox -O`
+  bool incremental; // NOTE(Al-Andrew): source arrives in pieces (the REPL), a later piece can rebind any global
+  bool lazy; // NOTE(Al-Andrew): compile top level function bodies on their first call, `clox -L`. the source has to
+             //                  outlive the VM then. ignored for incremental VMs, the REPL reuses its line buffer.
+  bool pipelined; // NOTE(Al-Andrew): scan on a second thread while the parser runs, `clox -P`. ignored for incremental VMs
 };
 
 
@@ -51,6 +77,14 @@ void Clox_VM_Delete(Clox_VM* const vm);
 
 Clox_Interpret_Result Clox_VM_Interpret_Chunk(Clox_VM* const vm, Clox_Chunk* const chunk);
 Clox_Interpret_Result Clox_VM_Interpret_Source(Clox_VM* const vm, const char* source);
+// NOTE(Al-Andrew): compiles the lines of `stream` as they arrive and runs the program once it has all of it. the stream
+//                  has to outlive the VM, lazy functions compile from it.
+Clox_Interpret_Result Clox_VM_Interpret_Stream(Clox_VM* const vm, Clox_Source_Stream* stream);
+// NOTE(Al-Andrew): runs the program `cache` holds for `source` if there is one, else compiles it and stores it there
+//                  before running it. `cache` and `source` have to outlive the VM, `clox -C`.
+Clox_Interpret_Result Clox_VM_Interpret_Cached(Clox_VM* const vm, Clox_Source const* source, Clox_Bytecode_Cache* cache);
 void Clox_VM_Define_Native(Clox_VM* vm, const char* name, Clox_Native_Fn function);
+uint32_t Clox_VM_Resolve_Global_Slot(Clox_VM* vm, Clox_String* name);
+void Clox_VM_Set_Limits(Clox_VM* vm, int max_call_frames, uint32_t max_stack);
 
 #endif // CLOX_VM_H_INCLUDED
\ No newline at end of file
@@ -0,0 +1,124 @@
+// NOTE(Al-Andrew): the bulk scanning paths have to give exactly the tokens the byte by byte scanner gives. scans random
+//                  sources built from the pieces that hit block edges (long names, long whitespace and comment runs,
+//                  strings over several lines, bytes past ASCII, unterminated strings) with every SIMD level the CPU
+//                  has and compares the token streams. `xmake test` runs it.
+#include "common.h"
+#include "scanner.h"
+#include <stdio.h>
+#include <string.h>
+
+#define CLOX_DIFFERENTIAL_SOURCES 2000
+#define CLOX_DIFFERENTIAL_MAX_SOURCE 8192
+
+static uint64_t s_clox_random_state = 0x9E3779B97F4A7C15ull;
+
+static uint32_t Clox_Random(uint32_t below) {
+    s_clox_random_state ^= s_clox_random_state << 13;
+    s_clox_random_state ^= s_clox_random_state >> 7;
+    s_clox_random_state ^= s_clox_random_state << 17;
+    return (uint32_t)(s_clox_random_state % below);
+}
+
+static void Clox_Append_Run(char* source, size_t* used, size_t limit, char const* alphabet, uint32_t max_length) {
+    size_t alphabet_length = strlen(alphabet);
+    uint32_t length = 1 + Clox_Random(max_length);
+    for (uint32_t i = 0; i < length && *used < limit; ++i) {
+        source[(*used)++] = alphabet[Clox_Random((uint32_t)alphabet_length)];
+    }
+}
+
+static size_t Clox_Generate_Source(char* source, size_t limit) {
+    static char const* const s_operators[] = {"(", ")", "{", "}", ",", ".", "-", "+", ";", "/", "*", "!", "!=", "=", "==", ">", ">=", "<", "<=", "@", "#"};
+    static char const s_identifier[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_0123456789";
+    static char const s_space[] = "    \t\r\n\n";
+    static char const s_text[] = "abc def \"\t\n/*\\{}0123 \x80\xC3\xA9\xFF";
+
+    size_t used = 0;
+    size_t target = Clox_Random((uint32_t)limit);
+    while (used < target) {
+        switch (Clox_Random(8)) {
+            case 0: {
+                source[used++] = (char)('a' + Clox_Random(26));
+                Clox_Append_Run(source, &used, limit, s_identifier, Clox_Random(4) == 0 ? 90 : 10);
+            } break;
+            case 1: {
+                Clox_Append_Run(source, &used, limit, s_space, Clox_Random(4) == 0 ? 80 : 3);
+            } break;
+            case 2: {
+                Clox_Append_Run(source, &used, limit, "0123456789", 12);
+                if (Clox_Random(2) == 0 && used + 1 < limit) {
+                    source[used++] = '.';
+                    Clox_Append_Run(source, &used, limit, "0123456789", 4);
+                }
+            } break;
+            case 3: {
+                if (used + 2 < limit) {
+                    source[used++] = '/';
+                    source[used++] = '/';
+                }
+                Clox_Append_Run(source, &used, limit, s_text, 100);
+                if (used < limit && Clox_Random(8) != 0) {
+                    source[used++] = '\n';
+                }
+            } break;
+            case 4: {
+                if (used < limit) {
+                    source[used++] = '"';
+                }
+                Clox_Append_Run(source, &used, limit, s_text, 120);
+                if (used < limit && Clox_Random(8) != 0) {
+                    source[used++] = '"';
+                }
+            } break;
+            case 5: {
+                source[used++] = (char)(0x80 + Clox_Random(0x80));
+            } break;
+            default: {
+                char const* op = s_operators[Clox_Random(sizeof(s_operators) / sizeof(s_operators[0]))];
+                for (size_t i = 0; op[i] != '\0' && used < limit; ++i) {
+                    source[used++] = op[i];
+                }
+            } break;
+        }
+    }
+    source[used] = '\0';
+    return used;
+}
+
+static bool Clox_Compare_Token_Streams(char const* source, Clox_Scanner_SIMD simd) {
+    Clox_Scanner expected = Clox_Scanner_New(source);
+    expected.simd = CLOX_SCANNER_SIMD_NONE;
+    Clox_Scanner scanner = Clox_Scanner_New(source);
+    scanner.simd = simd;
+
+    for (int index = 0;; ++index) {
+        Clox_Token want = Clox_Scanner_Get_Token(&expected);
+        Clox_Token got = Clox_Scanner_Get_Token(&scanner);
+        if (want.type != got.type || want.start != got.start || want.length != got.length || want.line != got.line) {
+            fprintf(stderr, "token %d differs with simd level %d: want type %d at %td length %d line %d, got type %d at %td length %d line %d\n",
+                    index, (int)simd, (int)want.type, want.start - source, want.length, want.line, (int)got.type, got.start - source, got.length, got.line);
+            return false;
+        }
+        if (want.type == CLOX_TOKEN_EOF) {
+            return true;
+        }
+    }
+}
+
+int main(void) {
+    static char source[CLOX_DIFFERENTIAL_MAX_SOURCE + 1];
+    Clox_Scanner_SIMD best = Clox_Scanner_Supported_SIMD();
+
+    int failures = 0;
+    for (int i = 0; i < CLOX_DIFFERENTIAL_SOURCES; ++i) {
+        Clox_Generate_Source(source, CLOX_DIFFERENTIAL_MAX_SOURCE);
+        for (int simd = CLOX_SCANNER_SIMD_SSE2; simd <= (int)best; ++simd) {
+            if (!Clox_Compare_Token_Streams(source, (Clox_Scanner_SIMD)simd)) {
+                failures += 1;
+            }
+        }
+    }
+
+    printf("%d sources, simd levels up to %d, %d mismatches\n", CLOX_DIFFERENTIAL_SOURCES, (int)best, failures);
+    return failures == 0 ? 0 : 1;
+}
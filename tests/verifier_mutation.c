@@ -0,0 +1,226 @@
+// NOTE(Al-Andrew): a loaded .loxc image is only as safe as the verifier, so this doctors compiled programs the way a
+//                  damaged or hostile image could, writes each one out as an image and runs it with `clox -C`'s
+//                  Clox_VM_Interpret_Cached. every instruction gets every opcode swapped in, every operand byte a
+//                  handful of values, and every function constant every function of the program (itself and its
+//                  enclosing ones included). each mutant runs in its own process with a timer against the loops it
+//                  makes, anything but a clean exit or the timer is a bug. `xmake test` runs it, built with
+//                  -fsanitize=address it also catches the reads past a chunk.
+#define _DEFAULT_SOURCE // NOTE(Al-Andrew): fork, setitimer and friends are hidden under -std=c11 otherwise
+#include "common.h"
+#include "bytecode_cache.h"
+#include "compiler.h"
+#include "object.h"
+#include "vm.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define CLOX_MUTATION_MAX_FUNCTIONS 64
+#define CLOX_MUTATION_TIMEOUT_MS 250
+
+// NOTE(Al-Andrew): between them every superinstruction, closures two deep, captures by value and by reference, calls
+static char const* const s_clox_mutation_programs[] = {
+    "var total = 0;\n"
+    "fun count(n) {\n"
+    "  var sum = 0;\n"
+    "  for (var i = 0; i < 10; i = i + 1) { sum = sum + i; }\n"
+    "  for (var j = 0; j < 1000; j = j + 300) { sum = sum + j * 2; }\n"
+    "  while (sum < n) sum = sum + sum;\n"
+    "  if (sum > n) total = sum; else total = -1;\n"
+    "  return sum + n;\n"
+    "}\n"
+    "print count(5000);\n"
+    "print total;\n",
+
+    "fun outer(a) {\n"
+    "  var b = a + 1;\n"
+    "  var c = \"s\";\n"
+    "  fun middle(x) {\n"
+    "    fun inner(y) { b = b + y; return b + x; }\n"
+    "    return inner;\n"
+    "  }\n"
+    "  var f = middle(2);\n"
+    "  if (c == \"s\") c = c + \"t\";\n"
+    "  return f(2) - f(3) / 2;\n"
+    "}\n"
+    "print outer(1);\n"
+    "print !nil == (1 >= 2) != (3 <= 4);\n",
+};
+
+static struct {
+    size_t program;
+    uint32_t function;
+    enum { CLOX_MUTATION_OPCODE, CLOX_MUTATION_OPERAND, CLOX_MUTATION_CONSTANT } kind;
+    uint32_t at; // NOTE(Al-Andrew): code offset, or constant index
+    uint32_t value; // NOTE(Al-Andrew): byte written, or index of the function put in the constant
+} s_clox_mutation;
+
+static void Clox_Mutation_Collect_Functions(Clox_Function* function, Clox_Function** functions, uint32_t* count) {
+    if (*count == CLOX_MUTATION_MAX_FUNCTIONS) {
+        return;
+    }
+    functions[(*count)++] = function;
+    for (uint32_t i = 0; i < function->chunk.constants.used; ++i) {
+        Clox_Value constant = function->chunk.constants.values[i];
+        if (CLOX_VALUE_IS_OBJECT(constant) && CLOX_VALUE_AS_OBJECT(constant)->type == CLOX_OBJECT_TYPE_FUNCTION) {
+            Clox_Mutation_Collect_Functions((Clox_Function*)CLOX_VALUE_AS_OBJECT(constant), functions, count);
+        }
+    }
+}
+
+// NOTE(Al-Andrew): runs in the child, compiles afresh so no mutant sees what an earlier one did. the image is loaded
+//                  into a second VM, like the next run of `clox -C` would.
+static void Clox_Mutation_Apply_And_Run(void) {
+    char const* program = s_clox_mutation_programs[s_clox_mutation.program];
+    Clox_Source source = {.text = program, .length = strlen(program)};
+    Clox_VM compiling = Clox_VM_New_Empty();
+    Clox_Function* script = Clox_Compile_Source_To_Function(&compiling, program);
+    Clox_Function* functions[CLOX_MUTATION_MAX_FUNCTIONS];
+    uint32_t count = 0;
+    Clox_Mutation_Collect_Functions(script, functions, &count);
+
+    Clox_Function* target = functions[s_clox_mutation.function];
+    switch (s_clox_mutation.kind) {
+        case CLOX_MUTATION_OPCODE: /* fallthrough */
+        case CLOX_MUTATION_OPERAND: {
+            target->chunk.code[s_clox_mutation.at] = (uint8_t)s_clox_mutation.value;
+        } break;
+        case CLOX_MUTATION_CONSTANT: {
+            target->chunk.constants.values[s_clox_mutation.at] = CLOX_VALUE_OBJECT(functions[s_clox_mutation.value]);
+        } break;
+    }
+
+    Clox_Bytecode_Cache cache = {0};
+    if (!Clox_Bytecode_Cache_Open(&cache, &compiling, &source) || !Clox_Bytecode_Cache_Store(&cache, &compiling, script, &source)) {
+        fprintf(stderr, "could not write the image\n");
+        exit(3);
+    }
+    Clox_VM running = Clox_VM_New_Empty();
+    Clox_VM_Interpret_Cached(&running, &source, &cache);
+    Clox_VM_Delete(&running);
+    Clox_VM_Delete(&compiling);
+    Clox_Bytecode_Cache_Delete(&cache);
+}
+
+typedef struct {
+    uint32_t mutants;
+    uint32_t timeouts;
+    uint32_t failures;
+} Clox_Mutation_Stats;
+
+static void Clox_Mutation_Run(Clox_Mutation_Stats* stats) {
+    stats->mutants += 1;
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        struct itimerval timer = {.it_value = {.tv_sec = 0, .tv_usec = CLOX_MUTATION_TIMEOUT_MS * 1000}};
+        setitimer(ITIMER_REAL, &timer, NULL);
+        Clox_Mutation_Apply_And_Run();
+        _exit(0);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGALRM) {
+        stats->timeouts += 1;
+    } else if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        stats->failures += 1;
+        fprintf(stderr, "mutant %zu %u %d %u %u crashed (%s %d)\n", s_clox_mutation.program, s_clox_mutation.function, (int)s_clox_mutation.kind,
+                s_clox_mutation.at, s_clox_mutation.value, WIFSIGNALED(status) ? "signal" : "exit", WIFSIGNALED(status) ? WTERMSIG(status) : WEXITSTATUS(status));
+    }
+}
+
+int main(int argc, char** argv) {
+    // NOTE(Al-Andrew): `verifier_mutation program function kind at value` replays one mutant, with its output
+    if (argc == 6) {
+        s_clox_mutation.program = (size_t)atoi(argv[1]);
+        s_clox_mutation.function = (uint32_t)atoi(argv[2]);
+        s_clox_mutation.kind = atoi(argv[3]);
+        s_clox_mutation.at = (uint32_t)atoi(argv[4]);
+        s_clox_mutation.value = (uint32_t)atoi(argv[5]);
+        Clox_Mutation_Apply_And_Run();
+        return 0;
+    }
+
+    char directory[] = "/tmp/clox_verifier_mutation_XXXXXX";
+    if (mkdtemp(directory) == NULL || setenv("CLOX_CACHE_DIR", directory, 1) != 0) {
+        fprintf(stderr, "could not make a cache directory\n");
+        return 1;
+    }
+
+    Clox_Mutation_Stats stats = {0};
+    for (size_t p = 0; p < sizeof(s_clox_mutation_programs) / sizeof(s_clox_mutation_programs[0]); ++p) {
+        // NOTE(Al-Andrew): the parent compiles once only to know the shape of what the children will mutate
+        Clox_VM vm = Clox_VM_New_Empty();
+        Clox_Function* script = Clox_Compile_Source_To_Function(&vm, s_clox_mutation_programs[p]);
+        if (script == NULL) {
+            fprintf(stderr, "program %zu does not compile\n", p);
+            return 1;
+        }
+        Clox_Function* functions[CLOX_MUTATION_MAX_FUNCTIONS];
+        uint32_t count = 0;
+        Clox_Mutation_Collect_Functions(script, functions, &count);
+
+        s_clox_mutation.program = p;
+        for (uint32_t f = 0; f < count; ++f) {
+            Clox_Chunk* chunk = &functions[f]->chunk;
+            s_clox_mutation.function = f;
+            for (uint32_t offset = 0; offset < chunk->used; offset += Clox_Chunk_Instruction_Length(chunk, offset)) {
+                s_clox_mutation.kind = CLOX_MUTATION_OPCODE;
+                s_clox_mutation.at = offset;
+                for (uint32_t opcode = 0; opcode <= OP_GET_LOCAL_SMALL_INT_JUMP_IF_NOT_LESS + 1; ++opcode) {
+                    if (opcode == chunk->code[offset]) continue;
+                    s_clox_mutation.value = opcode;
+                    Clox_Mutation_Run(&stats);
+                }
+
+                s_clox_mutation.kind = CLOX_MUTATION_OPERAND;
+                uint32_t length = Clox_Chunk_Instruction_Length(chunk, offset);
+                for (uint32_t operand = offset + 1; operand < offset + length; ++operand) {
+                    uint8_t const values[] = {0, 1, 2, 0x7f, 0xff, (uint8_t)(chunk->code[operand] ^ 1)};
+                    s_clox_mutation.at = operand;
+                    for (size_t v = 0; v < sizeof(values); ++v) {
+                        if (values[v] == chunk->code[operand]) continue;
+                        s_clox_mutation.value = values[v];
+                        Clox_Mutation_Run(&stats);
+                    }
+                }
+            }
+
+            s_clox_mutation.kind = CLOX_MUTATION_CONSTANT;
+            for (uint32_t c = 0; c < chunk->constants.used; ++c) {
+                Clox_Value constant = chunk->constants.values[c];
+                if (!CLOX_VALUE_IS_OBJECT(constant) || CLOX_VALUE_AS_OBJECT(constant)->type != CLOX_OBJECT_TYPE_FUNCTION) continue;
+                s_clox_mutation.at = c;
+                for (uint32_t other = 0; other < count; ++other) {
+                    if (functions[other] == (Clox_Function*)CLOX_VALUE_AS_OBJECT(constant)) continue;
+                    s_clox_mutation.value = other;
+                    Clox_Mutation_Run(&stats);
+                }
+            }
+        }
+        Clox_VM_Delete(&vm);
+    }
+
+    DIR* images = opendir(directory);
+    for (struct dirent* entry = images != NULL ? readdir(images) : NULL; entry != NULL; entry = readdir(images)) {
+        char path[sizeof(directory) + 256];
+        snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        unlink(path);
+    }
+    if (images != NULL) {
+        closedir(images);
+    }
+    rmdir(directory);
+
+    printf("%u mutants, %u timed out, %u crashes\n", stats.mutants, stats.timeouts, stats.failures);
+    return stats.failures == 0 ? 0 : 1;
+}
\ No newline at end of file
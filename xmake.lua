@@ -9,10 +9,105 @@ set_languages("c11")
 
 add_rules("mode.debug", "mode.release")
 
+option("computed_goto")
+    set_default(true)
+    set_showmenu(true)
+    set_description("Use threaded (labels-as-values) dispatch in the VM loop. Disable to fall back to the portable switch.")
+    add_defines("CLOX_VM_COMPUTED_GOTO")
+option_end()
+
+option("superinstructions")
+    set_default(true)
+    set_showmenu(true)
+    set_description("Fuse common opcode sequences into superinstructions after compiling each function.")
+    add_defines("CLOX_COMPILER_SUPERINSTRUCTIONS")
+option_end()
+
+option("quickening")
+    set_default(true)
+    set_showmenu(true)
+    set_description("Let arithmetic and comparison opcodes rewrite themselves into type specialized forms at runtime.")
+    add_defines("CLOX_VM_QUICKENING")
+option_end()
+
+option("nan_boxing")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Pack every Clox_Value into a single NaN-boxed 64-bit word instead of a tagged union.")
+    add_defines("CLOX_VALUE_NAN_BOXING")
+option_end()
+
+option("profile_opcodes")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Count dynamic opcode pairs and dump them to stderr when the VM is deleted.")
+    add_defines("CLOX_DEBUG_PROFILE_OPCODES")
+option_end()
+
+option("call_cache_stats")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Count call cache hits and misses per OP_CALL site and dump them to stderr when the VM is deleted.")
+    add_defines("CLOX_DEBUG_CALL_CACHE_STATS")
+option_end()
+
+option("peephole_stats")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Print the size of every chunk before and after the peephole optimizer to stderr.")
+    add_defines("CLOX_DEBUG_PEEPHOLE_STATS")
+option_end()
+
 target("clox")
     set_kind("binary")
     
     add_files("src/**.c")
     add_headerfiles("src/**.h")
+    add_options("computed_goto", "superinstructions", "quickening", "nan_boxing", "profile_opcodes", "call_cache_stats", "peephole_stats")
+    if is_plat("linux", "bsd") then
+        add_syslinks("pthread") -- the pipelined scanner, `clox -P`
+    end
+
+    -- add_cflags("-fsanitize=address")
+
+-- scanner throughput in MB/s: xmake build scanner_bench && xmake run scanner_bench [megabytes] [rounds] [scalar|sse2|avx2]
+target("scanner_bench")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("benchmarks/scanner_bench.c", "src/scanner.c", "src/source.c", "src/memory.c", "src/common.c")
+    add_includedirs("src")
+
+-- end to end compile time, serial and pipelined: xmake build compile_bench && xmake run compile_bench [megabytes] [rounds]
+target("compile_bench")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("benchmarks/compile_bench.c", "src/*.c|main.c")
+    add_includedirs("src")
+    add_options("computed_goto", "superinstructions", "quickening", "nan_boxing")
+    if is_plat("linux", "bsd") then
+        add_syslinks("pthread")
+    end
+
+-- the bulk scanning paths against the byte by byte scanner: xmake test
+target("scanner_differential")
+    set_kind("binary")
+    set_default(false)
+
+    add_files("tests/scanner_differential.c", "src/scanner.c", "src/source.c", "src/memory.c", "src/common.c")
+    add_includedirs("src")
+    add_tests("default")
+
+-- doctored .loxc images through the loader, the verifier and the VM: xmake test
+target("verifier_mutation")
+    set_kind("binary")
+    set_default(false)
 
-    -- add_cflags("-fsanitize=address")
\ No newline at end of file
+    add_files("tests/verifier_mutation.c", "src/*.c|main.c")
+    add_includedirs("src")
+    add_options("computed_goto", "superinstructions", "quickening", "nan_boxing")
+    if is_plat("linux", "bsd") then
+        add_syslinks("pthread")
+    end
+    add_tests("default")
\ No newline at end of file